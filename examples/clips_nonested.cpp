@@ -21,14 +21,14 @@ CLIPS_INIT()
     pcmd->brief("nonested subcommand");
     pcmd->desc("subcommand and has no nested command");
     pcmd->example("nonested");
-    pcmd->bind([](const clips::pcmd_t& cmd, const clips::args_t& args) -> clips::error_t
+    pcmd->bind([](const clips::pcmd_t& cmd, const clips::args_view_t& args) -> clips::error_t
         {
             std::cout << "exec nonested handler" << std::endl;
 
             std::cout << " args{";
-            for (auto& item : args)
+            for (size_t i = 0; i < args.size(); i++)
             {
-                std::cout << item << ", ";
+                std::cout << args[i] << ", ";
             }
             std::cout << "}" << std::endl;
 
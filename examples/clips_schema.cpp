@@ -0,0 +1,63 @@
+// Copyright (c) 2020, garry.hou <garry@esdk.net>, All rights reserved.
+// 
+// Clips is licensed under the Mulan PSL v1.
+// You can use this software according to the termsand conditions of the Mulan PSL v1.
+// You may obtain a copy of Mulan PSL v1 at :
+//     http://license.coscl.org.cn/MulanPSL
+// 
+// THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, 
+// EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON - INFRINGEMENT, 
+// MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+// 
+// See the Mulan PSL v1 for more details.
+// ----------------------------------------------------------------------------
+// 
+
+
+#include "clips/clips.hpp"
+
+// copy_opts copy命令的标记
+struct copy_opts
+{
+    uint32_t depth{ 0 };
+    bool force{ false };
+    std::string mode;
+};
+
+clips::error_t copy_handler(const clips::pcmd_t& pcmd, const copy_opts& opts, const clips::args_view_t& args)
+{
+    clips::out() << "exec copy handler" << std::endl;
+
+    clips::out() << " args{";
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        clips::out() << args[i] << ", ";
+    }
+    clips::out() << "}" << std::endl;
+
+    clips::out() << " flags{depth=" << opts.depth
+        << ", force=" << opts.force
+        << ", mode=" << opts.mode
+        << "}" << std::endl;
+
+    return clips::ok;
+}
+
+CLIPS_INIT()
+{
+    clips::schema_t<copy_opts> schema;
+    schema.flag(&copy_opts::depth, "depth", "d", 1, "depth")
+        .flag(&copy_opts::force, "force", "f", false, "force")
+        .flag(&copy_opts::mode, "mode", "m", "fast", { "fast", "safe" }, "mode", false);
+
+    auto copy = clips::make_cmd("copy");
+    copy->brief("typed flags");
+    copy->desc("flags are declared as members of a struct");
+    copy->example("copy -d 3 --mode safe src dst");
+    auto err = copy->bind(schema, copy_handler);
+    if (err != clips::ok)
+    {
+        return err;
+    }
+    return clips::bind(copy);
+}
@@ -17,16 +17,16 @@
 
 clips::error_t sub_handler(const clips::pcmd_t& pcmd, const clips::args_t& args)
 {
-    std::cout << "exec sub handler" << std::endl;
+    clips::out() << "exec sub handler" << std::endl;
 
-    std::cout << " args{";
+    clips::out() << " args{";
     for (auto& item : args)
     {
-        std::cout << item << ", ";
+        clips::out() << item << ", ";
     }
-    std::cout << "}" << std::endl;
+    clips::out() << "}" << std::endl;
 
-    std::cout << " flags{extend=" << pcmd->flags().count("-e")
+    clips::out() << " flags{extend=" << pcmd->cast<uint32_t>("-e")
         << "}" << std::endl;
 
     return clips::ok;
@@ -34,16 +34,16 @@ clips::error_t sub_handler(const clips::pcmd_t& pcmd, const clips::args_t& args)
 
 clips::error_t nested_handler(const clips::pcmd_t& pcmd, const clips::args_t& args)
 {
-    std::cout << "exec sub nested handler" << std::endl;
+    clips::out() << "exec sub nested handler" << std::endl;
 
-    std::cout << " args{";
+    clips::out() << " args{";
     for (auto& item : args)
     {
-        std::cout << item << ", ";
+        clips::out() << item << ", ";
     }
-    std::cout << "}" << std::endl;
+    clips::out() << "}" << std::endl;
 
-    std::cout << " flags{extend=" << pcmd->flags().count("-e")
+    clips::out() << " flags{extend=" << pcmd->cast<uint32_t>("-e")
         << "}" << std::endl;
 
     return clips::ok;
@@ -51,18 +51,18 @@ clips::error_t nested_handler(const clips::pcmd_t& pcmd, const clips::args_t& ar
 
 clips::error_t leaf_handler(const clips::pcmd_t& pcmd, const clips::args_t& args)
 {
-    std::cout << "exec sub nested leaf handler" << std::endl;
+    clips::out() << "exec sub nested leaf handler" << std::endl;
 
-    std::cout << " args{";
+    clips::out() << " args{";
     for (auto& item : args)
     {
-        std::cout << item << ", ";
+        clips::out() << item << ", ";
     }
-    std::cout << "}" << std::endl;
+    clips::out() << "}" << std::endl;
 
-    std::cout << " flags{extend=" << pcmd->flags().count("-e")
-        << ", num=" << pcmd->flags().count("--num")
-        << ", enum=" << pcmd->flags().count("--enum")
+    clips::out() << " flags{extend=" << pcmd->cast<uint32_t>("-e")
+        << ", num=" << pcmd->cast<int>("--num")
+        << ", enum=" << pcmd->cast<int>("--enum")
         << "}" << std::endl;
 
     return clips::ok;
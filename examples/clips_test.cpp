@@ -26,7 +26,7 @@ clips::error_t test_handler(const clips::pcmd_t& pcmd, const clips::args_t& args
     }
     std::cout << "}" << std::endl;
 
-    std::cout << " flags{extend=" << pcmd->flags().count("--extend")
+    std::cout << " flags{extend=" << pcmd->cast<uint32_t>("--extend")
         << "}" << std::endl;
 
     return clips::ok;
@@ -44,20 +44,20 @@ clips::error_t base_handler(const clips::pcmd_t& pcmd, const clips::args_t& args
     std::cout << "}" << std::endl;
 
     std::cout << " flags{" << std::endl
-        << "    extend =" << pcmd->flags().at("--extend")->cast<uint32_t>() << std::endl
-        << "    bool   =" << pcmd->flags().at("--bool")->cast<bool>() << std::endl
-        << "    char   =" << pcmd->flags().at("--char")->cast<char>() << std::endl
-        << "    int8   =" << pcmd->flags().at("--int8")->cast<int8_t>() << std::endl
-        << "    uint8  =" << pcmd->flags().at("--uint8")->cast<uint8_t>() << std::endl
-        << "    int16  =" << pcmd->flags().at("--int16")->cast<int16_t>() << std::endl
-        << "    uint16 =" << pcmd->flags().at("--uint16")->cast<uint16_t>() << std::endl
-        << "    int32  =" << pcmd->flags().at("--int32")->cast<int32_t>() << std::endl
-        << "    uint32 =" << pcmd->flags().at("--uint32")->cast<uint32_t>() << std::endl
-        << "    int64  =" << pcmd->flags().at("--int64")->cast<int64_t>() << std::endl
-        << "    uint64 =" << pcmd->flags().at("--uint64")->cast<uint64_t>() << std::endl
-        << "    float  =" << pcmd->flags().at("--float")->cast<float>() << std::endl
-        << "    double =" << pcmd->flags().at("--double")->cast<double>() << std::endl
-        << "    string =" << pcmd->flags().at("--string")->cast<std::string>() << std::endl
+        << "    extend =" << pcmd->cast<uint32_t>("--extend") << std::endl
+        << "    bool   =" << pcmd->cast<bool>("--bool") << std::endl
+        << "    char   =" << pcmd->cast<char>("--char") << std::endl
+        << "    int8   =" << static_cast<int>(pcmd->cast<int8_t>("--int8")) << std::endl
+        << "    uint8  =" << static_cast<int>(pcmd->cast<uint8_t>("--uint8")) << std::endl
+        << "    int16  =" << pcmd->cast<int16_t>("--int16") << std::endl
+        << "    uint16 =" << pcmd->cast<uint16_t>("--uint16") << std::endl
+        << "    int32  =" << pcmd->cast<int32_t>("--int32") << std::endl
+        << "    uint32 =" << pcmd->cast<uint32_t>("--uint32") << std::endl
+        << "    int64  =" << pcmd->cast<int64_t>("--int64") << std::endl
+        << "    uint64 =" << pcmd->cast<uint64_t>("--uint64") << std::endl
+        << "    float  =" << pcmd->cast<float>("--float") << std::endl
+        << "    double =" << pcmd->cast<double>("--double") << std::endl
+        << "    string =" << pcmd->cast<std::string>("--string") << std::endl
         << "}" << std::endl;
 
     return clips::ok;
@@ -143,7 +143,7 @@ CLIPS_INIT()
     base->desc("test base types.");
     base->example("test base --name=value");
 
-    auto err = base->flag<bool>("bool", "", false, "bool type");
+    clips::error_t err = base->flag<bool>("bool", "", false, "bool type");
     if (err != clips::ok)
     {
         return err;
@@ -21,7 +21,22 @@
 // clips::pflag() 添加flag，绑定外部变量
 // clips::bind() 绑定根函数，绑定子命令等
 // clips::exec() 解析，执行
+// clips::parse() 只解析，结果可以缓存、序列化和重复执行
+// clips::cache() 解析结果的LRU缓存，重复的命令行不再分词、查找和转换
+// clips::abbrev() 接受子命令和长名称标记的无歧义前缀缩写
+// --completion bash|zsh 生成静态的补全脚本；__complete 隐藏的补全入口
+// clips::batch() 批处理，逐行执行文件或标准输入中的命令，可以并行执行
+// clips::out() 命令的输出流，并行批处理时按输入的顺序输出
+// clips::exec_async() 异步执行，完成时回调或者返回std::future
+// clips::executor() 设置执行器，异步执行时同步的命令函数交给执行器执行
+// clips::repl() 交互模式，支持Tab补全和历史记录
+// clips::serve() 本地命令服务(Linux)，初始化一次，通过Unix socket执行转发的命令
+// clips::forward() 把参数转发给本地命令服务执行的客户端(Linux)
 // clips::argv() 原始命令参数
+// clips::freeze() 编译命令树，检查重复或冲突的定义
+// clips::context() 当前的解析上下文
+// clips::app_t 独立的应用实例，命令树初始化后只读，可在多个线程中同时exec
+// clips::schema_t 类型化的标记定义，标记的值直接写入结构体的成员
 // 
 // clips_cmd.cpp:
 // static uint32_t g_ccc = 0;
@@ -74,9 +89,13 @@
 
 #include <string>
 #include <vector>
+#include <list>
 #include <unordered_map>
 #include <memory>
+#include <new>
+#include <type_traits>
 #include <mutex>
+#include <atomic>
 #include <functional>
 #include <typeindex>
 #include <typeinfo>
@@ -85,6 +104,35 @@
 #include <regex>
 #include <tuple>
 #include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <clocale>
+#include <locale>
+#include <limits>
+#include <algorithm>
+#include <fstream>
+#include <deque>
+#include <thread>
+#include <condition_variable>
+#include <future>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+
+extern char** environ;
+#endif
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <cerrno>
+#endif
 
 /// CLIPS_INIT 初始化函数
 #define CLIPS_INIT() INNER_CLIPS_INIT_IMPL(__FILE__, __LINE__)
@@ -143,6 +191,11 @@ inline const std::string& desc();
 
 class cmd_t;
 class flag_t;
+class table_t;
+class context_t;
+class parse_result_t;
+template<class T> class schema_t;
+template<class F> class context_bound_t;
 
 // ----------------------------------------------------------------------------
 // error_t
@@ -263,6 +316,270 @@ inline std::ostream& operator<<(std::ostream& os, const error_t& err)
     return os;
 }
 
+// ----------------------------------------------------------------------------
+// view_t
+
+/// view_t 字符串视图，只引用外部内存，不复制
+/// 被引用的内存必须在视图使用期间有效
+class view_t
+{
+public:
+    static constexpr const size_t npos = static_cast<size_t>(-1);
+
+    view_t()
+    {
+    }
+
+    view_t(const char* data, size_t size)
+        : data_(data)
+        , size_(size)
+    {
+    }
+
+    view_t(const char* sz)
+        : data_(sz)
+        , size_(nullptr == sz ? 0 : strlen(sz))
+    {
+    }
+
+    view_t(const std::string& str)
+        : data_(str.data())
+        , size_(str.size())
+    {
+    }
+
+    // data 数据
+    const char* data() const
+    {
+        return data_;
+    }
+
+    // size 长度
+    size_t size() const
+    {
+        return size_;
+    }
+
+    // empty 是否为空
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    // [] 字符
+    char operator[](size_t pos) const
+    {
+        return data_[pos];
+    }
+
+    // begin 起始
+    const char* begin() const
+    {
+        return data_;
+    }
+
+    // end 结束
+    const char* end() const
+    {
+        return data_ + size_;
+    }
+
+    // find 查找字符
+    size_t find(char c, size_t pos = 0) const
+    {
+        for (; pos < size_; pos++)
+        {
+            if (data_[pos] == c)
+            {
+                return pos;
+            }
+        }
+        return npos;
+    }
+
+    // substr 子串，不复制
+    view_t substr(size_t pos, size_t n = npos) const
+    {
+        if (pos > size_)
+        {
+            pos = size_;
+        }
+        if (n > size_ - pos)
+        {
+            n = size_ - pos;
+        }
+        return view_t(data_ + pos, n);
+    }
+
+    // trim 去除头尾的指定字符，不复制
+    view_t trim(char c) const
+    {
+        size_t first = 0;
+        size_t last = size_;
+        while (first < last && data_[first] == c)
+        {
+            first++;
+        }
+        while (last > first && data_[last - 1] == c)
+        {
+            last--;
+        }
+        return view_t(data_ + first, last - first);
+    }
+
+    // starts_with 是否以指定字符起始
+    bool starts_with(char c) const
+    {
+        return size_ != 0 && data_[0] == c;
+    }
+
+    // compare 比较
+    int compare(const view_t& rhs) const
+    {
+        size_t len = size_ < rhs.size_ ? size_ : rhs.size_;
+        int cmp = (len == 0) ? 0 : memcmp(data_, rhs.data_, len);
+        if (cmp != 0)
+        {
+            return cmp;
+        }
+        if (size_ == rhs.size_)
+        {
+            return 0;
+        }
+        return size_ < rhs.size_ ? -1 : 1;
+    }
+
+    // str 复制为std::string
+    std::string str() const
+    {
+        return std::string(data_, size_);
+    }
+
+private:
+    const char* data_{ "" };
+    size_t size_{ 0 };
+};
+
+/// == 等于
+inline bool operator==(const view_t& lhs, const view_t& rhs)
+{
+    return lhs.size() == rhs.size() && lhs.compare(rhs) == 0;
+}
+
+/// != 不等于
+inline bool operator!=(const view_t& lhs, const view_t& rhs)
+{
+    return !(lhs == rhs);
+}
+
+/// == 等于
+inline bool operator==(const view_t& lhs, const char* rhs)
+{
+    return lhs == view_t(rhs);
+}
+
+/// != 不等于
+inline bool operator!=(const view_t& lhs, const char* rhs)
+{
+    return !(lhs == view_t(rhs));
+}
+
+/// == 等于
+inline bool operator==(const std::string& lhs, const view_t& rhs)
+{
+    return view_t(lhs) == rhs;
+}
+
+/// << 流式打印
+inline std::ostream& operator<<(std::ostream& os, const view_t& view)
+{
+    os.write(view.data(), view.size());
+    return os;
+}
+
+/// views_t 字符串视图列表
+using views_t = std::vector<view_t>;
+
+/// args_view_t 命令参数视图
+/// 只引用原始参数，不复制；引号在访问时才去除，同样不复制
+class args_view_t
+{
+public:
+    args_view_t()
+    {
+    }
+
+    args_view_t(const view_t* data, size_t size)
+        : data_(data)
+        , size_(size)
+    {
+    }
+
+    explicit args_view_t(const views_t& views)
+        : data_(views.data())
+        , size_(views.size())
+    {
+    }
+
+    // size 参数数量
+    size_t size() const
+    {
+        return size_;
+    }
+
+    // empty 是否为空
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    // [] 参数，已去除头尾的引号
+    view_t operator[](size_t pos) const
+    {
+        return data_[pos].trim('\'');
+    }
+
+    // raw 原始参数，未去除引号；以字符串传入的命令行在切分时已经去除了引号
+    const view_t& raw(size_t pos) const
+    {
+        return data_[pos];
+    }
+
+    // str 复制为std::string，已去除头尾的引号
+    std::string str(size_t pos) const
+    {
+        return (*this)[pos].str();
+    }
+
+    // begin 起始，遍历原始参数
+    const view_t* begin() const
+    {
+        return data_;
+    }
+
+    // end 结束，遍历原始参数
+    const view_t* end() const
+    {
+        return data_ + size_;
+    }
+
+    // to_args 复制为args_t，已去除头尾的引号
+    std::vector<std::string> to_args() const
+    {
+        std::vector<std::string> args;
+        args.reserve(size_);
+        for (size_t i = 0; i < size_; i++)
+        {
+            args.push_back(str(i));
+        }
+        return args;
+    }
+
+private:
+    const view_t* data_{ nullptr };
+    size_t size_{ 0 };
+};
+
 // ----------------------------------------------------------------------------
 // types
 
@@ -287,6 +604,69 @@ using flags_t = std::unordered_map<std::string, pflag_t>;
 /// func_t 命令函数
 using func_t = std::function<error_t(const pcmd_t& pcmd, const args_t& args)>;
 
+/// vfunc_t 命令函数，参数为视图，不复制参数
+using vfunc_t = std::function<error_t(const pcmd_t& pcmd, const args_view_t& args)>;
+
+/// done_t 完成回调
+using done_t = std::function<void(const error_t& err)>;
+
+/// afunc_t 异步命令函数，完成时调用一次done，可以在其他线程中调用，重复调用时忽略
+/// 参数视图和解析上下文在done之前一直有效，但只在函数中是当前上下文：
+/// 其他线程中的延续需要先取出flag的值，或者用bind_context绑定上下文。
+using afunc_t = std::function<void(const pcmd_t& pcmd, const args_view_t& args, const done_t& done)>;
+
+/// batch_policy_t 批处理出错时的策略
+enum class batch_policy_t
+{
+    stop,       // 在第一个出错的行停止
+    keep_going, // 继续执行后面的行
+};
+
+/// builtin_t 根命令上可选的内置标记，按位组合，默认都不添加
+enum class builtin_t : uint32_t
+{
+    none = 0,
+    batch = 1,      // --batch --keep-going --jobs --independent
+    serve = 2,      // --serve，只在linux上有效
+    completion = 4, // --completion
+    all = 7,
+};
+
+inline builtin_t operator|(builtin_t lhs, builtin_t rhs)
+{
+    return static_cast<builtin_t>(static_cast<uint32_t>(lhs) | static_cast<uint32_t>(rhs));
+}
+
+inline bool operator&(builtin_t lhs, builtin_t rhs)
+{
+    return (static_cast<uint32_t>(lhs) & static_cast<uint32_t>(rhs)) != 0;
+}
+
+/// batch_report_t 批处理中每行的执行结果，line从1开始
+using batch_report_t = std::function<void(size_t line, const error_t& err)>;
+
+/// batch_options_t 批处理选项
+struct batch_options_t
+{
+    // policy 出错时的策略
+    batch_policy_t policy{ batch_policy_t::stop };
+
+    // report 每行的执行结果，按输入的顺序报告
+    batch_report_t report{ nullptr };
+
+    // jobs 执行的线程数，1为串行执行，0为CPU核数
+    size_t jobs{ 1 };
+
+    // independent 所有行都相互独立；否则只有以&开始的行可以并行执行
+    bool independent{ false };
+};
+
+/// invalid_id 无效的ID
+static constexpr const uint32_t invalid_id = 0xffffffff;
+
+/// short_limit 快捷名称的取值范围，只能是ASCII字符
+static constexpr const uint32_t short_limit = 128;
+
 // _init_func_t 初始化函数
 using _init_func_t = std::function<error_t(void)>;
 
@@ -359,6 +739,22 @@ public:
         return std::move(str.substr(first, last - first + 1));
     }
 
+    // join 连接字符串
+    // @param d std::string 分隔符
+    static std::string join(const std::vector<std::string>& items, const std::string& d)
+    {
+        std::string ret;
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            if (i != 0)
+            {
+                ret.append(d);
+            }
+            ret.append(items[i]);
+        }
+        return ret;
+    }
+
     // split 切分字符串
     // @brief 是否需要支持移动语义或修改函数定义来保证性能？
     // @param str std::string 字符串
@@ -398,6 +794,175 @@ public:
         return;
     }
 
+    // split 切分字符串，结果为视图，不复制
+    // 规则与 split(std::vector<std::string>&, ...) 一致
+    // @param str view_t 字符串，切分结果引用其内存
+    // @param d char 分隔符
+    static void split(views_t& dst, const view_t& str, char d = ' ')
+    {
+        dst.clear();
+
+        size_t pos1 = 0;
+        size_t pos2 = str.find(d);
+        while (view_t::npos != pos2)
+        {
+            dst.push_back(str.substr(pos1, pos2 - pos1));
+            pos1 = pos2 + 1;
+            pos2 = str.find(d, pos1);
+        }
+        dst.push_back(str.substr(pos1));
+    }
+
+    // split_blank 按空白字符切分，忽略连续的空白字符，结果为视图，不复制
+    // @param str view_t 字符串，切分结果引用其内存
+    static void split_blank(views_t& dst, const view_t& str)
+    {
+        dst.clear();
+
+        size_t pos = 0;
+        while (pos < str.size())
+        {
+            while (pos < str.size() && is_blank(str[pos]))
+            {
+                pos++;
+            }
+            size_t begin = pos;
+            while (pos < str.size() && !is_blank(str[pos]))
+            {
+                pos++;
+            }
+            if (pos != begin)
+            {
+                dst.push_back(str.substr(begin, pos - begin));
+            }
+        }
+    }
+
+    // split_quoted 按shell的规则切分，追加到dst
+    // 空白字符分隔，单引号内原样保留，双引号内和引号外可以用\转义，以#开始的词到行尾是注释
+    // 没有引号和转义的词，以及整个被一对引号包含的词直接引用str，其他的词去掉引号和转义后保存在held中
+    // @return bool 引号不匹配时返回false
+    static bool split_quoted(views_t& dst, const view_t& str, std::list<std::string>& held)
+    {
+        size_t size = str.size();
+        size_t pos = 0;
+        while (true)
+        {
+            while (pos < size && is_blank(str[pos]))
+            {
+                pos++;
+            }
+            if (pos >= size)
+            {
+                return true;
+            }
+            if (str[pos] == '#')
+            {
+                pos = str.find('\n', pos);
+                if (pos == view_t::npos)
+                {
+                    return true;
+                }
+                continue;
+            }
+
+            size_t begin = pos;
+            while (pos < size && !is_blank(str[pos]) && str[pos] != '\'' && str[pos] != '"' && str[pos] != '\\')
+            {
+                pos++;
+            }
+            if (pos >= size || is_blank(str[pos]))
+            {
+                dst.push_back(str.substr(begin, pos - begin));
+                continue;
+            }
+
+            char quote = str[pos];
+            if (pos == begin && quote != '\\')
+            {
+                size_t close = pos + 1;
+                while (close < size && str[close] != quote && !(quote == '"' && str[close] == '\\'))
+                {
+                    close++;
+                }
+                if (close < size && str[close] == quote && (close + 1 == size || is_blank(str[close + 1])))
+                {
+                    dst.push_back(str.substr(pos + 1, close - pos - 1));
+                    pos = close + 1;
+                    continue;
+                }
+            }
+
+            std::string word(str.data() + begin, pos - begin);
+            while (pos < size && !is_blank(str[pos]))
+            {
+                char c = str[pos++];
+                if (c == '\\')
+                {
+                    if (pos < size)
+                    {
+                        word.push_back(str[pos++]);
+                    }
+                }
+                else if (c == '\'')
+                {
+                    auto close = str.find('\'', pos);
+                    if (close == view_t::npos)
+                    {
+                        return false;
+                    }
+                    word.append(str.data() + pos, close - pos);
+                    pos = close + 1;
+                }
+                else if (c == '"')
+                {
+                    while (pos < size && str[pos] != '"')
+                    {
+                        if (str[pos] == '\\' && pos + 1 < size
+                            && str[pos + 1] != '\0' && strchr("\"\\$`", str[pos + 1]) != nullptr)
+                        {
+                            pos++;
+                        }
+                        word.push_back(str[pos++]);
+                    }
+                    if (pos >= size)
+                    {
+                        return false;
+                    }
+                    pos++;
+                }
+                else
+                {
+                    word.push_back(c);
+                }
+            }
+            held.push_back(std::move(word));
+            dst.push_back(view_t(held.back()));
+        }
+    }
+
+    // trim_blank 去除头尾的空白字符，不复制
+    static view_t trim_blank(const view_t& str)
+    {
+        size_t first = 0;
+        size_t last = str.size();
+        while (first < last && is_blank(str[first]))
+        {
+            first++;
+        }
+        while (last > first && is_blank(str[last - 1]))
+        {
+            last--;
+        }
+        return str.substr(first, last - first);
+    }
+
+    // is_blank 是否为空白字符
+    static bool is_blank(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
     // filename 文件名
     static std::string filename(const char* sz)
     {
@@ -448,660 +1013,1028 @@ private:
 };
 
 // ----------------------------------------------------------------------------
-// flag
+// mapped_file_t
 
-// flag_cast_exception cast exception
-class flag_cast_exception : public std::exception
+// mapped_file_t 只读的文件内容
+// POSIX上使用mmap映射到内存，不复制；其他平台一次性读入内存。
+class mapped_file_t
 {
 public:
-    flag_cast_exception()
+    mapped_file_t()
     {
     }
 
-    virtual ~flag_cast_exception()
+    ~mapped_file_t()
     {
+        close();
     }
 
-    explicit flag_cast_exception(const char* msg)
-        : msg_(msg)
-    {
-    }
-
-    explicit flag_cast_exception(const std::string& msg)
-        : msg_(msg)
+    // open 打开并映射文件
+    error_t open(const std::string& path)
     {
+        close();
+#ifndef _WIN32
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return make_error("error: can not open file.", path);
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0)
+        {
+            ::close(fd);
+            return make_error("error: can not stat file.", path);
+        }
+        if (st.st_size == 0)
+        {
+            ::close(fd);
+            return ok;
+        }
+        void* addr = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED)
+        {
+            return make_error("error: can not map file.", path);
+        }
+        data_ = static_cast<const char*>(addr);
+        size_ = static_cast<size_t>(st.st_size);
+        mapped_ = true;
+#else
+        std::ifstream ifs(path.c_str(), std::ios::in | std::ios::binary);
+        if (!ifs)
+        {
+            return make_error("error: can not open file.", path);
+        }
+        buffer_.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+        data_ = buffer_.data();
+        size_ = buffer_.size();
+#endif
+        return ok;
     }
 
-    flag_cast_exception(const flag_cast_exception& cpy)
-        : msg_(cpy.msg_)
+    // close 释放映射
+    void close()
     {
+#ifndef _WIN32
+        if (mapped_)
+        {
+            ::munmap(const_cast<char*>(data_), size_);
+        }
+#endif
+        buffer_.clear();
+        data_ = "";
+        size_ = 0;
+        mapped_ = false;
     }
 
-    flag_cast_exception(flag_cast_exception&& mv) noexcept
-        : msg_(std::move(mv.msg_))
+    // view 文件内容
+    view_t view() const
     {
+        return view_t(data_, size_);
     }
 
-    flag_cast_exception& operator=(const flag_cast_exception& rhs)
-    {
-        msg_ = rhs.msg_;
-        return *this;
-    }
+private:
+    mapped_file_t(const mapped_file_t& cpy) = delete;
+    mapped_file_t& operator=(const mapped_file_t& rhs) = delete;
 
-    void msg(const std::string& msg)
-    {
-        msg_ = msg;
-    }
+    // data_ size_ 文件内容
+    const char* data_{ "" };
+    size_t size_{ 0 };
 
-    virtual const char* what()
-    {
-        return msg_.c_str();
-    }
+    // mapped_ 是否为mmap映射的内存
+    bool mapped_{ false };
 
-private:
-    std::string msg_;
+    // buffer_ 不支持mmap时读入的内容
+    std::string buffer_;
 };
 
-// flag_t 
-class flag_t
+// ----------------------------------------------------------------------------
+// executor_t
+
+/// executor_t 执行器接口
+class executor_t
 {
 public:
-    flag_t()
+    virtual ~executor_t()
     {
     }
 
-    flag_t(const flag_t& cpy)
-        : holder_(cpy.clone())
-        , extend_(cpy.extend_)
-        , exist_(cpy.exist_)
-        , required_(cpy.required_)
-        , name_(cpy.name_)
-        , fast_(cpy.fast_)
-        , desc_(cpy.desc_)
-        , stack_(cpy.stack_)
-        , default_(cpy.default_)
-        , text_(cpy.text_)
-        , oneof_(cpy.oneof_)
-    {
-    }
+    /// post 提交任务，任务可以在任意线程中执行
+    virtual void post(std::function<void()> task) = 0;
+};
 
-    flag_t(flag_t&& mv) noexcept
-        : holder_(std::move(mv.holder_))
-        , extend_(mv.extend_)
-        , exist_(mv.exist_)
-        , required_(mv.required_)
-        , name_(std::move(mv.name_))
-        , fast_(std::move(mv.fast_))
-        , desc_(std::move(mv.desc_))
-        , stack_(std::move(mv.stack_))
-        , default_(std::move(mv.default_))
-        , text_(std::move(mv.text_))
-        , oneof_(std::move(mv.oneof_))
+// ----------------------------------------------------------------------------
+// pool_t
+
+// pool_t 工作窃取的线程池
+// 每个工作线程有自己的任务队列，从队首取任务；自己的队列为空时从其他队列的队尾窃取。
+// 析构时等待所有任务执行完成。
+class pool_t : public executor_t
+{
+public:
+    using task_t = std::function<void()>;
+
+    explicit pool_t(size_t threads)
     {
+        if (threads == 0)
+        {
+            threads = 1;
+        }
+        for (size_t i = 0; i < threads; i++)
+        {
+            queues_.emplace_back(new queue_t());
+        }
+        for (size_t i = 0; i < threads; i++)
+        {
+            threads_.emplace_back(&pool_t::run, this, i);
+        }
     }
 
-    flag_t& operator=(const flag_t& rhs)
+    virtual ~pool_t()
     {
-        if (holder_ == rhs.holder_)
+        for (auto& item : queues_)
         {
-            return *this;
+            {
+                std::lock_guard<std::mutex> lock(item->mutex);
+                item->stop = true;
+            }
+            item->cv.notify_one();
+        }
+        for (auto& item : threads_)
+        {
+            item.join();
         }
-        holder_ = rhs.clone();
-        extend_ = rhs.extend_;
-        exist_ = rhs.exist_;
-        required_ = rhs.required_;
-        name_ = rhs.name_;
-        fast_ = rhs.fast_;
-        desc_ = rhs.desc_;
-        stack_ = rhs.stack_;
-        default_ = rhs.default_;
-        text_ = rhs.text_;
-        oneof_ = rhs.oneof_;
-        return *this;
     }
 
-    /// is_null 是否为空
-    bool is_null()
+    // size 线程数
+    size_t size() const
     {
-        return !bool(holder_);
+        return threads_.size();
     }
 
-    /// type_name 类型名称
-    std::string type_name()
+    // push 添加任务，依次放入各个线程的队列
+    // 只锁目标队列；所属线程正忙而有线程空闲时，唤醒一个空闲线程来窃取。
+    // 先增加pending_再读idle_，和run中的顺序相反，两边至少有一方能看到对方
+    void push(task_t task)
     {
-        if (!bool(holder_))
+        auto count = queues_.size();
+        auto index = next_.fetch_add(1, std::memory_order_relaxed) % count;
+        auto& queue = *queues_[index];
+        bool idle = false;
         {
-            return "null";
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+            pending_.fetch_add(1, std::memory_order_seq_cst);
+            idle = queue.idle;
         }
-        if (holder_->type_index() == typeid(std::string))
+        if (idle)
         {
-            return "std::string";
+            queue.cv.notify_one();
+            return;
+        }
+        if (idle_.load(std::memory_order_seq_cst) == 0)
+        {
+            return;
+        }
+        for (size_t i = 1; i < count; i++)
+        {
+            auto& other = *queues_[(index + i) % count];
+            std::unique_lock<std::mutex> lock(other.mutex);
+            if (other.idle && !other.wake)
+            {
+                other.wake = true;
+                lock.unlock();
+                other.cv.notify_one();
+                return;
+            }
         }
-        return holder_->type_index().name();
     }
 
-    /// castable 是否可以转换为指定类型
-    template<class T>
-    bool castable()
+    // post 提交任务
+    virtual void post(std::function<void()> task)
     {
-        if (!bool(holder_))
-        {
-            return false;
-        }
-        return holder_->type_index() == std::type_index(typeid(T));
+        push(std::move(task));
     }
 
-    /// cast 转换，类型不一致时会抛出异常
-    template<class T>
-    T& cast()
+private:
+    pool_t(const pool_t& cpy) = delete;
+    pool_t& operator=(const pool_t& rhs) = delete;
+
+    // queue_t 任务队列，每个线程一个，有自己的锁和条件变量
+    struct queue_t
+    {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<task_t> tasks;
+
+        // idle 所属线程正在等待
+        bool idle{ false };
+
+        // wake 被唤醒去窃取其他队列的任务
+        bool wake{ false };
+
+        // stop 是否停止
+        bool stop{ false };
+    };
+
+    // pop 取任务，先取自己的队首，再窃取其他队列的队尾
+    // 窃取时在其他队列的锁上等待，不会因为队列正被占用而漏掉其中的任务
+    bool pop(size_t self, task_t& task)
     {
-        if (!castable<T>())
+        for (size_t i = 0; i < queues_.size(); i++)
         {
-            if (!bool(holder_))
+            auto& queue = *queues_[(self + i) % queues_.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty())
+            {
+                continue;
+            }
+            pending_.fetch_sub(1, std::memory_order_relaxed);
+            if (i == 0)
             {
-                throw flag_cast_exception(
-                    std::string("can not cast null")
-                    + " to " + typeid(T).name()
-                );
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
             }
             else
             {
-                throw flag_cast_exception(
-                    std::string("can not cast ") + holder_->type_index().name()
-                    + " to " + typeid(T).name()
-                );
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
             }
+            return true;
         }
-        auto ptr = dynamic_cast<value_holder<T>*>(holder_.get());
-        return ptr->value_;
+        return false;
     }
 
-    /// is_oneof 是否为合法枚举值
-    bool is_oneof(const std::string& text)
+    // run 工作线程，没有任务时在自己的队列上等待，停止时处理完自己队列中的任务再退出
+    // 标记为空闲后再检查一次pending_，pop和标记之间放入其他队列的任务不会没有线程处理
+    void run(size_t self)
     {
-        if (oneof_.size() == 0)
-        {
-            return true; // 不是枚举类型，就都合法
-        }
-        auto it = oneof_.begin();
-        while (it != oneof_.end())
+        auto& own = *queues_[self];
+        for (;;)
         {
-            if (*it == text)
+            task_t task;
+            if (pop(self, task))
             {
-                break;
+                task();
+                continue;
             }
-        }
-        return (it != oneof_.end());
-    }
-
-    /// parse 解析
-    error_t parse(const std::string& text)
-    {
-        if (!bool(holder_))
-        {
-            return make_error("flag is null", stack_);
-        }
-        if (oneof_.size() != 0)
-        {
-            auto it = oneof_.begin();
-            for (; it != oneof_.end(); ++it)
+            std::unique_lock<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty())
             {
-                if (*it == text)
-                {
-                    break;
-                }
+                continue;
             }
-            if (it == oneof_.end())
+            if (own.stop)
             {
-                return make_error("not one of flag options.", stack_);
+                return;
             }
+            own.idle = true;
+            idle_.fetch_add(1, std::memory_order_seq_cst);
+            if (pending_.load(std::memory_order_seq_cst) != 0)
+            {
+                idle_.fetch_sub(1, std::memory_order_release);
+                own.idle = false;
+                continue;
+            }
+            own.cv.wait(lock, [&own]() { return own.stop || own.wake || !own.tasks.empty(); });
+            idle_.fetch_sub(1, std::memory_order_release);
+            own.idle = false;
+            own.wake = false;
         }
-        text_ = text;
-        if (!holder_->parse(text))
-        {
-            return make_error(std::string("parse failed. type must be ") + holder_->type_index().name(), stack_);
-        }
-        return ok;
     }
 
-    /// extend 继承属性
-    void extend(bool extend)
-    {
-        extend_ = extend;
-    }
+    // queues_ 每个线程的任务队列
+    std::vector<std::unique_ptr<queue_t>> queues_;
 
-    /// extend 继承属性
-    bool extend()
-    {
-        return extend_;
-    }
+    // threads_ 工作线程
+    std::vector<std::thread> threads_;
 
-    /// exist 是否存在
-    void exist(bool exist)
-    {
-        exist_ = exist;
-    }
+    // next_ 下一个任务放入的队列
+    std::atomic<size_t> next_{ 0 };
 
-    /// exist 是否存在
-    bool exist()
-    {
-        return exist_;
-    }
+    // idle_ 正在等待的线程数，没有空闲线程时push不需要查找
+    std::atomic<size_t> idle_{ 0 };
 
-    /// name 名称
-    void name(const std::string& name)
-    {
-        name_ = name;
-    }
+    // pending_ 所有队列中还没有取出的任务数
+    std::atomic<size_t> pending_{ 0 };
+};
 
-    /// name 名称
-    std::string name()
-    {
-        return name_;
-    }
+// ----------------------------------------------------------------------------
+// convert
 
-    /// fast 快捷名称
-    void fast(const std::string& fast)
+// convert 字符串到值的转换
+// 其他类型使用std::stringstream，只作为自定义类型的兜底实现。
+template<class T, class Enable = void>
+struct convert
+{
+    static bool parse(const view_t& text, T& value)
     {
-        fast_ = fast;
+        std::stringstream iss(text.str());
+        iss >> value;
+        return !!iss;
     }
+};
 
-    /// fast 快捷名称
-    std::string fast()
+// convert_kernel 转换函数
+// 整数、浮点数和bool的转换是手写的：与from_chars类似，不依赖locale，不分配内存，
+// 严格检查溢出和多余的字符，如 "12abc" 和无符号类型的负数都会转换失败。
+class convert_kernel
+{
+public:
+    // parse_unsigned 解析无符号整数，不接受负号
+    template<class T>
+    static bool parse_unsigned(const view_t& text, T& value)
     {
-        return fast_;
+        const char* p = text.begin();
+        const char* end = text.end();
+        if (p != end && *p == '+')
+        {
+            p++;
+        }
+        uint64_t ret = 0;
+        if (!parse_digits(p, end, static_cast<uint64_t>(std::numeric_limits<T>::max()), ret))
+        {
+            return false;
+        }
+        value = static_cast<T>(ret);
+        return true;
     }
 
-    /// desc 描述
-    void desc(const std::string& desc)
+    // parse_signed 解析有符号整数
+    template<class T>
+    static bool parse_signed(const view_t& text, T& value)
     {
-        desc_ = desc;
+        const char* p = text.begin();
+        const char* end = text.end();
+        bool negative = false;
+        if (p != end && (*p == '+' || *p == '-'))
+        {
+            negative = (*p == '-');
+            p++;
+        }
+        // 负数的绝对值上限比正数大1
+        uint64_t limit = static_cast<uint64_t>(std::numeric_limits<T>::max()) + (negative ? 1 : 0);
+        uint64_t ret = 0;
+        if (!parse_digits(p, end, limit, ret))
+        {
+            return false;
+        }
+        if (negative)
+        {
+            value = static_cast<T>(0 - static_cast<int64_t>(ret - 1) - 1);
+        }
+        else
+        {
+            value = static_cast<T>(ret);
+        }
+        return true;
     }
 
-    /// desc 描述
-    std::string desc()
+    // parse_float 解析浮点数，[+-]digits[.digits][(e|E)[+-]digits]
+    template<class T>
+    static bool parse_float(const view_t& text, T& value)
     {
-        return desc_;
+        double ret = 0;
+        if (!parse_double(text, ret))
+        {
+            return false;
+        }
+        if (ret > std::numeric_limits<T>::max() || ret < -std::numeric_limits<T>::max())
+        {
+            return false;
+        }
+        value = static_cast<T>(ret);
+        return true;
     }
 
-    // stack 堆栈，可确定命令分支的位置
-    void stack(const std::string& stack)
+    // parse_bool 解析bool，1/0/true/false/True/False
+    static bool parse_bool(const view_t& text, bool& value)
     {
-        stack_ = stack;
+        if (text == "1" || text == "true" || text == "True")
+        {
+            value = true;
+            return true;
+        }
+        if (text == "0" || text == "false" || text == "False")
+        {
+            value = false;
+            return true;
+        }
+        return false;
     }
 
-    // stack 堆栈，可确定命令分支的位置
-    const std::string& stack() const
+private:
+    // parse_digits 解析十进制数字直到结尾，超过limit时失败
+    static bool parse_digits(const char* p, const char* end, uint64_t limit, uint64_t& value)
     {
-        return stack_;
+        if (p == end)
+        {
+            return false;
+        }
+        uint64_t ret = 0;
+        for (; p != end; p++)
+        {
+            unsigned digit = static_cast<unsigned char>(*p) - '0';
+            if (digit > 9)
+            {
+                return false;
+            }
+            if (ret > (limit - digit) / 10)
+            {
+                return false;
+            }
+            ret = ret * 10 + digit;
+        }
+        value = ret;
+        return true;
     }
 
-    /// default_value 默认值的字符串表示
-    std::string default_value()
+    // parse_double 解析双精度浮点数
+    // 有效数字不超过2^53且十进制指数不超过22时结果是精确的(Clinger快速路径)，
+    // 其他情况交给strtod处理。
+    static bool parse_double(const view_t& text, double& value)
     {
-        return default_;
-    }
-
-    /// text 输入的字符串
-    std::string text()
-    {
-        return text_;
-    }
+        static const double pow10[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
 
-    /// oneof 枚举值列表
-    std::vector<std::string>& oneof()
-    {
-        return oneof_;
-    }
+        const char* p = text.begin();
+        const char* end = text.end();
+        bool negative = false;
+        if (p != end && (*p == '+' || *p == '-'))
+        {
+            negative = (*p == '-');
+            p++;
+        }
 
-    /// set 设置
-    template <class T,
-        class = typename std::enable_if<!std::is_pointer<T>::value
-        && !std::is_const<T>::value 
-        && !std::is_reference<T>::value
-        && !std::is_same<T, bool>::value
-        && !std::is_same<T, std::string>::value
-        && !std::is_same<T, unsigned char>::value
-        && !std::is_same<T, char>::value
-        && !std::is_same<T, signed char>::value, T>::type>
-    error_t set(const std::string& name, const std::string& fast, T default_v, 
-        const std::string& desc, bool extend = false)
-    {
-        auto err = set_value<T>(name, fast, default_v, desc, extend);
-        if (err != ok)
+        uint64_t mantissa = 0;
+        int digits = 0;     // 计入mantissa的有效数字
+        int dropped = 0;    // mantissa溢出后丢弃的整数部分数字
+        int fraction = 0;   // 计入mantissa的小数部分数字
+        bool any = false;
+        bool inexact = false;
+        for (; p != end && *p >= '0' && *p <= '9'; p++)
         {
-            return err;
+            any = true;
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += (mantissa != 0) ? 1 : 0;
+            }
+            else
+            {
+                dropped++;
+                inexact = inexact || (*p != '0');
+            }
+        }
+        if (p != end && *p == '.')
+        {
+            p++;
+            for (; p != end && *p >= '0' && *p <= '9'; p++)
+            {
+                any = true;
+                if (digits < 19)
+                {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    digits += (mantissa != 0) ? 1 : 0;
+                    fraction++;
+                }
+                else
+                {
+                    inexact = inexact || (*p != '0');
+                }
+            }
+        }
+        if (!any)
+        {
+            return false;
         }
 
-        std::stringstream oss;
-        oss << "" << default_v;
-        default_ = oss.str();
+        int64_t exponent = 0;
+        if (p != end && (*p == 'e' || *p == 'E'))
+        {
+            p++;
+            bool exp_negative = false;
+            if (p != end && (*p == '+' || *p == '-'))
+            {
+                exp_negative = (*p == '-');
+                p++;
+            }
+            if (p == end)
+            {
+                return false;
+            }
+            for (; p != end && *p >= '0' && *p <= '9'; p++)
+            {
+                if (exponent < 100000)
+                {
+                    exponent = exponent * 10 + (*p - '0');
+                }
+            }
+            if (exp_negative)
+            {
+                exponent = -exponent;
+            }
+        }
+        if (p != end)
+        {
+            return false; // 多余的字符
+        }
 
-        return ok;
+        exponent += dropped - fraction;
+        double ret = 0;
+        if (mantissa == 0)
+        {
+            ret = 0;
+        }
+        else if (!inexact && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22)
+        {
+            ret = static_cast<double>(mantissa);
+            ret = (exponent < 0) ? ret / pow10[-exponent] : ret * pow10[exponent];
+        }
+        else if (!slow_double(text, ret))
+        {
+            return false;
+        }
+        else
+        {
+            value = ret; // strtod已处理符号
+            return ret <= std::numeric_limits<double>::max() && ret >= -std::numeric_limits<double>::max();
+        }
+        value = negative ? -ret : ret;
+        return true;
     }
 
-    /// set 设置
-    template <class T,
-        class = bool>
-    error_t set(const std::string& name, const std::string& fast, 
-        bool default_v, const std::string& desc, bool extend)
+    // slow_double 慢速路径，复制到栈上的缓冲区后使用strtod
+    // strtod依赖locale的小数点，小数点不是'.'时使用classic locale的流兜底
+    static bool slow_double(const view_t& text, double& value)
     {
-        auto err = set_value<bool>(name, fast, default_v, desc, extend);
-        if (err != ok)
+        char buffer[128];
+        const char* point = localeconv()->decimal_point;
+        if (text.size() < sizeof(buffer) && nullptr != point && point[0] == '.' && point[1] == '\0')
         {
-            return err;
+            memcpy(buffer, text.data(), text.size());
+            buffer[text.size()] = '\0';
+            char* end = nullptr;
+            value = strtod(buffer, &end);
+            return end == buffer + text.size();
         }
+        std::istringstream iss(text.str());
+        iss.imbue(std::locale::classic());
+        iss >> value;
+        return !iss.fail() && iss.peek() == std::char_traits<char>::eof();
+    }
+};
 
-        default_ = default_v ? "true" : "false";
-
-        return ok;
+// convert 有符号整数
+template<class T>
+struct convert<T, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value
+    && !std::is_same<T, char>::value>::type>
+{
+    static bool parse(const view_t& text, T& value)
+    {
+        return convert_kernel::parse_signed<T>(text, value);
     }
+};
 
-    /// set 设置
-    template <class T,
-        class = char>
-    error_t set(const std::string& name, const std::string& fast,
-        char default_v, const std::string& desc, bool extend)
+// convert 无符号整数
+template<class T>
+struct convert<T, typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value
+    && !std::is_same<T, char>::value && !std::is_same<T, bool>::value>::type>
+{
+    static bool parse(const view_t& text, T& value)
     {
-        auto err = set_value<char>(name, fast, default_v, desc, extend);
-        if (err != ok)
-        {
-            return err;
-        }
+        return convert_kernel::parse_unsigned<T>(text, value);
+    }
+};
 
-        default_ = std::to_string(default_v);
+// convert 浮点数
+template<class T>
+struct convert<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+{
+    static bool parse(const view_t& text, T& value)
+    {
+        return convert_kernel::parse_float<T>(text, value);
+    }
+};
 
-        return ok;
+// convert bool
+template<>
+struct convert<bool>
+{
+    static bool parse(const view_t& text, bool& value)
+    {
+        return convert_kernel::parse_bool(text, value);
     }
+};
 
-    /// set 设置
-    template <class T,
-        class = signed char>
-    error_t set(const std::string& name, const std::string& fast,
-        signed char default_v, const std::string& desc, bool extend)
+// convert char，单个字符
+template<>
+struct convert<char>
+{
+    static bool parse(const view_t& text, char& value)
     {
-        auto err = set_value<signed char>(name, fast, default_v, desc, extend);
-        if (err != ok)
+        if (text.size() != 1)
         {
-            return err;
+            return false;
         }
+        value = text[0];
+        return true;
+    }
+};
 
-        default_ = std::to_string(default_v);
+// convert std::string，完整复制
+template<>
+struct convert<std::string>
+{
+    static bool parse(const view_t& text, std::string& value)
+    {
+        value.assign(text.data(), text.size());
+        return true;
+    }
+};
 
-        return ok;
+// convert std::vector<T>，以逗号分隔的列表，空字符串为空列表
+// 先按分隔符数量预留空间，再用memchr查找分隔符，元素直接从视图转换，不生成中间字符串
+template<class T>
+struct convert<std::vector<T>>
+{
+    static bool parse(const view_t& text, std::vector<T>& value)
+    {
+        value.clear();
+        return append(text, value);
     }
 
-    /// set 设置
-    template <class T,
-        class = unsigned char>
-    error_t set(const std::string& name, const std::string& fast,
-        unsigned char default_v, const std::string& desc, bool extend)
+    // append 追加到列表末尾，用于重复的标记，失败时列表保持不变
+    static bool append(const view_t& text, std::vector<T>& value)
     {
-        auto err = set_value<unsigned char>(name, fast, default_v, desc, extend);
-        if (err != ok)
+        if (text.empty())
         {
-            return err;
+            return true;
+        }
+        auto size = value.size();
+        value.reserve(size + std::count(text.begin(), text.end(), ',') + 1);
+        const char* p = text.begin();
+        const char* end = text.end();
+        while (true)
+        {
+            auto next = static_cast<const char*>(memchr(p, ',', end - p));
+            auto last = (nullptr == next) ? end : next;
+            value.emplace_back();
+            if (!convert<T>::parse(view_t(p, last - p), value.back()))
+            {
+                value.resize(size);
+                return false;
+            }
+            if (nullptr == next)
+            {
+                return true;
+            }
+            p = next + 1;
         }
+    }
+};
 
-        default_ = std::to_string(default_v);
+// convert_repeat 重复的标记：列表追加，其他类型覆盖
+template<class T>
+struct convert_repeat
+{
+    static const bool list = false;
 
-        return ok;
+    static bool append(const view_t& text, T& value)
+    {
+        return convert<T>::parse(text, value);
     }
+};
 
-    /// set 设置
-    template <class T,
-        class = std::string>
-    error_t set(const std::string& name, const std::string& fast, 
-        const std::string& default_v, const std::string& desc, bool extend)
+// convert_repeat std::vector<T>
+template<class T>
+struct convert_repeat<std::vector<T>>
+{
+    static const bool list = true;
+
+    static bool append(const view_t& text, std::vector<T>& value)
     {
-        auto err = set_value<std::string>(name, fast, default_v, desc, extend);
-        if (err != ok)
-        {
-            return err;
-        }
+        return convert<std::vector<T>>::append(text, value);
+    }
+};
 
-        default_ = default_v;
+// ----------------------------------------------------------------------------
+// flag
 
-        return ok;
+// flag_cast_exception cast exception
+class flag_cast_exception : public std::exception
+{
+public:
+    flag_cast_exception()
+    {
     }
 
-    /// set 设置
-    template <class T,
-        class = typename std::enable_if<!std::is_pointer<T>::value
-        && !std::is_const<T>::value
-        && !std::is_reference<T>::value
-        && !std::is_same<T, double>::value
-        && !std::is_same<T, float>::value
-        && !std::is_same<T, bool>::value
-        && !std::is_same<T, std::string>::value
-        && !std::is_same<T, unsigned char>::value
-        && !std::is_same<T, char>::value
-        && !std::is_same<T, signed char>::value, T>::type>
-    error_t set(const std::string& name, const std::string& fast, T default_v,
-        const std::vector<T>& options, const std::string& desc, bool extend = false)
+    virtual ~flag_cast_exception()
     {
-        auto err = set_value<T>(name, fast, default_v, desc, extend);
-        if (err != ok)
-        {
-            return err;
-        }
-
-        std::stringstream oss;
-        oss << default_v;
-        default_ = oss.str();
+    }
 
-        oneof_.clear();
-        for (auto& item : options)
-        {
-            std::stringstream oss;
-            oss << item;
-            oneof_.push_back(oss.str());
-        }
+    explicit flag_cast_exception(const char* msg)
+        : msg_(msg)
+    {
+    }
 
-        return ok;
+    explicit flag_cast_exception(const std::string& msg)
+        : msg_(msg)
+    {
     }
 
-    /// set 设置
-    template <class T,
-        class = char>
-    error_t set(const std::string& name, const std::string& fast, char default_v,
-        const std::vector<char>& options, const std::string& desc, bool extend = false)
+    flag_cast_exception(const flag_cast_exception& cpy)
+        : msg_(cpy.msg_)
     {
-        auto err = set_value<char>(name, fast, default_v, desc, extend);
-        if (err != ok)
-        {
-            return err;
-        }
+    }
 
-        default_ = std::to_string(default_v);
+    flag_cast_exception(flag_cast_exception&& mv) noexcept
+        : msg_(std::move(mv.msg_))
+    {
+    }
 
-        oneof_.clear();
-        for (auto& item : options)
-        {
-            oneof_.push_back(std::to_string(item));
-        }
+    flag_cast_exception& operator=(const flag_cast_exception& rhs)
+    {
+        msg_ = rhs.msg_;
+        return *this;
+    }
 
-        return ok;
+    void msg(const std::string& msg)
+    {
+        msg_ = msg;
     }
 
-    /// set 设置
-    template <class T,
-        class = signed char>
-    error_t set(const std::string& name, const std::string& fast, signed char default_v,
-        const std::vector<signed char>& options, const std::string& desc, bool extend = false)
+    virtual const char* what()
     {
-        auto err = set_value<signed char>(name, fast, default_v, desc, extend);
-        if (err != ok)
-        {
-            return err;
-        }
+        return msg_.c_str();
+    }
 
-        default_ = std::to_string(default_v);
+private:
+    std::string msg_;
+};
 
-        oneof_.clear();
-        for (auto& item : options)
-        {
-            oneof_.push_back(std::to_string(item));
-        }
+// flag_t 
+class flag_t
+{
+public:
+    flag_t()
+    {
+    }
 
-        return ok;
+    flag_t(const flag_t& cpy)
+        : holder_(cpy.clone())
+        , extend_(cpy.extend_)
+        , required_(cpy.required_)
+        , name_(cpy.name_)
+        , fast_(cpy.fast_)
+        , desc_(cpy.desc_)
+        , stack_(cpy.stack_)
+        , oneof_(cpy.oneof_)
+    {
+        index_oneof();
     }
 
-    /// set 设置
-    template <class T,
-        class = unsigned char>
-    error_t set(const std::string& name, const std::string& fast, unsigned char default_v,
-        const std::vector<unsigned char>& options, const std::string& desc, bool extend = false)
+    flag_t(flag_t&& mv) noexcept
+        : holder_(std::move(mv.holder_))
+        , extend_(mv.extend_)
+        , required_(mv.required_)
+        , name_(std::move(mv.name_))
+        , fast_(std::move(mv.fast_))
+        , desc_(std::move(mv.desc_))
+        , stack_(std::move(mv.stack_))
+        , oneof_(std::move(mv.oneof_))
+        , oneof_slots_(std::move(mv.oneof_slots_))
+        , oneof_values_(std::move(mv.oneof_values_))
     {
-        auto err = set_value<unsigned char>(name, fast, default_v, desc, extend);
-        if (err != ok)
+    }
+
+    flag_t& operator=(const flag_t& rhs)
+    {
+        if (holder_ == rhs.holder_)
         {
-            return err;
+            return *this;
         }
+        holder_ = rhs.clone();
+        extend_ = rhs.extend_;
+        required_ = rhs.required_;
+        name_ = rhs.name_;
+        fast_ = rhs.fast_;
+        desc_ = rhs.desc_;
+        stack_ = rhs.stack_;
+        oneof_ = rhs.oneof_;
+        index_oneof();
+        return *this;
+    }
 
-        default_ = std::to_string(default_v);
+    /// is_null 是否为空
+    bool is_null()
+    {
+        return !bool(holder_);
+    }
 
-        oneof_.clear();
-        for (auto& item : options)
+    /// type_name 类型名称
+    std::string type_name()
+    {
+        if (!bool(holder_))
         {
-            oneof_.push_back(std::to_string(item));
+            return "null";
+        }
+        if (holder_->type_index() == typeid(std::string))
+        {
+            return "std::string";
         }
+        return holder_->type_index().name();
+    }
 
-        return ok;
+    /// castable 是否可以转换为指定类型
+    template<class T>
+    bool castable()
+    {
+        if (!bool(holder_))
+        {
+            return false;
+        }
+        return holder_->type_index() == std::type_index(typeid(T));
     }
 
-    /// set 设置
-    template <class T,
-        class = std::string>
-    error_t set(const std::string& name, const std::string& fast, const std::string& default_v,
-        const std::vector<std::string>& options, const std::string& desc, bool extend = false)
+    /// cast 转换，类型不一致时会抛出异常
+    /// 在命令执行期间返回当前解析上下文中的值，否则返回默认值
+    template<class T>
+    T& cast();
+
+    /// is_oneof 是否为合法枚举值
+    bool is_oneof(const std::string& text)
     {
-        auto err = set_value<std::string>(name, fast, default_v, desc, extend);
-        if (err != ok)
+        if (oneof_.size() == 0)
         {
-            return err;
+            return true; // 不是枚举类型，就都合法
         }
+        return find_oneof(text) != invalid_id;
+    }
 
-        default_ = default_v;
+    /// ordinal 枚举值在可选项中的序号，不是合法枚举值时为invalid_id
+    uint32_t ordinal(const std::string& text) const
+    {
+        return find_oneof(text);
+    }
 
-        oneof_.clear();
-        for (auto& item : options)
+    /// parse 解析
+    /// 在命令执行期间解析到当前解析上下文中，否则修改默认值
+    error_t parse(const std::string& text);
+
+    /// extend 继承属性
+    void extend(bool extend)
+    {
+        extend_ = extend;
+    }
+
+    /// extend 继承属性
+    bool extend()
+    {
+        return extend_;
+    }
+
+    /// exist 是否存在，仅在命令执行期间有效
+    void exist(bool exist);
+
+    /// exist 是否存在，仅在命令执行期间有效
+    bool exist();
+
+    /// name 名称
+    void name(const std::string& name)
+    {
+        name_ = name;
+    }
+
+    /// name 名称
+    std::string name()
+    {
+        return name_;
+    }
+
+    /// fast 快捷名称
+    void fast(const std::string& fast)
+    {
+        fast_ = fast;
+    }
+
+    /// fast 快捷名称
+    std::string fast()
+    {
+        return fast_;
+    }
+
+    /// desc 描述
+    void desc(const std::string& desc)
+    {
+        desc_ = desc;
+    }
+
+    /// desc 描述
+    std::string desc()
+    {
+        return desc_;
+    }
+
+    // stack 堆栈，可确定命令分支的位置
+    void stack(const std::string& stack)
+    {
+        stack_ = stack;
+    }
+
+    // stack 堆栈，可确定命令分支的位置
+    const std::string& stack() const
+    {
+        return stack_;
+    }
+
+    /// default_value 默认值的字符串表示，只在需要时(如帮助信息)格式化
+    std::string default_value()
+    {
+        if (!bool(holder_))
         {
-            oneof_.push_back(item);
+            return "";
         }
+        return holder_->text();
+    }
 
-        return ok;
+    /// text 输入的字符串，仅在命令执行期间有效
+    std::string text();
+
+    /// oneof 枚举值列表
+    std::vector<std::string>& oneof()
+    {
+        return oneof_;
+    }
+
+    /// id 标记在最近一次freeze的命令表中的ID，未加入过命令表时为invalid_id
+    /// ID只在所属的命令表内有效，同一个标记在不同的命令表中可能不同
+    uint32_t id() const
+    {
+        auto tag = tag_.load(std::memory_order_acquire);
+        return (tag == invalid_tag) ? invalid_id : static_cast<uint32_t>(tag);
     }
 
     /// set 设置
     template <class T,
         class = typename std::enable_if<!std::is_pointer<T>::value
-        && !std::is_const<T>::value
+        && !std::is_const<T>::value 
         && !std::is_reference<T>::value
         && !std::is_same<T, bool>::value
         && !std::is_same<T, std::string>::value
         && !std::is_same<T, unsigned char>::value
         && !std::is_same<T, char>::value
         && !std::is_same<T, signed char>::value, T>::type>
-    error_t set(T* ptr, const std::string& name, const std::string& fast, T default_v,
+    error_t set(const std::string& name, const std::string& fast, T default_v, 
         const std::string& desc, bool extend = false)
     {
-        auto err = set_value<T>(ptr, name, fast, default_v, desc, extend);
-        if (err != ok)
-        {
-            return err;
-        }
-
-        std::stringstream oss;
-        oss << default_v;
-        default_ = oss.str();
-
-        return ok;
+        return set_value<T>(name, fast, default_v, desc, extend);
     }
 
     /// set 设置
     template <class T,
         class = bool>
-    error_t set(bool* ptr, const std::string& name, const std::string& fast, 
-        bool default_v, const std::string& desc, bool extend = false)
+    error_t set(const std::string& name, const std::string& fast, 
+        bool default_v, const std::string& desc, bool extend)
     {
-        auto err = set_value<bool>(ptr, name, fast, default_v, desc, extend);
-        if (err != ok)
-        {
-            return err;
-        }
-
-        default_ = default_v ? "true" : "false";
-
-        return ok;
+        return set_value<bool>(name, fast, default_v, desc, extend);
     }
 
     /// set 设置
     template <class T,
         class = char>
-    error_t set(char* ptr, const std::string& name, const std::string& fast,
-        char default_v, const std::string& desc, bool extend = false)
+    error_t set(const std::string& name, const std::string& fast,
+        char default_v, const std::string& desc, bool extend)
     {
-        auto err = set_value<char>(ptr, name, fast, default_v, desc, extend);
-        if (err != ok)
-        {
-            return err;
-        }
-
-        default_ = std::to_string(default_v);
-
-        return ok;
+        return set_value<char>(name, fast, default_v, desc, extend);
     }
 
     /// set 设置
     template <class T,
         class = signed char>
-    error_t set(signed char* ptr, const std::string& name, const std::string& fast,
-        signed char default_v, const std::string& desc, bool extend = false)
+    error_t set(const std::string& name, const std::string& fast,
+        signed char default_v, const std::string& desc, bool extend)
     {
-        auto err = set_value<signed char>(ptr, name, fast, default_v, desc, extend);
-        if (err != ok)
-        {
-            return err;
-        }
-
-        default_ = std::to_string(default_v);
-
-        return ok;
+        return set_value<signed char>(name, fast, default_v, desc, extend);
     }
 
     /// set 设置
     template <class T,
         class = unsigned char>
-    error_t set(unsigned char* ptr, const std::string& name, const std::string& fast,
-        unsigned char default_v, const std::string& desc, bool extend = false)
+    error_t set(const std::string& name, const std::string& fast,
+        unsigned char default_v, const std::string& desc, bool extend)
     {
-        auto err = set_value<unsigned char>(ptr, name, fast, default_v, desc, extend);
-        if (err != ok)
-        {
-            return err;
-        }
-
-        default_ = std::to_string(default_v);
-
-        return ok;
+        return set_value<unsigned char>(name, fast, default_v, desc, extend);
     }
 
     /// set 设置
     template <class T,
         class = std::string>
-    error_t set(std::string* ptr, const std::string& name, const std::string& fast, 
-        const std::string& default_v, const std::string& desc, bool extend = false)
+    error_t set(const std::string& name, const std::string& fast, 
+        const std::string& default_v, const std::string& desc, bool extend)
     {
-        auto err = set_value<std::string>(ptr, name, fast, default_v, desc, extend);
-        if (err != ok)
-        {
-            return err;
-        }
-
-        default_ = default_v;
-
-        return ok;
+        return set_value<std::string>(name, fast, default_v, desc, extend);
     }
 
     /// set 设置
@@ -1116,18 +2049,196 @@ public:
         && !std::is_same<T, unsigned char>::value
         && !std::is_same<T, char>::value
         && !std::is_same<T, signed char>::value, T>::type>
-    error_t set(T* ptr, const std::string& name, const std::string& fast, T default_v,
+    error_t set(const std::string& name, const std::string& fast, T default_v,
         const std::vector<T>& options, const std::string& desc, bool extend = false)
     {
-        auto err = set_value<T>(ptr, name, fast, default_v, desc, extend);
+        auto err = set_value<T>(name, fast, default_v, desc, extend);
         if (err != ok)
         {
             return err;
         }
 
-        std::stringstream oss;
-        oss << default_v;
-        default_ = oss.str();
+        oneof_.clear();
+        for (auto& item : options)
+        {
+            std::stringstream oss;
+            oss << item;
+            oneof_.push_back(oss.str());
+        }
+        index_oneof();
+
+        return ok;
+    }
+
+    /// set 设置
+    template <class T,
+        class = char>
+    error_t set(const std::string& name, const std::string& fast, char default_v,
+        const std::vector<char>& options, const std::string& desc, bool extend = false)
+    {
+        auto err = set_value<char>(name, fast, default_v, desc, extend);
+        if (err != ok)
+        {
+            return err;
+        }
+
+        oneof_.clear();
+        for (auto& item : options)
+        {
+            oneof_.push_back(to_text(item));
+        }
+        index_oneof();
+
+        return ok;
+    }
+
+    /// set 设置
+    template <class T,
+        class = signed char>
+    error_t set(const std::string& name, const std::string& fast, signed char default_v,
+        const std::vector<signed char>& options, const std::string& desc, bool extend = false)
+    {
+        auto err = set_value<signed char>(name, fast, default_v, desc, extend);
+        if (err != ok)
+        {
+            return err;
+        }
+
+        oneof_.clear();
+        for (auto& item : options)
+        {
+            oneof_.push_back(std::to_string(item));
+        }
+        index_oneof();
+
+        return ok;
+    }
+
+    /// set 设置
+    template <class T,
+        class = unsigned char>
+    error_t set(const std::string& name, const std::string& fast, unsigned char default_v,
+        const std::vector<unsigned char>& options, const std::string& desc, bool extend = false)
+    {
+        auto err = set_value<unsigned char>(name, fast, default_v, desc, extend);
+        if (err != ok)
+        {
+            return err;
+        }
+
+        oneof_.clear();
+        for (auto& item : options)
+        {
+            oneof_.push_back(std::to_string(item));
+        }
+        index_oneof();
+
+        return ok;
+    }
+
+    /// set 设置
+    template <class T,
+        class = std::string>
+    error_t set(const std::string& name, const std::string& fast, const std::string& default_v,
+        const std::vector<std::string>& options, const std::string& desc, bool extend = false)
+    {
+        auto err = set_value<std::string>(name, fast, default_v, desc, extend);
+        if (err != ok)
+        {
+            return err;
+        }
+
+        oneof_.clear();
+        for (auto& item : options)
+        {
+            oneof_.push_back(item);
+        }
+        index_oneof();
+
+        return ok;
+    }
+
+    /// set 设置
+    template <class T,
+        class = typename std::enable_if<!std::is_pointer<T>::value
+        && !std::is_const<T>::value
+        && !std::is_reference<T>::value
+        && !std::is_same<T, bool>::value
+        && !std::is_same<T, std::string>::value
+        && !std::is_same<T, unsigned char>::value
+        && !std::is_same<T, char>::value
+        && !std::is_same<T, signed char>::value, T>::type>
+    error_t set(T* ptr, const std::string& name, const std::string& fast, T default_v,
+        const std::string& desc, bool extend = false)
+    {
+        return set_value<T>(ptr, name, fast, default_v, desc, extend);
+    }
+
+    /// set 设置
+    template <class T,
+        class = bool>
+    error_t set(bool* ptr, const std::string& name, const std::string& fast, 
+        bool default_v, const std::string& desc, bool extend = false)
+    {
+        return set_value<bool>(ptr, name, fast, default_v, desc, extend);
+    }
+
+    /// set 设置
+    template <class T,
+        class = char>
+    error_t set(char* ptr, const std::string& name, const std::string& fast,
+        char default_v, const std::string& desc, bool extend = false)
+    {
+        return set_value<char>(ptr, name, fast, default_v, desc, extend);
+    }
+
+    /// set 设置
+    template <class T,
+        class = signed char>
+    error_t set(signed char* ptr, const std::string& name, const std::string& fast,
+        signed char default_v, const std::string& desc, bool extend = false)
+    {
+        return set_value<signed char>(ptr, name, fast, default_v, desc, extend);
+    }
+
+    /// set 设置
+    template <class T,
+        class = unsigned char>
+    error_t set(unsigned char* ptr, const std::string& name, const std::string& fast,
+        unsigned char default_v, const std::string& desc, bool extend = false)
+    {
+        return set_value<unsigned char>(ptr, name, fast, default_v, desc, extend);
+    }
+
+    /// set 设置
+    template <class T,
+        class = std::string>
+    error_t set(std::string* ptr, const std::string& name, const std::string& fast, 
+        const std::string& default_v, const std::string& desc, bool extend = false)
+    {
+        return set_value<std::string>(ptr, name, fast, default_v, desc, extend);
+    }
+
+    /// set 设置
+    template <class T,
+        class = typename std::enable_if<!std::is_pointer<T>::value
+        && !std::is_const<T>::value
+        && !std::is_reference<T>::value
+        && !std::is_same<T, double>::value
+        && !std::is_same<T, float>::value
+        && !std::is_same<T, bool>::value
+        && !std::is_same<T, std::string>::value
+        && !std::is_same<T, unsigned char>::value
+        && !std::is_same<T, char>::value
+        && !std::is_same<T, signed char>::value, T>::type>
+    error_t set(T* ptr, const std::string& name, const std::string& fast, T default_v,
+        const std::vector<T>& options, const std::string& desc, bool extend = false)
+    {
+        auto err = set_value<T>(ptr, name, fast, default_v, desc, extend);
+        if (err != ok)
+        {
+            return err;
+        }
 
         oneof_.clear();
         for (auto& item : options)
@@ -1136,6 +2247,7 @@ public:
             oss << item;
             oneof_.push_back(oss.str());
         }
+        index_oneof();
 
         return ok;
     }
@@ -1152,13 +2264,12 @@ public:
             return err;
         }
 
-        default_ = std::to_string(default_v);
-
         oneof_.clear();
         for (auto& item : options)
         {
-            oneof_.push_back(std::to_string(item));
+            oneof_.push_back(to_text(item));
         }
+        index_oneof();
 
         return ok;
     }
@@ -1175,13 +2286,12 @@ public:
             return err;
         }
 
-        default_ = std::to_string(default_v);
-
         oneof_.clear();
         for (auto& item : options)
         {
             oneof_.push_back(std::to_string(item));
         }
+        index_oneof();
 
         return ok;
     }
@@ -1198,13 +2308,12 @@ public:
             return err;
         }
 
-        default_ = std::to_string(default_v);
-
         oneof_.clear();
         for (auto& item : options)
         {
             oneof_.push_back(std::to_string(item));
         }
+        index_oneof();
 
         return ok;
     }
@@ -1221,13 +2330,12 @@ public:
             return err;
         }
 
-        default_ = default_v;
-
         oneof_.clear();
         for (auto& item : options)
         {
             oneof_.push_back(item);
         }
+        index_oneof();
 
         return ok;
     }
@@ -1237,7 +2345,7 @@ private:
     template<class T, 
         class = typename std::enable_if<std::is_same<T, flag_t>::value, T>::type>
     flag_t(T&& v)
-        : holder_(new value_holder<T>(std::forward<T>(v)))
+        : holder_(holder_ptr::make<value_holder<T>>(std::forward<T>(v)))
     {
     }
 
@@ -1246,10 +2354,60 @@ private:
         class = typename std::enable_if<std::is_same<T, flag_t>::value, T>::type>
     flag_t& operator=(T& rhs)
     {
-        holder_.reset(new value_holder<T>(std::forward<T>(rhs)));
+        holder_.emplace<value_holder<T>>(std::forward<T>(rhs));
         return *this;
     }
 
+    // to_text 默认值的字符串表示
+    template<class T>
+    static std::string to_text(const T& value)
+    {
+        std::stringstream oss;
+        oss << value;
+        return oss.str();
+    }
+
+    // to_text 列表以逗号连接
+    template<class T>
+    static std::string to_text(const std::vector<T>& value)
+    {
+        std::string ret;
+        for (size_t i = 0; i < value.size(); i++)
+        {
+            ret.append(i == 0 ? "" : ",").append(to_text(value[i]));
+        }
+        return ret;
+    }
+
+    // to_text bool
+    static std::string to_text(bool value)
+    {
+        return value ? "true" : "false";
+    }
+
+    // to_text char按字符，与convert<char>一致，'\0'为空字符串
+    static std::string to_text(char value)
+    {
+        return value == 0 ? std::string() : std::string(1, value);
+    }
+
+    // to_text signed char和unsigned char按数值
+    static std::string to_text(signed char value)
+    {
+        return std::to_string(value);
+    }
+
+    static std::string to_text(unsigned char value)
+    {
+        return std::to_string(value);
+    }
+
+    // to_text std::string
+    static std::string to_text(const std::string& value)
+    {
+        return value;
+    }
+
     error_t check_name(const std::string& name, const std::string& fast)
     {
         if (name.empty())
@@ -1264,6 +2422,10 @@ private:
         {
             return make_error("flag fast length too long, len <= 1.");
         }
+        if (!fast.empty() && static_cast<unsigned char>(fast[0]) >= short_limit)
+        {
+            return make_error("flag fast must be an ascii char.");
+        }
         return ok;
     }
 
@@ -1287,7 +2449,7 @@ private:
         desc_ = desc;
         extend_ = extend;
 
-        holder_.reset(new value_holder<T>(std::forward<T>(default_v)));
+        holder_.emplace<value_holder<T>>(std::forward<T>(default_v));
 
         return ok;
     }
@@ -1312,95 +2474,314 @@ private:
         desc_ = desc;
         extend_ = extend;
 
-        holder_.reset(new value_holder<T>(ptr, std::forward<T>(default_v)));
+        holder_.emplace<value_holder<T>>(ptr, std::forward<T>(default_v));
 
         return ok;
     }
 
     struct holder;
-    using holder_ptr = std::unique_ptr<holder>;
-
-    struct holder
-    {
-        virtual ~holder() {}
-        virtual holder_ptr clone() const = 0;
-        virtual bool parse(const std::string& text) = 0;
-        virtual const std::type_index type_index() = 0;
-    };
 
-    template<typename T>
-    struct value_holder : public holder
+    // holder_ptr 独占的值容器
+    // 能放下并且可以无异常移动的值容器直接构造在内部缓冲区，
+    // 标量、std::string和std::vector都在此列，复制flag和取值不需要堆分配；
+    // 更大的自定义类型回退到堆上。
+    class holder_ptr
     {
-        using type = T;
+    public:
+        holder_ptr()
+        {
+        }
 
-        value_holder()
+        holder_ptr(std::nullptr_t)
         {
-            memset(&value_, 0, sizeof(value_));
         }
 
-        value_holder(const value_holder& cpy)
-            : ptr_(cpy.ptr_)
-            , value_(cpy.value_)
+        holder_ptr(holder_ptr&& mv) noexcept
         {
+            take(mv);
         }
 
-        value_holder(value_holder&& cpy)
-            : ptr_(std::move(cpy.ptr_))
-            , value_(std::move(cpy.value_))
+        holder_ptr& operator=(holder_ptr&& rhs) noexcept
         {
+            if (this != &rhs)
+            {
+                reset();
+                take(rhs);
+            }
+            return *this;
         }
 
-        value_holder& operator=(const value_holder& rhs)
+        holder_ptr& operator=(std::nullptr_t) noexcept
         {
-            ptr_ = rhs.ptr_;
-            value_ = rhs.value_;
+            reset();
+            return *this;
         }
 
-        value_holder(const T& v)
-            : value_(v)
+        ~holder_ptr()
         {
+            reset();
         }
 
-        value_holder(T* ptr, const T& v)
-            : ptr_(ptr)
-            , value_(v)
+        // make 构造值容器
+        template<class H, class... Args>
+        static holder_ptr make(Args&&... args)
         {
-            if (nullptr != ptr_)
-            {
-                *ptr_ = value_;
-            }
+            holder_ptr ret;
+            ret.emplace<H>(std::forward<Args>(args)...);
+            return ret;
         }
 
-        virtual holder_ptr clone() const
+        // emplace 替换为新构造的值容器
+        template<class H, class... Args>
+        void emplace(Args&&... args)
         {
-            return holder_ptr(new value_holder(ptr_, value_));
+            reset();
+            construct<H>(inline_fit<H>(), std::forward<Args>(args)...);
         }
 
-        virtual bool parse(const std::string& text)
+        void reset() noexcept
         {
-            std::stringstream iss(text);
-            iss >> value_;
-            if (!iss)
+            if (local_)
             {
-                return false;
+                ptr_->~holder();
             }
-            if (nullptr != ptr_)
+            else
             {
-                *ptr_ = value_;
+                delete ptr_;
             }
-            return true;
+            ptr_ = nullptr;
+            local_ = false;
         }
 
-        virtual const std::type_index type_index()
+        holder* get() const
         {
-            return std::move(std::type_index(typeid(value_)));
+            return ptr_;
         }
 
-        T* ptr_{ nullptr };
-        T value_{ 0 }; // note: 一些类型在特殊的编译器版本上会有性能问题，应该避免大内存和复杂类型做为flag。
-    };
+        holder* operator->() const
+        {
+            return ptr_;
+        }
 
-    holder_ptr clone() const
+        holder& operator*() const
+        {
+            return *ptr_;
+        }
+
+        explicit operator bool() const
+        {
+            return nullptr != ptr_;
+        }
+
+        bool operator==(const holder_ptr& rhs) const
+        {
+            return ptr_ == rhs.ptr_;
+        }
+
+        bool operator!=(const holder_ptr& rhs) const
+        {
+            return ptr_ != rhs.ptr_;
+        }
+
+        // local 是否存放在内部缓冲区
+        bool local() const
+        {
+            return local_;
+        }
+
+    private:
+        using buffer_t = std::aligned_storage<sizeof(void*) * 6>::type;
+
+        // inline_fit 值容器能否存放在内部缓冲区
+        template<class H>
+        struct inline_fit : std::integral_constant<bool,
+            sizeof(H) <= sizeof(buffer_t)
+            && alignof(buffer_t) % alignof(H) == 0
+            && std::is_nothrow_move_constructible<H>::value>
+        {
+        };
+
+        template<class H, class... Args>
+        void construct(std::true_type, Args&&... args)
+        {
+            ptr_ = new (&buf_) H(std::forward<Args>(args)...);
+            local_ = true;
+        }
+
+        template<class H, class... Args>
+        void construct(std::false_type, Args&&... args)
+        {
+            ptr_ = new H(std::forward<Args>(args)...);
+        }
+
+        void take(holder_ptr& mv) noexcept
+        {
+            if (mv.local_)
+            {
+                ptr_ = mv.ptr_->move_to(&buf_);
+                local_ = true;
+                mv.reset();
+            }
+            else
+            {
+                ptr_ = mv.ptr_;
+                mv.ptr_ = nullptr;
+            }
+        }
+
+        holder* ptr_{ nullptr };
+        bool local_{ false };
+        buffer_t buf_;
+    };
+
+    struct holder
+    {
+        virtual ~holder() {}
+        virtual holder_ptr clone() const = 0;
+
+        // move_to 移动到另一个holder_ptr的内部缓冲区
+        virtual holder* move_to(void* buf) noexcept = 0;
+
+        virtual bool parse(const view_t& text) = 0;
+        virtual const std::type_index type_index() = 0;
+
+        // value 只复制值，不关联绑定的变量
+        virtual holder_ptr value() const = 0;
+
+        // assign 从同类型的容器复制值，同时写入绑定的变量
+        virtual void assign(const holder& rhs) = 0;
+
+        // append 重复的标记，列表追加，其他类型覆盖
+        virtual bool append(const view_t& text) = 0;
+
+        // list 是否为列表
+        virtual bool list() const = 0;
+
+        // bound 是否绑定了变量
+        virtual bool bound() const = 0;
+
+        // text 值的字符串表示
+        virtual std::string text() const = 0;
+    };
+
+    template<typename T>
+    struct value_holder : public holder
+    {
+        using type = T;
+
+        value_holder()
+        {
+            memset(&value_, 0, sizeof(value_));
+        }
+
+        value_holder(const value_holder& cpy)
+            : ptr_(cpy.ptr_)
+            , value_(cpy.value_)
+        {
+        }
+
+        value_holder(value_holder&& cpy) noexcept(std::is_nothrow_move_constructible<T>::value)
+            : ptr_(std::move(cpy.ptr_))
+            , value_(std::move(cpy.value_))
+        {
+        }
+
+        value_holder& operator=(const value_holder& rhs)
+        {
+            ptr_ = rhs.ptr_;
+            value_ = rhs.value_;
+        }
+
+        value_holder(const T& v)
+            : value_(v)
+        {
+        }
+
+        value_holder(T* ptr, const T& v)
+            : ptr_(ptr)
+            , value_(v)
+        {
+            if (nullptr != ptr_)
+            {
+                *ptr_ = value_;
+            }
+        }
+
+        virtual holder_ptr clone() const
+        {
+            return holder_ptr::make<value_holder>(ptr_, value_);
+        }
+
+        virtual holder* move_to(void* buf) noexcept
+        {
+            return new (buf) value_holder(std::move(*this));
+        }
+
+        virtual bool parse(const view_t& text)
+        {
+            if (!convert<T>::parse(text, value_))
+            {
+                return false;
+            }
+            if (nullptr != ptr_)
+            {
+                *ptr_ = value_;
+            }
+            return true;
+        }
+
+        virtual const std::type_index type_index()
+        {
+            return std::move(std::type_index(typeid(value_)));
+        }
+
+        virtual holder_ptr value() const
+        {
+            return holder_ptr::make<value_holder>(value_);
+        }
+
+        virtual void assign(const holder& rhs)
+        {
+            value_ = static_cast<const value_holder&>(rhs).value_;
+            if (nullptr != ptr_)
+            {
+                *ptr_ = value_;
+            }
+        }
+
+        virtual bool append(const view_t& text)
+        {
+            if (!convert_repeat<T>::append(text, value_))
+            {
+                return false;
+            }
+            if (nullptr != ptr_)
+            {
+                *ptr_ = value_;
+            }
+            return true;
+        }
+
+        virtual bool list() const
+        {
+            return convert_repeat<T>::list;
+        }
+
+        virtual bool bound() const
+        {
+            return nullptr != ptr_;
+        }
+
+        virtual std::string text() const
+        {
+            return to_text(value_);
+        }
+
+        T* ptr_{ nullptr };
+        T value_{ 0 }; // note: 一些类型在特殊的编译器版本上会有性能问题，应该避免大内存和复杂类型做为flag。
+    };
+
+    holder_ptr clone() const
     {
         if (holder_)
         {
@@ -1409,15 +2790,139 @@ private:
         return nullptr;
     }
 
+    // parse_value 校验并解析到指定的值容器，不修改flag本身
+    // @param repeat bool 重复的标记，列表追加到已有的值
+    error_t parse_value(holder_ptr& value, const view_t& text, bool repeat = false) const
+    {
+        if (!bool(holder_))
+        {
+            return make_error("flag is null", stack_);
+        }
+        uint32_t ord = invalid_id;
+        if (oneof_.size() != 0)
+        {
+            ord = find_oneof(text);
+            if (ord == invalid_id)
+            {
+                return make_error("not one of flag options.", stack_);
+            }
+        }
+        if (!bool(value))
+        {
+            value = holder_->clone();
+        }
+        if (ord != invalid_id && ord < oneof_values_.size() && bool(oneof_values_[ord]))
+        {
+            value->assign(*oneof_values_[ord]); // 可选项已经转换过，不再解析
+            return ok;
+        }
+        if (!(repeat ? value->append(text) : value->parse(text)))
+        {
+            return make_error(std::string("parse failed. type must be ") + holder_->type_index().name(), stack_);
+        }
+        return ok;
+    }
+
+    // index_oneof 编译可选项的哈希索引，同时把每个可选项转换为类型化的值
+    // 开放寻址，槽位数是2的幂且不少于可选项数量的2倍，槽位保存序号+1
+    void index_oneof()
+    {
+        oneof_slots_.clear();
+        oneof_values_.clear();
+        if (oneof_.empty() || !bool(holder_))
+        {
+            return;
+        }
+        size_t size = 2;
+        while (size < oneof_.size() * 2)
+        {
+            size <<= 1;
+        }
+        oneof_slots_.assign(size, 0);
+        oneof_values_.resize(oneof_.size());
+        for (uint32_t i = 0; i < oneof_.size(); i++)
+        {
+            auto& text = oneof_[i];
+            size_t slot = hash(text) & (size - 1);
+            while (oneof_slots_[slot] != 0 && oneof_[oneof_slots_[slot] - 1] != text)
+            {
+                slot = (slot + 1) & (size - 1);
+            }
+            if (oneof_slots_[slot] != 0)
+            {
+                continue; // 重复的可选项，保留第一个
+            }
+            oneof_slots_[slot] = i + 1;
+            auto value = holder_->value();
+            if (value->parse(text))
+            {
+                oneof_values_[i] = std::move(value);
+            }
+        }
+    }
+
+    // find_oneof 查找可选项的序号，不存在时为invalid_id
+    uint32_t find_oneof(const view_t& text) const
+    {
+        if (oneof_slots_.empty() || oneof_values_.size() != oneof_.size())
+        {
+            // 通过oneof()修改后还没有重新编译索引
+            for (uint32_t i = 0; i < oneof_.size(); i++)
+            {
+                if (text == oneof_[i])
+                {
+                    return i;
+                }
+            }
+            return invalid_id;
+        }
+        size_t mask = oneof_slots_.size() - 1;
+        for (size_t slot = hash(text) & mask; oneof_slots_[slot] != 0; slot = (slot + 1) & mask)
+        {
+            auto i = oneof_slots_[slot] - 1;
+            if (text == oneof_[i])
+            {
+                return i;
+            }
+        }
+        return invalid_id;
+    }
+
+    // hash FNV-1a
+    static uint32_t hash(const view_t& text)
+    {
+        uint32_t h = 2166136261u;
+        for (size_t i = 0; i < text.size(); i++)
+        {
+            h = (h ^ static_cast<unsigned char>(text[i])) * 16777619u;
+        }
+        return h;
+    }
+
+    // invalid_tag 未加入过命令表
+    static const uint64_t invalid_tag = ~uint64_t(0);
+
+    // get 当前值，不做类型检查
+    // 只供类型已在编译期确定的调用方使用
+    template<class T>
+    const T& get() const;
+
+    friend class context_t;
+    friend class table_t;
+    friend class parse_result_t;
+    friend class app_t;
+    template<class T> friend class schema_t;
+    template<class T> friend class flag_ref;
+
     // 数据
     holder_ptr      holder_;
 
+    // tag_ 最近一次加入的命令表序号(高32位)和表内ID(低32位)，命令表按它快速定位局部ID
+    std::atomic<uint64_t> tag_{ invalid_tag };
+
     // extend_ 是否可继承
     bool extend_{ false };
 
-    // exist_ 是否存在
-    bool exist_{ false };
-
     // required_ 是否必须
     // todo: no implements
     bool required_{ false };
@@ -1434,664 +2939,867 @@ private:
     // stack_ 堆栈
     std::string stack_;
 
-    // default_ 默认值对应的字符串表示
-    std::string default_;
-
-    // text_ 输入的字符串
-    std::string text_;
 
     // oneof 可选项，枚举值
     std::vector<std::string> oneof_;
+
+    // oneof_slots_ 可选项的哈希索引，oneof_values_ 可选项转换后的值
+    std::vector<uint32_t> oneof_slots_;
+    std::vector<holder_ptr> oneof_values_;
 };
 
 // ----------------------------------------------------------------------------
-// cmd_t
+// context_t
 
-// cmd_t 命令
-class cmd_t
+// context_t 解析上下文
+// 每次exec都会创建独立的解析上下文，解析过程中的状态和flag的值都只保存在上下文中，
+// 命令树在初始化完成后只读，所以同一棵命令树可以在多个线程中同时解析和执行。
+class context_t
 {
 public:
-    cmd_t()
+    context_t()
     {
     }
 
-    ~cmd_t()
+    context_t(const context_t& cpy) = delete;
+    context_t& operator=(const context_t& rhs) = delete;
+
+    // current 当前线程正在执行的解析上下文，不在命令执行期间时为nullptr
+    static context_t* current()
     {
+        return tls();
     }
 
-    explicit cmd_t(const std::string& name)
-        : name_(name)
+    // name 应用名称
+    const std::string& name() const
     {
+        return *name_;
     }
 
-    cmd_t(const cmd_t& cpy)
-        : name_(cpy.name_)
-        , brief_(cpy.brief_)
-        , desc_(cpy.desc_)
-        , example_(cpy.example_)
-        , stack_(cpy.stack_)
-        , subs_(cpy.subs_)
-        , flags_(cpy.flags_)
-        , on_func_(cpy.on_func_)
-        , parent_ptr_(cpy.parent_ptr_)
+    // desc 应用描述
+    const std::string& desc() const
     {
+        return *desc_;
     }
 
-    cmd_t(cmd_t&& mv) noexcept
-        : name_(std::move(mv.name_))
-        , brief_(std::move(mv.brief_))
-        , desc_(std::move(mv.desc_))
-        , example_(std::move(mv.example_))
-        , stack_(std::move(mv.stack_))
-        , subs_(std::move(mv.subs_))
-        , flags_(std::move(mv.flags_))
-        , on_func_(std::move(mv.on_func_))
-        , parent_ptr_(std::move(mv.parent_ptr_))
+    // argv 原始参数列表
+    // 解析时只保存视图，第一次访问时才复制
+    const argv_t& argv() const
     {
+        if (!argv_ready_)
+        {
+            argv_.clear();
+            argv_.reserve(tokens_.size());
+            for (auto& item : tokens_)
+            {
+                argv_.push_back(item.str());
+            }
+            argv_ready_ = true;
+        }
+        return argv_;
     }
 
-    cmd_t& operator=(const cmd_t& rhs)
+    // tokens 原始参数视图
+    const views_t& tokens() const
     {
-        name_ = rhs.name_;
-        brief_ = rhs.brief_;
-        desc_ = rhs.desc_;
-        example_ = rhs.example_;
-        stack_ = rhs.stack_;
-        subs_ = rhs.subs_;
-        flags_ = rhs.flags_;
-        on_func_ = rhs.on_func_;
-        parent_ptr_ = rhs.parent_ptr_;
-        return *this;
+        return tokens_;
     }
 
-    cmd_t& operator=(cmd_t&& mv) noexcept
+    // args 命令参数列表
+    // 解析时只保存视图，第一次访问时才复制并去除引号
+    const args_t& args() const
     {
-        name_ = std::move(mv.name_);
-        brief_ = std::move(mv.brief_);
-        desc_ = std::move(mv.desc_);
-        example_ = std::move(mv.example_);
-        stack_ = std::move(mv.stack_);
-        subs_ = std::move(mv.subs_);
-        flags_ = std::move(mv.flags_);
-        on_func_ = std::move(mv.on_func_);
-        parent_ptr_ = mv.parent_ptr_;
-        return *this;
+        if (!args_ready_)
+        {
+            args_ = args_view().to_args();
+            args_ready_ = true;
+        }
+        return args_;
     }
 
-    // name 命令名称
-    void name(const std::string& name)
+    // args_view 命令参数视图，不复制
+    args_view_t args_view() const
     {
-        name_ = name;
+        return args_view_t(positionals_);
     }
 
-    // name 命令名称
-    const std::string& name() const
+    // cmd 解析到的命令
+    const pcmd_t& cmd() const
     {
-        return name_;
+        return chain_.back();
     }
 
-    // brief 简短描述
-    void brief(const std::string& brief)
+    // chain 命令分支，从根命令到解析到的命令
+    const std::vector<pcmd_t>& chain() const
     {
-        brief_ = brief;
+        return chain_;
     }
 
-    // brief 简短描述
-    const std::string& brief() const
+    // node 解析到的命令在命令表中的节点ID
+    uint32_t node() const
     {
-        return brief_;
+        return nodes_.back();
     }
 
-    // desc 命令描述
-    void desc(const std::string& desc)
+    // table 解析使用的命令表
+    const table_t& table() const
     {
-        desc_ = desc;
+        return *table_;
     }
 
-    // desc 命令描述
-    const std::string& desc() const
+    // out 输出流，并行批处理时为本行独立的缓冲区，否则为std::cout
+    std::ostream& out() const
     {
-        return desc_;
+        return *out_;
     }
 
-    // example 示例
-    void example(const std::string& example)
-    {
-        example_ = example;
-    }
+    // stack 堆栈，可确定解析到的命令在分支中的位置
+    // 解析时只记录节点，第一次访问时才生成
+    const std::string& stack() const;
 
-    // example 示例
-    const std::string& example() const
+    // breadcrumb 错误位置，由应用名称和前end个原始参数组成
+    // 只在出错时生成
+    std::string breadcrumb(size_t end) const
     {
-        return example_;
+        if (end > tokens_.size())
+        {
+            end = tokens_.size();
+        }
+        size_t len = name_->size();
+        for (size_t i = 0; i < end; i++)
+        {
+            len += 1 + tokens_[i].size();
+        }
+        std::string ret;
+        ret.reserve(len);
+        ret.append(*name_);
+        for (size_t i = 0; i < end; i++)
+        {
+            ret.append(" ").append(tokens_[i].data(), tokens_[i].size());
+        }
+        return ret;
     }
 
-    // stack 堆栈，可确定当前命令在分支中的位置
-    // 堆栈并不是在绑定命令时确定的，而是在解析时确定的。
-    // 因为pcmd_t可以复用，存在于多条命令分支中。
-    void stack(const std::string& stack)
+    // parent 上级命令，cmd不在命令分支中或者没有上级命令时为nullptr
+    const pcmd_t& parent(const cmd_t* cmd) const
     {
-        stack_ = stack;
+        static const pcmd_t null_cmd{ nullptr };
+        for (size_t i = chain_.size(); i > 1; i--)
+        {
+            if (chain_[i - 1].get() == cmd)
+            {
+                return chain_[i - 2];
+            }
+        }
+        return null_cmd;
     }
 
-    // stack 堆栈，可确定当前命令在分支中的位置
-    // 堆栈并不是在绑定命令时确定的，而是在解析时确定的。
-    // 因为pcmd_t可以复用，存在于多条命令分支中。
-    const std::string& stack() const
-    {
-        return stack_;
-    }
+    // find 查找flag，包括从上级命令继承的flag
+    // @param key std::string "--name" 或 "-f"
+    // @param from cmd_t* 查找的起始命令
+    pflag_t find(const std::string& key, const cmd_t* from) const;
 
-    // subs 子命令列表
-    cmds_t& subs()
-    {
-        return subs_;
-    }
+    // collect 收集命令可见的flag，包括从上级命令继承的flag
+    void collect(flags_t& dst, const cmd_t* from) const;
 
-    /// flags 标记列表
-    flags_t& flags()
-    {
-        return flags_;
-    }
+private:
+    friend class flag_t;
+    friend class app_t;
+    template<class F> friend class context_bound_t;
 
-    // bind 绑定函数
-    error_t bind(func_t func)
+    // slot_t 单个flag在本次解析中的状态
+    struct slot_t
     {
-        on_func_ = func;
-        return ok;
-    }
+        uint32_t id{ invalid_id };
+        flag_t::holder_ptr value;
+        view_t text;
+        bool exist{ false };
 
-    // bind 绑定子命令
-    // todo: 标准的命令名称的检查
-    error_t bind(cmd_t* cmd_ptr)
+        // pending 惰性模式下text还没有转换
+        bool pending{ false };
+    };
+
+    // scope_t 在作用域内设置当前线程的解析上下文
+    class scope_t
     {
-        if (nullptr == cmd_ptr)
-        {
-            return make_error("error: cmd_t ptr is null");
-        }
-        if (cmd_ptr->name().empty())
+    public:
+        explicit scope_t(context_t& ctx)
+            : prev_(tls())
         {
-            return make_error("error: cmd_t name is null");
+            tls() = &ctx;
         }
-        auto it = subs_.find(cmd_ptr->name());
-        if (it != subs_.end())
+
+        ~scope_t()
         {
-            return make_error("error: double defined.");
+            tls() = prev_;
         }
-        subs_[cmd_ptr->name()].reset(cmd_ptr);
-        return ok;
+
+    private:
+        scope_t(const scope_t& cpy) = delete;
+        scope_t& operator=(const scope_t& rhs) = delete;
+
+        context_t* prev_{ nullptr };
+    };
+
+    static context_t*& tls()
+    {
+        static thread_local context_t* ctx{ nullptr };
+        return ctx;
     }
 
-    // bind 绑定子命令
-    // todo: 标准的命令名称的检查
-    error_t bind(pcmd_t& cmd_ptr)
+    // slot 查找flag的状态，未设置过时返回nullptr
+    // 通过命令表把标记解析成表内ID后直接索引
+    slot_t* slot(const flag_t* flag);
+
+    // slot 按标记ID查找flag的状态
+    slot_t* slot(uint32_t id)
     {
-        if (nullptr == cmd_ptr)
-        {
-            return make_error("error: cmd_t ptr is null");
-        }
-        if (cmd_ptr->name().empty())
-        {
-            return make_error("error: cmd_t name is null");
-        }
-        auto it = subs_.find(cmd_ptr->name());
-        if (it != subs_.end())
+        if (id >= index_.size() || index_[id] == 0)
         {
-            return make_error("error: double defined.");
+            return nullptr;
         }
-        subs_[cmd_ptr->name()] = cmd_ptr;
-        return ok;
+        return &slots_[index_[id] - 1];
     }
 
-    // flag 标记
-    template <class T,
-        class = typename std::enable_if<!std::is_pointer<T>::value
-        && !std::is_const<T>::value
-        && !std::is_reference<T>::value, T>::type>
-        error_t flag(const std::string& name, const std::string& fast, T default_value,
-            const std::string& desc, bool extend = false)
+    // slot_of 获取flag的状态，不存在时创建
+    slot_t* slot_of(const flag_t* flag);
+
+    // hold 复制并持有字符串，返回的视图在上下文的生命周期内有效
+    view_t hold(const std::string& text)
     {
-        auto it = flags_.find("--" + name);
-        if (it != flags_.end())
+        held_.push_back(text);
+        return view_t(held_.back());
+    }
+
+    // parse 解析flag的值到上下文中
+    // text 必须在上下文的生命周期内有效
+    error_t parse(const flag_t* flag, const view_t& text)
+    {
+        auto ptr = slot_of(flag);
+        if (nullptr == ptr)
         {
-            return make_error("error: double defined flag. name=" + name);
+            return make_error("flag is not frozen.");
         }
-        auto flag_ptr = std::make_shared<flag_t>();
-        auto ret = flag_ptr->set<T>(name, fast, default_value, desc, extend);
-        if (ok != ret)
+        auto& item = *ptr;
+        if (lazy_ && !flag->holder_->bound())
         {
-            return ret;
+            // 惰性模式只记录文本，第一次读取时再转换和校验；绑定了变量的标记仍然立即转换
+            auto repeat = item.exist;
+            item.exist = true;
+            item.pending = true;
+            item.value.reset();
+            if (repeat && flag->holder_->list() && !item.text.empty())
+            {
+                item.text = hold(item.text.str() + "," + text.str());
+            }
+            else
+            {
+                item.text = text;
+            }
+            return ok;
         }
-        flags_["--" + name] = flag_ptr;
-        if (fast == "")
+        auto repeat = item.exist && bool(item.value);
+        item.exist = true;
+        auto err = flag->parse_value(item.value, text, repeat);
+        if (err != ok)
         {
-            return ok;
+            return err;
         }
-        auto fast_it = flags_.find("-" + fast);
-        if (fast_it != flags_.end())
+        if (repeat && item.value->list() && !item.text.empty())
         {
-            return make_error("error: double defined flag. fast=" + fast + " name=" + name);
+            item.text = hold(item.text.str() + "," + text.str()); // 保持文本与值一致，只在重复时复制
+        }
+        else
+        {
+            item.text = text;
         }
-        flags_["-" + fast] = flag_ptr;
         return ok;
     }
 
-    // flag
-    template <class T,
-        class = typename std::enable_if<!std::is_pointer<T>::value
-        && !std::is_const<T>::value
-        && !std::is_reference<T>::value
-        && !std::is_same<T, double>::value
-        && !std::is_same<T, float>::value
-        && !std::is_same<T, bool>::value, T>::type>
-        error_t flag(const std::string& name, const std::string& fast, T default_value,
-            const std::vector<T>& options, const std::string& desc, bool extend = false)
+    // settle 转换惰性模式下还没有转换的值
+    error_t settle(const flag_t* flag, slot_t& item)
     {
-        auto it = flags_.find("--" + name);
-        if (it != flags_.end())
-        {
-            return make_error("error: double defined flag. name=" + name);
-        }
-        auto flag_ptr = std::make_shared<flag_t>();
-        auto ret = flag_ptr->set<T>(name, fast, default_value, options, desc, extend);
-        if (ok != ret)
-        {
-            return ret;
-        }
-        flags_["--" + name] = flag_ptr;
-        if (fast == "")
+        if (!item.pending)
         {
             return ok;
         }
-        auto fast_it = flags_.find("-" + fast);
-        if (fast_it != flags_.end())
+        auto err = flag->parse_value(item.value, item.text);
+        if (err != ok)
         {
-            return make_error("error: double defined flag. fast=" + fast + " name=" + name);
+            item.value.reset(); // 保持未转换，之后的每次读取都报告错误
+            return err;
         }
-        flags_["-" + fast] = flag_ptr;
+        item.pending = false;
         return ok;
     }
 
-    // pflag 标记
-    template <class T,
-        class = typename std::enable_if<!std::is_pointer<T>::value
-        && !std::is_const<T>::value
-        && !std::is_reference<T>::value, T>::type>
-        error_t pflag(T* ptr, const std::string& name, const std::string& fast, T default_value,
-            const std::string& desc, bool extend = false)
+    // settle 转换所有还没有转换的值，用于需要在命令函数之前报告错误的命令
+    error_t settle();
+
+    // name_ 应用名称
+    const std::string* name_{ nullptr };
+
+    // desc_ 应用描述
+    const std::string* desc_{ nullptr };
+
+    // lazy_ 惰性转换
+    bool lazy_{ false };
+
+    // out_ 输出流
+    std::ostream* out_{ &std::cout };
+
+    // line_ exec(const std::string&)时复制的命令行，tokens_引用其内存
+    std::string line_;
+
+    // tokens_ 原始参数视图，引用line_或外部的argv
+    views_t tokens_;
+
+    // positionals_ 命令参数视图
+    views_t positionals_;
+
+    // held_ 上下文持有的字符串
+    std::list<std::string> held_;
+
+    // files_ 展开的响应文件，tokens_可能引用其映射的内存
+    std::list<mapped_file_t> files_;
+
+    // sources_ 标记的来源，slots_中的文本可能引用其内存
+    std::shared_ptr<const void> sources_;
+
+    // argv_ 原始参数列表，第一次访问时生成
+    mutable argv_t argv_;
+    mutable bool argv_ready_{ false };
+
+    // args_ 命令参数列表，第一次访问时生成
+    mutable args_t args_;
+    mutable bool args_ready_{ false };
+
+    // table_ 命令表
+    std::shared_ptr<const table_t> table_;
+
+    // chain_ 命令分支
+    std::vector<pcmd_t> chain_;
+
+    // nodes_ 命令分支对应的节点ID
+    std::vector<uint32_t> nodes_;
+
+    // stack_ 堆栈，第一次访问时生成
+    mutable std::string stack_;
+    mutable bool stack_ready_{ false };
+
+    // index_ 标记ID到slots_位置的索引，从1开始，0表示未设置
+    std::vector<uint32_t> index_;
+
+    // slots_ flag的值
+    std::vector<slot_t> slots_;
+
+    // result_ 命中缓存时引用的解析结果，标记的输入字符串和命令参数引用其内存
+    std::shared_ptr<const parse_result_t> result_;
+};
+
+// ----------------------------------------------------------------------------
+// flag_t
+
+template<class T>
+inline T& flag_t::cast()
+{
+    if (!castable<T>())
     {
-        auto it = flags_.find("--" + name);
-        if (it != flags_.end())
+        if (!bool(holder_))
         {
-            return make_error("error: double defined flag. name=" + name);
+            throw flag_cast_exception(
+                std::string("can not cast null")
+                + " to " + typeid(T).name()
+            );
         }
-        auto flag_ptr = std::make_shared<flag_t>();
-        auto ret = flag_ptr->set<T>(ptr, name, fast, default_value, desc, extend);
-        if (ok != ret)
+        else
         {
-            return ret;
+            throw flag_cast_exception(
+                std::string("can not cast ") + holder_->type_index().name()
+                + " to " + typeid(T).name()
+            );
         }
-        flags_["--" + name] = flag_ptr;
-        if (fast == "")
+    }
+    holder* value = holder_.get();
+    auto ctx = context_t::current();
+    if (nullptr != ctx)
+    {
+        auto item = ctx->slot(this);
+        if (nullptr != item && item->pending)
         {
-            return ok;
+            auto err = ctx->settle(this, *item);
+            if (err != ok)
+            {
+                throw flag_cast_exception(err.msg());
+            }
         }
-        auto fast_it = flags_.find("-" + fast);
-        if (fast_it != flags_.end())
+        if (nullptr != item && bool(item->value))
         {
-            return make_error("error: double defined flag. fast=" + fast + " name=" + name);
+            value = item->value.get();
         }
-        flags_["-" + fast] = flag_ptr;
-        return ok;
     }
+    auto ptr = dynamic_cast<value_holder<T>*>(value);
+    return ptr->value_;
+}
 
-    // pflag
-    template <class T,
-        class = typename std::enable_if<!std::is_pointer<T>::value
-        && !std::is_const<T>::value
-        && !std::is_reference<T>::value
-        && !std::is_same<T, double>::value
-        && !std::is_same<T, float>::value
-        && !std::is_same<T, bool>::value, T>::type>
-        error_t pflag(T* ptr, const std::string& name, const std::string& fast, T default_value,
-            const std::vector<T>& options, const std::string& desc, bool extend = false)
+template<class T>
+inline const T& flag_t::get() const
+{
+    const holder* value = holder_.get();
+    auto ctx = context_t::current();
+    if (nullptr != ctx)
     {
-        auto it = flags_.find("--" + name);
-        if (it != flags_.end())
-        {
-            return make_error("error: double defined flag. name=" + name);
-        }
-        auto flag_ptr = std::make_shared<flag_t>();
-        auto ret = flag_ptr->set<T>(ptr, name, fast, default_value, options, desc, extend);
-        if (ok != ret)
+        auto item = ctx->slot(this);
+        if (nullptr != item && item->pending)
         {
-            return ret;
-        }
-        flags_["--" + name] = flag_ptr;
-        if (fast == "")
-        {
-            return ok;
+            auto err = ctx->settle(this, *item);
+            if (err != ok)
+            {
+                throw flag_cast_exception(err.msg());
+            }
         }
-        auto fast_it = flags_.find("-" + fast);
-        if (fast_it != flags_.end())
+        if (nullptr != item && bool(item->value))
         {
-            return make_error("error: double defined flag. fast=" + fast + " name=" + name);
+            value = item->value.get();
         }
-        flags_["-" + fast] = flag_ptr;
-        return ok;
     }
+    return static_cast<const value_holder<T>*>(value)->value_;
+}
 
-    // cast 转换，不存在或类型不一致时会抛出异常
-    template<class T>
-    bool castable(const std::string& name)
+inline error_t flag_t::parse(const std::string& text)
+{
+    auto ctx = context_t::current();
+    if (nullptr != ctx)
     {
-        auto it = flags_.find(name);
-        if (it == flags_.end())
-        {
-            throw flag_cast_exception("not found.");
-        }
-        return flags_[name]->castable<T>();
+        return ctx->parse(this, ctx->hold(text));
     }
+    return parse_value(holder_, text);
+}
 
-    // cast 转换，不存在或类型不一致时会抛出异常
-    template<class T>
-    T& cast(const std::string& name)
+inline void flag_t::exist(bool exist)
+{
+    auto ctx = context_t::current();
+    if (nullptr != ctx)
     {
-        auto it = flags_.find(name);
-        if (it == flags_.end())
+        auto item = ctx->slot_of(this);
+        if (nullptr != item)
         {
-            throw flag_cast_exception("not found.");
+            item->exist = exist;
         }
-        return flags_[name]->cast<T>();
     }
+}
 
-    // parent 上级命令
-    // 上级命令并不是在绑定命令时确定的，而是在解析时确定的。
-    // 因为pcmd_t可以复用，存在于多条命令分支中。
-    void parent(pcmd_t& cmd_ptr)
+inline bool flag_t::exist()
+{
+    auto ctx = context_t::current();
+    if (nullptr == ctx)
     {
-        parent_ptr_ = cmd_ptr;
+        return false;
     }
+    auto item = ctx->slot(this);
+    return (nullptr != item && item->exist);
+}
 
-    // parent 上级命令
-    // 上级命令并不是在绑定命令时确定的，而是在解析时确定的。
-    // 因为pcmd_t可以复用，存在于多条命令分支中。
-    pcmd_t& parent()
+inline std::string flag_t::text()
+{
+    auto ctx = context_t::current();
+    if (nullptr == ctx)
     {
-        return parent_ptr_;
+        return "";
     }
+    auto item = ctx->slot(this);
+    return (nullptr != item) ? item->text.str() : "";
+}
 
-    // on_exec 执行命令
-    error_t on_exec(const pcmd_t& pcmd, const args_t& args)
+// ----------------------------------------------------------------------------
+// flag_ref
+
+/// flag_ref 注册标记时返回的类型化句柄
+/// 读取时由当前线程解析上下文的命令表把标记解析成表内ID，再直接索引值，
+/// 不做名字查找和类型比较。不在命令执行期间读取到的是默认值。
+/// 注册失败时句柄为空，error()返回失败原因，可以直接和clips::ok比较。
+template<class T>
+class flag_ref
+{
+public:
+    flag_ref()
+        : err_(make_error("error: null flag."))
     {
-        auto fit = flags_.find("--help");
-        if (fit != flags_.end() && fit->second->cast<bool>())
-        {
-            return on_help();
-        }
-        if (nullptr == on_func_)
-        {
-            return make_error(" warn: nothing to do");
-        }
-        return on_func_(pcmd, args);
     }
 
-private:
-
-    // on_help 输出帮助信息
-    error_t on_help()
+    flag_ref(const error_t& err)
+        : err_(err)
     {
-        if (!name_.empty())
-        {
-            std::cout << std::endl << desc_ << std::endl << std::endl;
-        }
-        else
-        {
-            std::cout << std::endl << clips::desc() << std::endl << std::endl;
-        }
-
-        std::cout << "usage:" << std::endl
-            << "  " << stack_;
-        if (subs_.size() != 0)
-        {
-            std::cout << " [cmds...]";
-        }
-        std::cout << " [args...] [--flags...] " << std::endl << std::endl;
-
-        if (subs_.size() != 0)
-        {
-            std::cout << "cmds:" << std::endl;
-            size_t cmd_max_len = 0;
-            for (auto& item : subs_)
-            {
-                if (cmd_max_len < item.second->name().length())
-                {
-                    cmd_max_len = item.second->name().length();
-                }
-            }
-            for (auto& item : subs_)
-            {
-                std::cout << "  " << utils::pading_right(item.second->name(), cmd_max_len, " ") 
-                    << "  " << item.second->brief() << std::endl;
-            }
-            std::cout << std::endl;
-        }
-
-        flags_t flags_tmp;
-        for (auto& item : flags_)
-        {
-            flags_tmp["--" + item.second->name()] = item.second;
-        }
-        std::cout << "flags:" << std::endl;
-        size_t fast_max_len = 0;
-        size_t name_max_len = 0;
-        size_t type_max_len = 0;
-        size_t default_max_len = 0;
-        for (auto& item : flags_tmp)
-        {
-            if (fast_max_len < item.second->fast().length())
-            {
-                fast_max_len = item.second->fast().length();
-            }
-            if (name_max_len < item.second->name().length())
-            {
-                name_max_len = item.second->name().length();
-            }
-            if (type_max_len < item.second->type_name().length())
-            {
-                type_max_len = item.second->type_name().length();
-            }
-            if (default_max_len < item.second->default_value().length())
-            {
-                default_max_len = item.second->default_value().length();
-            }
-        }
-        for (auto& item : flags_tmp)
-        {
-            std::cout << "  "
-                << utils::pading_right(
-                (item.second->fast() == "" ? "" : "-" + item.second->fast() + ","),
-                    fast_max_len + 2, " ")
-                << " "
-                << utils::pading_right("--" + item.second->name(), name_max_len + 2, " ")
-                << "  "
-                << utils::pading_right("<" + item.second->type_name() + ">", type_max_len + 2, " ")
-                << "  ";
-
-            if (item.second->extend())
-            {
-                std::cout << ":";
-            }
-            else
-            {
-                std::cout << " ";
-            }
-            std::cout << utils::pading_right("(" + item.second->default_value() + ")", default_max_len + 2, " ")
-                << "  "
-                << item.second->desc();
-
-            auto& oneof = item.second->oneof();
-            if (oneof.size() != 0)
-            {
-                std::cout << "  {";
-                for (auto eit = oneof.begin(); eit != oneof.end(); ++eit)
-                {
-                    if (eit != oneof.begin())
-                    {
-                        std::cout << ",";
-                    }
-                    std::cout << *eit;
-                }
-                std::cout << "}";
-            }
+    }
 
-            std::cout << std::endl;
-        }
-        std::cout << std::endl;
+    explicit flag_ref(const pflag_t& flag)
+        : flag_(flag)
+    {
+    }
 
-        if (!example_.empty())
+    /// get 当前值，空句柄或转换失败时抛出flag_cast_exception
+    const T& get() const
+    {
+        if (!bool(flag_))
         {
-            std::cout << "example:" << std::endl
-                << "  " << example_ << std::endl << std::endl;
+            throw flag_cast_exception(err_.msg());
         }
-
-        std::cout << "for more information about a command:" << std::endl
-            << "  " << clips::name() << " [cmds...] -h" << std::endl
-            << "  " << clips::name() << " [cmds...] --help" << std::endl;
-
-        return ok;
+        return flag_->template get<T>();
     }
 
-    // name_ 命令名称，单行，合法的命令行标识符号
-    std::string name_;
+    const T& operator*() const
+    {
+        return get();
+    }
 
-    // brief_ 简短描述
-    std::string brief_;
+    const T* operator->() const
+    {
+        return &get();
+    }
 
-    // desc_ 完整描述
-    std::string desc_;
+    /// exist 本次解析中是否设置了标记
+    bool exist() const
+    {
+        return bool(flag_) && flag_->exist();
+    }
 
-    // example 示例
-    std::string example_;
+    /// flag 标记
+    const pflag_t& flag() const
+    {
+        return flag_;
+    }
 
-    // stack_ 堆栈
-    std::string stack_;
+    /// error 注册结果
+    const error_t& error() const
+    {
+        return err_;
+    }
 
-    // subs_ 子命令
-    cmds_t subs_;
+    operator const error_t&() const
+    {
+        return err_;
+    }
 
-    // flags_ 局部标记列表, 会被子命令继承的标记列表
-    flags_t flags_;
+    bool operator==(const error_t& rhs) const
+    {
+        return err_ == rhs;
+    }
 
-    // func_ 执行函数
-    func_t on_func_{ nullptr };
+    bool operator!=(const error_t& rhs) const
+    {
+        return err_ != rhs;
+    }
 
-    // parent_ptr_ 父级命令
-    pcmd_t parent_ptr_{ nullptr };
+private:
+    pflag_t flag_;
+    error_t err_;
 };
 
-/// make_cmd 创建指令
-inline pcmd_t make_cmd()
-{
-    return std::move(std::make_shared<cmd_t>());
-}
-
-/// make_cmd 创建指令
-inline pcmd_t make_cmd(const std::string& name)
-{
-    return std::move(std::make_shared<cmd_t>(name));
-}
-
 // ----------------------------------------------------------------------------
-// inner
+// cmd_t
 
-// inner 内部使用
-class inner
+// cmd_t 命令
+class cmd_t
 {
 public:
-    // get 获取实例
-    static inner& get()
+    cmd_t()
     {
-        static std::unique_ptr<inner> ins_{ nullptr };
-        static std::once_flag flagone;
-        std::call_once(flagone, []() {
-            ins_.reset(new inner());
-        });
-        return *ins_;
     }
 
-    // path 模块路径
-    const std::string& path() const
+    ~cmd_t()
     {
-        return path_;
     }
 
-    // name 应用名称
-    void name(const std::string& name)
+    explicit cmd_t(const std::string& name)
+        : name_(name)
     {
-        name_ = utils::filename(name);
     }
 
-    // name 应用名称
-    const std::string& name() const
+    cmd_t(const cmd_t& cpy)
+        : name_(cpy.name_)
+        , brief_(cpy.brief_)
+        , desc_(cpy.desc_)
+        , example_(cpy.example_)
+        , stack_(cpy.stack_)
+        , subs_(cpy.subs_)
+        , flags_(cpy.flags_)
+        , on_func_(cpy.on_func_)
+        , on_vfunc_(cpy.on_vfunc_)
+        , on_afunc_(cpy.on_afunc_)
     {
-        return name_;
     }
 
-    // desc 应用描述
-    void desc(const std::string& desc)
+    cmd_t(cmd_t&& mv) noexcept
+        : name_(std::move(mv.name_))
+        , brief_(std::move(mv.brief_))
+        , desc_(std::move(mv.desc_))
+        , example_(std::move(mv.example_))
+        , stack_(std::move(mv.stack_))
+        , subs_(std::move(mv.subs_))
+        , flags_(std::move(mv.flags_))
+        , on_func_(std::move(mv.on_func_))
+        , on_vfunc_(std::move(mv.on_vfunc_))
+        , on_afunc_(std::move(mv.on_afunc_))
     {
-        desc_ = desc;
     }
 
-    // desc 应用描述
-    const std::string& desc() const
+    cmd_t& operator=(const cmd_t& rhs)
     {
-        return desc_;
+        name_ = rhs.name_;
+        brief_ = rhs.brief_;
+        desc_ = rhs.desc_;
+        example_ = rhs.example_;
+        stack_ = rhs.stack_;
+        subs_ = rhs.subs_;
+        flags_ = rhs.flags_;
+        on_func_ = rhs.on_func_;
+        on_vfunc_ = rhs.on_vfunc_;
+        on_afunc_ = rhs.on_afunc_;
+        return *this;
     }
 
-    // version 版本号
-    void version(const std::string& version)
+    cmd_t& operator=(cmd_t&& mv) noexcept
     {
-        version_ = version;
+        name_ = std::move(mv.name_);
+        brief_ = std::move(mv.brief_);
+        desc_ = std::move(mv.desc_);
+        example_ = std::move(mv.example_);
+        stack_ = std::move(mv.stack_);
+        subs_ = std::move(mv.subs_);
+        flags_ = std::move(mv.flags_);
+        on_func_ = std::move(mv.on_func_);
+        on_vfunc_ = std::move(mv.on_vfunc_);
+        on_afunc_ = std::move(mv.on_afunc_);
+        return *this;
     }
 
-    // version 版本号
-    const std::string& version() const
+    // name 命令名称
+    void name(const std::string& name)
     {
-        return version_;
+        name_ = name;
     }
 
-    // argv 返回所有原始参数
-    const argv_t& argv(void)
+    // name 命令名称
+    const std::string& name() const
     {
-        return argv_;
+        return name_;
     }
 
-    // bind 绑定根函数
-    error_t bind(func_t func)
+    // brief 简短描述
+    void brief(const std::string& brief)
     {
-        return root_->bind(func);
+        brief_ = brief;
     }
 
-    // bind 绑定子指令
-    error_t bind(pcmd_t& ptr)
+    // brief 简短描述
+    const std::string& brief() const
     {
-        return root_->bind(ptr);
+        return brief_;
     }
 
-    // flag 标记
-    template <class T,
-        class = typename std::enable_if<!std::is_pointer<T>::value
-        && !std::is_const<T>::value
-        && !std::is_reference<T>::value, T>::type>
-        error_t flag(const std::string& name, const std::string& fast, T default_value,
-            const std::string& desc, bool extend = false)
+    // desc 命令描述
+    void desc(const std::string& desc)
     {
-        return root_->flag(name, fast, default_value, desc, extend);
+        desc_ = desc;
+    }
+
+    // desc 命令描述
+    const std::string& desc() const
+    {
+        return desc_;
+    }
+
+    // example 示例
+    void example(const std::string& example)
+    {
+        example_ = example;
+    }
+
+    // example 示例
+    const std::string& example() const
+    {
+        return example_;
+    }
+
+    // stack 堆栈，可确定当前命令在分支中的位置
+    // 堆栈并不是在绑定命令时确定的，而是在解析时确定的。
+    // 因为pcmd_t可以复用，存在于多条命令分支中。
+    void stack(const std::string& stack)
+    {
+        stack_ = stack;
+    }
+
+    // stack 堆栈，可确定当前命令在分支中的位置
+    // 堆栈并不是在绑定命令时确定的，而是在解析时确定的。
+    // 因为pcmd_t可以复用，存在于多条命令分支中。
+    // 命令执行期间返回解析上下文中的堆栈。
+    const std::string& stack() const
+    {
+        auto ctx = context_t::current();
+        if (nullptr != ctx && ctx->cmd().get() == this)
+        {
+            return ctx->stack();
+        }
+        return stack_;
+    }
+
+    // subs 子命令列表
+    cmds_t& subs()
+    {
+        return subs_;
+    }
+
+    // subs 子命令列表
+    const cmds_t& subs() const
+    {
+        return subs_;
+    }
+
+    /// flags 局部标记列表，不包括从上级命令继承的标记
+    flags_t& flags()
+    {
+        return flags_;
+    }
+
+    /// flags 局部标记列表，不包括从上级命令继承的标记
+    const flags_t& flags() const
+    {
+        return flags_;
+    }
+
+    // bind 绑定函数
+    error_t bind(func_t func)
+    {
+        on_func_ = func;
+        on_vfunc_ = nullptr;
+        on_afunc_ = nullptr;
+        return ok;
+    }
+
+    // bind 绑定函数，参数为视图，不复制参数
+    error_t bind(vfunc_t func)
+    {
+        on_vfunc_ = func;
+        on_func_ = nullptr;
+        on_afunc_ = nullptr;
+        return ok;
+    }
+
+    // bind 绑定异步函数
+    // 同步执行(exec)时会等待done；异步执行(exec_async)时不占用调用线程
+    error_t bind(afunc_t func)
+    {
+        on_afunc_ = func;
+        on_func_ = nullptr;
+        on_vfunc_ = nullptr;
+        return ok;
+    }
+
+    // is_async 是否绑定的是异步函数
+    bool is_async() const
+    {
+        return nullptr != on_afunc_;
+    }
+
+    // is_bound 是否绑定了函数
+    bool is_bound() const
+    {
+        return nullptr != on_func_ || nullptr != on_vfunc_ || nullptr != on_afunc_;
+    }
+
+    // eager 惰性模式下在命令函数之前转换并校验所有标记，错误由exec返回
+    void eager(bool eager)
+    {
+        eager_ = eager;
+    }
+
+    // eager 惰性模式下是否在命令函数之前校验所有标记
+    bool eager() const
+    {
+        return eager_;
+    }
+
+    // bind 绑定类型化的函数，schema中的标记会被添加到当前命令
+    template<class T>
+    error_t bind(const schema_t<T>& schema, typename schema_t<T>::func_t func)
+    {
+        return schema.bind(*this, func);
+    }
+
+    // bind 绑定子命令
+    // todo: 标准的命令名称的检查
+    error_t bind(cmd_t* cmd_ptr)
+    {
+        if (nullptr == cmd_ptr)
+        {
+            return make_error("error: cmd_t ptr is null");
+        }
+        if (cmd_ptr->name().empty())
+        {
+            return make_error("error: cmd_t name is null");
+        }
+        auto it = subs_.find(cmd_ptr->name());
+        if (it != subs_.end())
+        {
+            return make_error("error: double defined.");
+        }
+        subs_[cmd_ptr->name()].reset(cmd_ptr);
+        return ok;
+    }
+
+    // bind 绑定子命令
+    // todo: 标准的命令名称的检查
+    error_t bind(pcmd_t& cmd_ptr)
+    {
+        if (nullptr == cmd_ptr)
+        {
+            return make_error("error: cmd_t ptr is null");
+        }
+        if (cmd_ptr->name().empty())
+        {
+            return make_error("error: cmd_t name is null");
+        }
+        auto it = subs_.find(cmd_ptr->name());
+        if (it != subs_.end())
+        {
+            return make_error("error: double defined.");
+        }
+        subs_[cmd_ptr->name()] = cmd_ptr;
+        return ok;
     }
 
     // flag 标记
+    template <class T,
+        class = typename std::enable_if<!std::is_pointer<T>::value
+        && !std::is_const<T>::value
+        && !std::is_reference<T>::value, T>::type>
+        flag_ref<T> flag(const std::string& name, const std::string& fast, T default_value,
+            const std::string& desc, bool extend = false)
+    {
+        auto it = flags_.find("--" + name);
+        if (it != flags_.end())
+        {
+            return make_error("error: double defined flag. name=" + name);
+        }
+        auto flag_ptr = std::make_shared<flag_t>();
+        auto ret = flag_ptr->set<T>(name, fast, default_value, desc, extend);
+        if (ok != ret)
+        {
+            return ret;
+        }
+        if (fast != "" && flags_.find("-" + fast) != flags_.end())
+        {
+            return make_error("error: double defined flag. fast=" + fast + " name=" + name);
+        }
+        flags_["--" + name] = flag_ptr;
+        if (fast != "")
+        {
+            flags_["-" + fast] = flag_ptr;
+        }
+        return flag_ref<T>(flag_ptr);
+    }
+
+    // flag
     template <class T,
         class = typename std::enable_if<!std::is_pointer<T>::value
         && !std::is_const<T>::value
@@ -2099,10 +3807,30 @@ public:
         && !std::is_same<T, double>::value
         && !std::is_same<T, float>::value
         && !std::is_same<T, bool>::value, T>::type>
-        error_t flag(const std::string& name, const std::string& fast, T default_value,
+        flag_ref<T> flag(const std::string& name, const std::string& fast, T default_value,
             const std::vector<T>& options, const std::string& desc, bool extend = false)
     {
-        return root_->flag(name, fast, default_value, options, desc, extend);
+        auto it = flags_.find("--" + name);
+        if (it != flags_.end())
+        {
+            return make_error("error: double defined flag. name=" + name);
+        }
+        auto flag_ptr = std::make_shared<flag_t>();
+        auto ret = flag_ptr->set<T>(name, fast, default_value, options, desc, extend);
+        if (ok != ret)
+        {
+            return ret;
+        }
+        if (fast != "" && flags_.find("-" + fast) != flags_.end())
+        {
+            return make_error("error: double defined flag. fast=" + fast + " name=" + name);
+        }
+        flags_["--" + name] = flag_ptr;
+        if (fast != "")
+        {
+            flags_["-" + fast] = flag_ptr;
+        }
+        return flag_ref<T>(flag_ptr);
     }
 
     // pflag 标记
@@ -2113,10 +3841,30 @@ public:
         error_t pflag(T* ptr, const std::string& name, const std::string& fast, T default_value,
             const std::string& desc, bool extend = false)
     {
-        return root_->pflag(ptr, name, fast, default_value, desc, extend);
+        auto it = flags_.find("--" + name);
+        if (it != flags_.end())
+        {
+            return make_error("error: double defined flag. name=" + name);
+        }
+        auto flag_ptr = std::make_shared<flag_t>();
+        auto ret = flag_ptr->set<T>(ptr, name, fast, default_value, desc, extend);
+        if (ok != ret)
+        {
+            return ret;
+        }
+        if (fast != "" && flags_.find("-" + fast) != flags_.end())
+        {
+            return make_error("error: double defined flag. fast=" + fast + " name=" + name);
+        }
+        flags_["--" + name] = flag_ptr;
+        if (fast != "")
+        {
+            flags_["-" + fast] = flag_ptr;
+        }
+        return ok;
     }
 
-    // pflag 标记
+    // pflag
     template <class T,
         class = typename std::enable_if<!std::is_pointer<T>::value
         && !std::is_const<T>::value
@@ -2127,238 +3875,5279 @@ public:
         error_t pflag(T* ptr, const std::string& name, const std::string& fast, T default_value,
             const std::vector<T>& options, const std::string& desc, bool extend = false)
     {
-        return root_->pflag(ptr, name, fast, default_value, options, desc, extend);
+        auto it = flags_.find("--" + name);
+        if (it != flags_.end())
+        {
+            return make_error("error: double defined flag. name=" + name);
+        }
+        auto flag_ptr = std::make_shared<flag_t>();
+        auto ret = flag_ptr->set<T>(ptr, name, fast, default_value, options, desc, extend);
+        if (ok != ret)
+        {
+            return ret;
+        }
+        if (fast != "" && flags_.find("-" + fast) != flags_.end())
+        {
+            return make_error("error: double defined flag. fast=" + fast + " name=" + name);
+        }
+        flags_["--" + name] = flag_ptr;
+        if (fast != "")
+        {
+            flags_["-" + fast] = flag_ptr;
+        }
+        return ok;
     }
 
-    // _bind_init_func 绑定初始化函数
-    bool _bind_init_func(_init_func_t func, const char* file, int line)
+    // find_flag 查找标记，不存在时返回nullptr
+    // 命令执行期间包括从上级命令继承的标记
+    pflag_t find_flag(const std::string& name) const
     {
-        _inits_.push_back(std::make_tuple(func, file, line));
-        return false; // 返回值只是为了初始化一个全局静态变量，没有其他作用
+        auto ctx = context_t::current();
+        if (nullptr != ctx)
+        {
+            return ctx->find(name, this);
+        }
+        auto it = flags_.find(name);
+        if (it == flags_.end())
+        {
+            return nullptr;
+        }
+        return it->second;
     }
 
-    // exec 执行命令
-    error_t exec(const std::string& argv)
+    // cast 转换，不存在或类型不一致时会抛出异常
+    template<class T>
+    bool castable(const std::string& name)
     {
-        utils::split(argv_, argv, " ");
-
-        auto ret = bind_init();
-        if (ret != ok)
+        auto pflag = find_flag(name);
+        if (nullptr == pflag)
         {
-            return ret;
+            throw flag_cast_exception("not found.");
         }
-
-        return parse(argv_);
+        return pflag->castable<T>();
     }
 
-    // exec 执行命令
-    error_t exec(int argc, char* argv[])
+    // cast 转换，不存在或类型不一致时会抛出异常
+    template<class T>
+    T& cast(const std::string& name)
     {
-        path_ = argv[0];
-
-        if (name_.empty())
+        auto pflag = find_flag(name);
+        if (nullptr == pflag)
         {
-            name_ = utils::filename(argv[0]);
+            throw flag_cast_exception("not found.");
         }
+        return pflag->cast<T>();
+    }
 
-        argv_.clear();
-        for (int i = 1; i < argc; i++)
+    // parent 上级命令
+    // 上级命令并不是在绑定命令时确定的，而是在解析时确定的。
+    // 因为pcmd_t可以复用，存在于多条命令分支中。
+    // 不在命令执行期间时为nullptr。
+    const pcmd_t& parent() const
+    {
+        static const pcmd_t null_cmd{ nullptr };
+        auto ctx = context_t::current();
+        if (nullptr == ctx)
         {
-            argv_.push_back(argv[i]);
+            return null_cmd;
         }
+        return ctx->parent(this);
+    }
 
-        auto ret = bind_init();
-        if (ret != ok)
+    // on_exec 执行命令
+    error_t on_exec(const pcmd_t& pcmd, const args_t& args)
+    {
+        if (is_help())
         {
-            return ret;
+            return on_help();
         }
-
-        return parse(argv_);
-    }
-
+        if (nullptr != on_vfunc_ || nullptr != on_afunc_)
+        {
+            views_t views(args.begin(), args.end());
+            return on_exec(pcmd, args_view_t(views));
+        }
+        if (nullptr == on_func_)
+        {
+            return make_error(" warn: nothing to do");
+        }
+        return on_func_(pcmd, args);
+    }
+
+    // on_exec 执行命令，参数为视图
+    // 绑定的是func_t时才会复制参数；绑定的是afunc_t时等待完成
+    error_t on_exec(const pcmd_t& pcmd, const args_view_t& args)
+    {
+        if (is_help())
+        {
+            return on_help();
+        }
+        if (nullptr != on_vfunc_)
+        {
+            return on_vfunc_(pcmd, args);
+        }
+        if (nullptr != on_afunc_)
+        {
+            // done被重复调用时只有第一次有效
+            auto promise = std::make_shared<std::promise<error_t>>();
+            auto once = std::make_shared<std::atomic<bool>>(false);
+            auto future = promise->get_future();
+            on_afunc_(pcmd, args, [promise, once](const error_t& err)
+            {
+                if (!once->exchange(true))
+                {
+                    promise->set_value(err);
+                }
+            });
+            return future.get();
+        }
+        if (nullptr == on_func_)
+        {
+            return make_error(" warn: nothing to do");
+        }
+        auto ctx = context_t::current();
+        if (nullptr != ctx && ctx->args_view().begin() == args.begin())
+        {
+            return on_func_(pcmd, ctx->args());
+        }
+        return on_func_(pcmd, args.to_args());
+    }
+
+    // on_exec_async 异步执行命令，完成时调用done
+    // 只有绑定的是afunc_t时才是异步的，其他函数执行完成后直接调用done
+    void on_exec_async(const pcmd_t& pcmd, const args_view_t& args, const done_t& done)
+    {
+        if (nullptr != on_afunc_ && !is_help())
+        {
+            on_afunc_(pcmd, args, done);
+            return;
+        }
+        done(on_exec(pcmd, args));
+    }
+
 private:
-    inner(const inner& cpy) = delete;
-    inner& operator=(const inner& rhs) = delete;
-    inner()
-        : root_(new cmd_t())
+
+    // is_help 是否需要输出帮助信息
+    bool is_help() const
+    {
+        auto pflag = find_flag("--help");
+        return (nullptr != pflag && pflag->cast<bool>());
+    }
+
+    // on_help 输出帮助信息
+    // 帮助信息先生成到缓冲区，一次写入；执行期间按命令表的节点缓存，重新freeze后失效
+    error_t on_help();
+
+    // render_help 生成帮助信息，命令和标记都按名称排序
+    std::string render_help(const std::string& app_name, const std::string& app_desc,
+        const std::string& stack, const flags_t& visible) const
+    {
+        std::string os;
+        os.append("\n").append(name_.empty() ? app_desc : desc_).append("\n\n");
+
+        os.append("usage:\n  ").append(stack);
+        if (subs_.size() != 0)
+        {
+            os.append(" [cmds...]");
+        }
+        os.append(" [args...] [--flags...] \n\n");
+
+        if (subs_.size() != 0)
+        {
+            std::vector<const cmd_t*> subs;
+            size_t cmd_max_len = 0;
+            for (auto& item : subs_)
+            {
+                subs.push_back(item.second.get());
+                cmd_max_len = std::max(cmd_max_len, item.second->name().length());
+            }
+            std::sort(subs.begin(), subs.end(), [](const cmd_t* lhs, const cmd_t* rhs) -> bool
+            {
+                return lhs->name() < rhs->name();
+            });
+            os.append("cmds:\n");
+            for (auto& item : subs)
+            {
+                os.append("  ").append(utils::pading_right(item->name(), cmd_max_len, " "))
+                    .append("  ").append(item->brief()).append("\n");
+            }
+            os.append("\n");
+        }
+
+        // 每个标记的各列只取一次
+        struct row_t
+        {
+            std::string fast;
+            std::string name;
+            std::string type;
+            std::string value;
+            std::string desc;
+            std::string oneof;
+            bool extend;
+        };
+        std::vector<row_t> rows;
+        rows.reserve(visible.size());
+        size_t fast_max_len = 0;
+        size_t name_max_len = 0;
+        size_t type_max_len = 0;
+        size_t default_max_len = 0;
+        for (auto& item : visible)
+        {
+            auto& flag = item.second;
+            if (item.first != "--" + flag->name())
+            {
+                continue; // 快捷名称与长名称指向同一个标记
+            }
+            rows.emplace_back();
+            auto& row = rows.back();
+            row.fast = flag->fast();
+            row.name = flag->name();
+            row.type = flag->type_name();
+            row.value = flag->default_value();
+            row.desc = flag->desc();
+            row.extend = flag->extend();
+            auto& oneof = flag->oneof();
+            if (oneof.size() != 0)
+            {
+                row.oneof.append("  {");
+                for (auto eit = oneof.begin(); eit != oneof.end(); ++eit)
+                {
+                    if (eit != oneof.begin())
+                    {
+                        row.oneof.append(",");
+                    }
+                    row.oneof.append(*eit);
+                }
+                row.oneof.append("}");
+            }
+            fast_max_len = std::max(fast_max_len, row.fast.length());
+            name_max_len = std::max(name_max_len, row.name.length());
+            type_max_len = std::max(type_max_len, row.type.length());
+            default_max_len = std::max(default_max_len, row.value.length());
+        }
+        std::sort(rows.begin(), rows.end(), [](const row_t& lhs, const row_t& rhs) -> bool
+        {
+            return lhs.name < rhs.name;
+        });
+
+        os.append("flags:\n");
+        for (auto& row : rows)
+        {
+            os.append("  ")
+                .append(utils::pading_right((row.fast.empty() ? "" : "-" + row.fast + ","), fast_max_len + 2, " "))
+                .append(" ")
+                .append(utils::pading_right("--" + row.name, name_max_len + 2, " "))
+                .append("  ")
+                .append(utils::pading_right("<" + row.type + ">", type_max_len + 2, " "))
+                .append("  ")
+                .append(row.extend ? ":" : " ")
+                .append(utils::pading_right("(" + row.value + ")", default_max_len + 2, " "))
+                .append("  ")
+                .append(row.desc)
+                .append(row.oneof)
+                .append("\n");
+        }
+        os.append("\n");
+
+        if (!example_.empty())
+        {
+            os.append("example:\n  ").append(example_).append("\n\n");
+        }
+
+        os.append("for more information about a command:\n")
+            .append("  ").append(app_name).append(" [cmds...] -h\n")
+            .append("  ").append(app_name).append(" [cmds...] --help\n");
+        return os;
+    }
+
+    // name_ 命令名称，单行，合法的命令行标识符号
+    std::string name_;
+
+    // brief_ 简短描述
+    std::string brief_;
+
+    // desc_ 完整描述
+    std::string desc_;
+
+    // example 示例
+    std::string example_;
+
+    // stack_ 堆栈
+    std::string stack_;
+
+    // subs_ 子命令
+    cmds_t subs_;
+
+    // flags_ 局部标记列表, 会被子命令继承的标记列表
+    flags_t flags_;
+
+    // func_ 执行函数
+    func_t on_func_{ nullptr };
+
+    // on_vfunc_ 执行函数，参数为视图
+    vfunc_t on_vfunc_{ nullptr };
+
+    // on_afunc_ 异步执行函数
+    afunc_t on_afunc_{ nullptr };
+
+    // eager_ 惰性模式下是否在命令函数之前校验所有标记
+    bool eager_{ false };
+};
+
+/// make_cmd 创建指令
+inline pcmd_t make_cmd()
+{
+    return std::move(std::make_shared<cmd_t>());
+}
+
+/// make_cmd 创建指令
+inline pcmd_t make_cmd(const std::string& name)
+{
+    return std::move(std::make_shared<cmd_t>(name));
+}
+
+// ----------------------------------------------------------------------------
+// schema_t
+
+/// schema_t 类型化的标记定义
+/// 标记声明为T的成员，标记的类型由成员的类型确定，默认值和枚举值按成员的类型传入，
+/// 不能隐式转换时编译失败，可以隐式转换的（如double转int）会按成员的类型截断。
+/// 命令执行时按标记ID从解析上下文中取出转换好的值直接写入T的成员，
+/// 没有字符串查找、类型比较和dynamic_cast。
+/// 标记同样会添加到命令中，帮助信息和cast()都不受影响。
+template<class T>
+class schema_t
+{
+public:
+    /// func_t 命令函数，参数为填充好的T
+    using func_t = std::function<error_t(const pcmd_t& pcmd, const T& opts, const args_view_t& args)>;
+
+    /// flag 标记
+    /// default_value不参与类型推导，类型由member确定
+    template<class U>
+    schema_t& flag(U T::* member, const std::string& name, const std::string& fast,
+        const typename std::common_type<U>::type& default_value, const std::string& desc, bool extend = false)
+    {
+        field_t field;
+        field.name = "--" + name;
+        field.define = [=](cmd_t& cmd) -> error_t
+        {
+            return cmd.flag<U>(name, fast, default_value, desc, extend);
+        };
+        field.store = [member](T& opts, const flag_t& flag)
+        {
+            opts.*member = flag.get<U>();
+        };
+        fields_.push_back(field);
+        return *this;
+    }
+
+    /// flag 标记，带枚举值
+    template<class U>
+    schema_t& flag(U T::* member, const std::string& name, const std::string& fast,
+        const typename std::common_type<U>::type& default_value, const std::vector<U>& options,
+        const std::string& desc, bool extend = false)
+    {
+        field_t field;
+        field.name = "--" + name;
+        field.define = [=](cmd_t& cmd) -> error_t
+        {
+            return cmd.flag<U>(name, fast, default_value, options, desc, extend);
+        };
+        field.store = [member](T& opts, const flag_t& flag)
+        {
+            opts.*member = flag.get<U>();
+        };
+        fields_.push_back(field);
+        return *this;
+    }
+
+    /// size 标记数量
+    size_t size() const
+    {
+        return fields_.size();
+    }
+
+    /// bind 将标记添加到命令，并绑定函数
+    error_t bind(cmd_t& cmd, func_t func) const
+    {
+        if (nullptr == func)
+        {
+            return make_error("error: func is null");
+        }
+
+        auto stores = std::make_shared<std::vector<std::pair<pflag_t, store_t>>>();
+        stores->reserve(fields_.size());
+        for (auto& item : fields_)
+        {
+            auto err = item.define(cmd);
+            if (err != ok)
+            {
+                rollback(cmd, *stores);
+                return err;
+            }
+            stores->emplace_back(cmd.flags().at(item.name), item.store);
+        }
+
+        auto err = cmd.bind(vfunc_t([stores, func](const pcmd_t& pcmd, const args_view_t& args) -> error_t
+        {
+            T opts{};
+            for (auto& item : *stores)
+            {
+                item.second(opts, *item.first);
+            }
+            return func(pcmd, opts, args);
+        }));
+        if (err != ok)
+        {
+            rollback(cmd, *stores);
+        }
+        return err;
+    }
+
+private:
+    // store_t 将标记的值写入T的成员
+    using store_t = std::function<void(T& opts, const flag_t& flag)>;
+
+    // rollback 绑定失败时从命令中移除已经添加的标记
+    static void rollback(cmd_t& cmd, const std::vector<std::pair<pflag_t, store_t>>& stores)
+    {
+        for (auto& item : stores)
+        {
+            cmd.flags().erase("--" + item.first->name());
+            if (!item.first->fast().empty())
+            {
+                cmd.flags().erase("-" + item.first->fast());
+            }
+        }
+    }
+
+    // field_t 单个成员的定义
+    struct field_t
+    {
+        // name 长名称，"--name"
+        std::string name;
+
+        // define 在命令中添加标记
+        std::function<error_t(cmd_t& cmd)> define;
+
+        // store 写入成员
+        store_t store;
+    };
+
+    // fields_ 成员定义，按声明顺序
+    std::vector<field_t> fields_;
+};
+
+// ----------------------------------------------------------------------------
+// table_t
+
+// table_t 编译后的命令表
+// freeze时由命令树一次性生成，之后只读。节点、索引和名称都连续存储，
+// 命令节点和标记都使用整数ID，名称查找使用有序索引上的二分查找。
+// 同一个pcmd_t绑定在多条命令分支中时，每条分支都会生成独立的节点。
+class table_t
+{
+public:
+    // node_t 命令节点
+    struct node_t
+    {
+        // parent 上级节点，根节点为invalid_id
+        uint32_t parent{ invalid_id };
+
+        // subs 子命令索引范围 [subs_begin, subs_end)
+        uint32_t subs_begin{ 0 };
+        uint32_t subs_end{ 0 };
+
+        // longs 长名称标记索引范围 [longs_begin, longs_end)
+        uint32_t longs_begin{ 0 };
+        uint32_t longs_end{ 0 };
+
+        // subs_trie subs_bk 子命令的基数树和BK树根节点
+        uint32_t subs_trie{ invalid_id };
+        uint32_t subs_bk{ invalid_id };
+
+        // scope 节点可见的全部长名称标记 [scope_longs_begin, scope_longs_end)，包括继承的标记
+        // freeze时合并，查找时不再沿分支向上；快捷名称见shorts_
+        uint32_t scope_longs_begin{ 0 };
+        uint32_t scope_longs_end{ 0 };
+
+        // scope_trie scope_bk 可见长名称标记的基数树和BK树根节点
+        uint32_t scope_trie{ invalid_id };
+        uint32_t scope_bk{ invalid_id };
+    };
+
+    // entry_t 索引项，名称保存在pool_中
+    struct entry_t
+    {
+        uint32_t offset{ 0 };
+        uint32_t length{ 0 };
+        uint32_t id{ invalid_id };
+        bool extend{ false };
+    };
+
+    table_t()
+    {
+    }
+
+    table_t(const table_t& cpy) = delete;
+    table_t& operator=(const table_t& rhs) = delete;
+
+    // build 编译命令树，重复或冲突的定义会返回错误
+    // @param root pcmd_t 根命令
+    // @param name std::string 应用名称，用于错误信息中的堆栈
+    error_t build(const pcmd_t& root, const std::string& name)
+    {
+        static std::atomic<uint32_t> counter{ 0 };
+        serial_ = counter.fetch_add(1) + 1;
+
+        nodes_.clear();
+        cmds_.clear();
+        flags_.clear();
+        ids_.clear();
+        subs_.clear();
+        longs_.clear();
+        tries_.clear();
+        bks_.clear();
+        scope_longs_.clear();
+        shorts_.clear();
+        options_.clear();
+        pool_.clear();
+
+        nodes_.emplace_back();
+        cmds_.push_back(root);
+
+        // 广度优先，同一节点的子节点ID连续
+        for (uint32_t n = 0; n < nodes_.size(); n++)
+        {
+            auto err = build_flags(n, name);
+            if (err != ok)
+            {
+                return err;
+            }
+            err = build_subs(n, name);
+            if (err != ok)
+            {
+                return err;
+            }
+        }
+
+        return ok;
+    }
+
+    // size 节点数量
+    size_t size() const
+    {
+        return nodes_.size();
+    }
+
+    // node 节点
+    const node_t& node(uint32_t n) const
+    {
+        return nodes_[n];
+    }
+
+    // cmd 节点对应的命令
+    const pcmd_t& cmd(uint32_t n) const
+    {
+        return cmds_[n];
+    }
+
+    // flag 标记ID对应的标记
+    // @param id uint32_t 标记ID
+    const pflag_t& flag(uint32_t id) const
+    {
+        static const pflag_t null_flag{ nullptr };
+        if (id >= flags_.size())
+        {
+            return null_flag;
+        }
+        return flags_[id];
+    }
+
+    // flag_limit 标记ID的上限，即本表中标记的数量，用于按ID直接索引
+    uint32_t flag_limit() const
+    {
+        return static_cast<uint32_t>(flags_.size());
+    }
+
+    // id_of 标记在本表中的ID，不在本表中时为invalid_id
+    // 标记记录了最近一次加入的命令表，是本表时直接返回，否则查映射表
+    uint32_t id_of(const flag_t* flag) const
+    {
+        auto tag = flag->tag_.load(std::memory_order_acquire);
+        if (tag != flag_t::invalid_tag && static_cast<uint32_t>(tag >> 32) == serial_)
+        {
+            return static_cast<uint32_t>(tag);
+        }
+        auto it = ids_.find(flag);
+        return (it == ids_.end()) ? invalid_id : it->second;
+    }
+
+    // find_sub 查找子命令节点
+    // @param prefix bool 没有精确匹配时是否接受无歧义的前缀缩写，空的key不算缩写
+    // @return uint32_t 节点ID，不存在时为invalid_id
+    uint32_t find_sub(uint32_t n, const char* key, size_t len, bool prefix = false) const
+    {
+        if (len == 0)
+        {
+            return invalid_id;
+        }
+        uint32_t begin = 0;
+        uint32_t end = 0;
+        bool prefixed = false;
+        auto e = lookup(nodes_[n].subs_trie, key, len, begin, end, prefixed);
+        if (e != invalid_id)
+        {
+            return subs_[e].id;
+        }
+        if (prefix && prefixed && end - begin == 1)
+        {
+            return subs_[begin].id;
+        }
+        return invalid_id;
+    }
+
+    // find_name 按不带--的长名称查找标记，包括从上级命令继承的标记
+    // @return pflag_t 不存在时为nullptr
+    pflag_t find_name(uint32_t n, const char* key, size_t len) const
+    {
+        auto id = find_long(n, key, len, true);
+        if (id == invalid_id)
+        {
+            return nullptr;
+        }
+        return flags_[id];
+    }
+
+    // find_flag 查找标记，包括从上级命令继承的标记
+    // @param key char* "--name" 或 "-f"
+    // @param prefix bool 长名称没有精确匹配时是否接受无歧义的前缀缩写
+    // @return pflag_t 不存在时为nullptr
+    pflag_t find_flag(uint32_t n, const char* key, size_t len, bool prefix = false) const
+    {
+        uint32_t id = invalid_id;
+        if (len > 2 && key[0] == '-' && key[1] == '-')
+        {
+            id = find_long(n, key + 2, len - 2, true);
+            if (id == invalid_id && prefix)
+            {
+                std::vector<uint32_t> ids;
+                auto prefixed = match_long(n, key + 2, len - 2, ids);
+                if (prefixed && ids.size() == 1)
+                {
+                    id = ids[0];
+                }
+            }
+        }
+        else if (len == 2 && key[0] == '-' && key[1] != '-')
+        {
+            id = find_fast(n, key[1], true);
+        }
+        if (id == invalid_id)
+        {
+            return nullptr;
+        }
+        return flag(id);
+    }
+
+    // find_short 按快捷名称直接索引，用于组合的快捷名称
+    // @return pflag_t 不存在时为nullptr
+    pflag_t find_short(uint32_t n, char c) const
+    {
+        auto id = find_fast(n, c, true);
+        if (id == invalid_id)
+        {
+            return nullptr;
+        }
+        return flags_[id];
+    }
+
+    // collect 收集节点可见的标记，包括从上级命令继承的标记
+    void collect(flags_t& dst, uint32_t n) const
+    {
+        dst.clear();
+        auto& node = nodes_[n];
+        for (uint32_t e = node.scope_longs_begin; e < node.scope_longs_end; e++)
+        {
+            std::string key("--");
+            key.append(pool_, scope_longs_[e].offset, scope_longs_[e].length);
+            dst[key] = flag(scope_longs_[e].id);
+        }
+    }
+
+    // candidates 候选名称，结果有序
+    // key以-开始时为节点可见的长名称标记("--name")，否则为子命令。
+    // @return bool 为true时候选名称都以key为前缀(缩写有歧义)，
+    //              否则是与key有最长公共前缀的名称，没有公共前缀时为空
+    bool candidates(uint32_t n, const view_t& key, std::vector<std::string>& dst) const
+    {
+        dst.clear();
+        uint32_t begin = 0;
+        uint32_t end = 0;
+        bool prefixed = false;
+        if (!key.starts_with('-'))
+        {
+            lookup(nodes_[n].subs_trie, key.data(), key.size(), begin, end, prefixed);
+            for (uint32_t e = begin; e < end; e++)
+            {
+                dst.emplace_back(pool_, subs_[e].offset, subs_[e].length);
+            }
+            return prefixed;
+        }
+        if (key.size() <= 2 || key[1] != '-')
+        {
+            return false;
+        }
+
+        // 先取所有层级中以key为前缀的可见标记，没有时再取最长公共前缀
+        std::vector<uint32_t> ids;
+        prefixed = match_long(n, key.data() + 2, key.size() - 2, ids);
+        for (auto& item : ids)
+        {
+            dst.push_back("--" + flags_[item]->name());
+        }
+        std::sort(dst.begin(), dst.end());
+        return prefixed;
+    }
+
+    // suggest 拼写建议，编辑距离在阈值内的名称，按距离和名称排序
+    // key以--开始时为节点可见的长名称标记("--name")，否则为子命令
+    void suggest(uint32_t n, const view_t& key, std::vector<std::string>& dst) const
+    {
+        dst.clear();
+        std::vector<std::pair<uint32_t, uint32_t>> hits; // 距离, 索引项
+        std::vector<std::pair<uint32_t, std::string>> names;
+        if (!key.starts_with('-'))
+        {
+            search_bk(subs_, nodes_[n].subs_bk, key.data(), key.size(), threshold(key.size()), hits);
+            for (auto& item : hits)
+            {
+                names.emplace_back(item.first, std::string(pool_, subs_[item.second].offset, subs_[item.second].length));
+            }
+        }
+        else if (key.size() > 2 && key[1] == '-')
+        {
+            auto len = key.size() - 2;
+            search_bk(scope_longs_, nodes_[n].scope_bk, key.data() + 2, len, threshold(len), hits);
+            for (auto& item : hits)
+            {
+                auto& entry = scope_longs_[item.second];
+                names.emplace_back(item.first, "--" + std::string(pool_, entry.offset, entry.length));
+            }
+        }
+        std::sort(names.begin(), names.end());
+        for (auto& item : names)
+        {
+            dst.push_back(item.second);
+        }
+    }
+
+    // complete 补全，收集节点下以prefix开始的名称，结果有序
+    // prefix以-开始时补全节点可见的标记("--name")，否则补全子命令
+    void complete(uint32_t n, const view_t& prefix, std::vector<std::string>& dst) const
+    {
+        dst.clear();
+        if (prefix.starts_with('-'))
+        {
+            // 可见标记在freeze时已按名称排序，二分查找前缀的范围
+            if (prefix.size() > 1 && prefix[1] != '-')
+            {
+                return;
+            }
+            auto key = prefix.substr(prefix.size() > 2 ? 2 : prefix.size());
+            auto first = scope_longs_.begin() + nodes_[n].scope_longs_begin;
+            auto last = scope_longs_.begin() + nodes_[n].scope_longs_end;
+            auto it = std::lower_bound(first, last, key,
+                [this](const entry_t& entry, const view_t& key) -> bool
+                {
+                    return compare(entry, key.data(), key.size()) < 0;
+                });
+            for (; it != last && it->length >= key.size()
+                && memcmp(pool_.data() + it->offset, key.data(), key.size()) == 0; ++it)
+            {
+                dst.push_back("--" + std::string(pool_, it->offset, it->length));
+            }
+            return;
+        }
+        uint32_t begin = 0;
+        uint32_t end = 0;
+        bool prefixed = false;
+        lookup(nodes_[n].subs_trie, prefix.data(), prefix.size(), begin, end, prefixed);
+        if (!prefixed)
+        {
+            return;
+        }
+        for (uint32_t e = begin; e < end; e++)
+        {
+            dst.emplace_back(pool_, subs_[e].offset, subs_[e].length);
+        }
+    }
+
+    // options 补全标记的值，收集以prefix开始的可选项，结果有序
+    // @param id uint32_t 标记ID
+    void options(uint32_t id, const view_t& prefix, std::vector<std::string>& dst) const
+    {
+        dst.clear();
+        if (id >= options_.size())
+        {
+            return;
+        }
+        auto& items = options_[id];
+        auto it = std::lower_bound(items.begin(), items.end(), prefix.str());
+        for (; it != items.end() && view_t(*it).substr(0, prefix.size()) == prefix; ++it)
+        {
+            dst.push_back(*it);
+        }
+    }
+
+    // visible 节点可见的长名称标记ID，按名称排序
+    std::vector<uint32_t> visible(uint32_t n) const
+    {
+        std::vector<uint32_t> ret;
+        for (uint32_t e = nodes_[n].scope_longs_begin; e < nodes_[n].scope_longs_end; e++)
+        {
+            ret.push_back(scope_longs_[e].id);
+        }
+        return ret;
+    }
+
+    // help 节点的帮助信息，第一次请求时由render生成并缓存
+    // 应用名称或描述改变时重新生成；命令树改变后重新freeze，缓存随旧的命令表一起失效
+    std::shared_ptr<const std::string> help(uint32_t n, const std::string& name, const std::string& desc,
+        const std::function<std::string()>& render) const
+    {
+        std::string key(name);
+        key.push_back('\0');
+        key.append(desc);
+        {
+            std::lock_guard<std::mutex> lock(help_mutex_);
+            if (n < helps_.size() && nullptr != helps_[n].text && helps_[n].key == key)
+            {
+                return helps_[n].text;
+            }
+        }
+        auto text = std::make_shared<const std::string>(render());
+        std::lock_guard<std::mutex> lock(help_mutex_);
+        if (helps_.size() < nodes_.size())
+        {
+            helps_.resize(nodes_.size());
+        }
+        helps_[n].key = key;
+        helps_[n].text = text;
+        return text;
+    }
+
+    // stack 节点的堆栈，由应用名称和命令名称组成
+    std::string stack(uint32_t n, const std::string& name) const
+    {
+        std::vector<uint32_t> path;
+        for (uint32_t i = n; i != 0 && i != invalid_id; i = nodes_[i].parent)
+        {
+            path.push_back(i);
+        }
+        std::string ret(name);
+        for (auto it = path.rbegin(); it != path.rend(); ++it)
+        {
+            ret.append(" ").append(cmds_[*it]->name());
+        }
+        return ret;
+    }
+
+private:
+    // trie_t 基数树节点
+    // 同一层级的索引项有序，所以子树中的索引项是连续的一段；子节点在tries_中连续存储
+    struct trie_t
+    {
+        // 边的标签，保存在pool_中
+        uint32_t offset{ 0 };
+        uint32_t length{ 0 };
+
+        // children 子节点范围 [children_begin, children_end)，按标签的首字符有序
+        uint32_t children_begin{ 0 };
+        uint32_t children_end{ 0 };
+
+        // 子树中的索引项范围 [begin, end)
+        uint32_t begin{ 0 };
+        uint32_t end{ 0 };
+
+        // terminal 从根到本节点的前缀本身是一个名称，即索引项begin
+        bool terminal{ false };
+    };
+
+    // build_trie 为有序的索引范围建立基数树，返回根节点
+    uint32_t build_trie(const std::vector<entry_t>& entries, uint32_t begin, uint32_t end)
+    {
+        auto root = static_cast<uint32_t>(tries_.size());
+        tries_.emplace_back();
+        fill_trie(entries, root, begin, end, 0);
+        return root;
+    }
+
+    // fill_trie 填充节点，depth为父节点之前已匹配的长度
+    void fill_trie(const std::vector<entry_t>& entries, uint32_t t, uint32_t begin, uint32_t end, uint32_t depth)
+    {
+        tries_[t].begin = begin;
+        tries_[t].end = end;
+        if (begin == end)
+        {
+            return;
+        }
+
+        // 有序范围的公共前缀就是首尾两项的公共前缀
+        auto& first = entries[begin];
+        auto& last = entries[end - 1];
+        uint32_t common = depth;
+        while (common < first.length && common < last.length
+            && pool_[first.offset + common] == pool_[last.offset + common])
+        {
+            common++;
+        }
+        tries_[t].offset = first.offset + depth;
+        tries_[t].length = common - depth;
+        tries_[t].terminal = (first.length == common);
+
+        // 按下一个字符分组
+        std::vector<std::pair<uint32_t, uint32_t>> groups;
+        uint32_t i = tries_[t].terminal ? begin + 1 : begin;
+        while (i < end)
+        {
+            char c = pool_[entries[i].offset + common];
+            uint32_t j = i + 1;
+            while (j < end && pool_[entries[j].offset + common] == c)
+            {
+                j++;
+            }
+            groups.emplace_back(i, j);
+            i = j;
+        }
+
+        auto children = static_cast<uint32_t>(tries_.size());
+        tries_[t].children_begin = children;
+        tries_[t].children_end = children + static_cast<uint32_t>(groups.size());
+        tries_.resize(tries_.size() + groups.size());
+        for (size_t g = 0; g < groups.size(); g++)
+        {
+            fill_trie(entries, children + static_cast<uint32_t>(g), groups[g].first, groups[g].second, common);
+        }
+    }
+
+    // lookup 在基数树中查找，只比较key的长度次字符
+    // @param begin end 以key为前缀的索引项范围(prefixed为true)，
+    //                  或者与key有最长公共前缀的索引项范围(prefixed为false，没有公共前缀时为空)
+    // @return uint32_t 精确匹配的索引项下标，不存在时为invalid_id
+    uint32_t lookup(uint32_t t, const char* key, size_t len,
+        uint32_t& begin, uint32_t& end, bool& prefixed) const
+    {
+        begin = end = 0;
+        prefixed = false;
+        if (t == invalid_id)
+        {
+            return invalid_id;
+        }
+
+        size_t depth = 0;
+        uint32_t near = invalid_id; // 完整匹配了标签的最深节点
+        while (true)
+        {
+            auto& node = tries_[t];
+            auto label = pool_.data() + node.offset;
+            size_t rest = len - depth;
+            size_t m = 0;
+            while (m < node.length && m < rest && label[m] == key[depth + m])
+            {
+                m++;
+            }
+            if (m == rest)
+            {
+                // key耗尽，子树中的名称都以key为前缀
+                begin = node.begin;
+                end = node.end;
+                prefixed = true;
+                if (m == node.length && node.terminal)
+                {
+                    return node.begin;
+                }
+                return invalid_id;
+            }
+            if (m < node.length)
+            {
+                // 在标签中间不匹配
+                if (depth + m > 0)
+                {
+                    auto& hit = (m > 0) ? node : tries_[near];
+                    begin = hit.begin;
+                    end = hit.end;
+                }
+                return invalid_id;
+            }
+
+            depth += node.length;
+            near = t;
+            uint32_t next = invalid_id;
+            for (uint32_t c = node.children_begin; c < node.children_end; c++)
+            {
+                if (pool_[tries_[c].offset] == key[depth])
+                {
+                    next = c;
+                    break;
+                }
+            }
+            if (next == invalid_id)
+            {
+                if (depth > 0)
+                {
+                    begin = node.begin;
+                    end = node.end;
+                }
+                return invalid_id;
+            }
+            t = next;
+        }
+    }
+
+    // bk_t BK树节点
+    // 子树中的名称与父节点名称的编辑距离都等于distance；子节点在bks_中连续存储
+    struct bk_t
+    {
+        uint32_t entry{ 0 };
+        uint32_t distance{ 0 };
+        uint32_t children_begin{ 0 };
+        uint32_t children_end{ 0 };
+    };
+
+    // build_bk 为索引范围建立BK树，返回根节点，范围为空时为invalid_id
+    uint32_t build_bk(const std::vector<entry_t>& entries, uint32_t begin, uint32_t end)
+    {
+        if (begin == end)
+        {
+            return invalid_id;
+        }
+        std::vector<uint32_t> items;
+        for (uint32_t e = begin; e < end; e++)
+        {
+            items.push_back(e);
+        }
+        auto root = static_cast<uint32_t>(bks_.size());
+        bks_.emplace_back();
+        fill_bk(entries, root, items);
+        return root;
+    }
+
+    // fill_bk 以items[0]为节点，其余的按与它的编辑距离分组为子树
+    void fill_bk(const std::vector<entry_t>& entries, uint32_t t, const std::vector<uint32_t>& items)
+    {
+        auto& self = entries[items[0]];
+        bks_[t].entry = items[0];
+
+        std::vector<std::pair<uint32_t, uint32_t>> others; // 距离, 索引项
+        for (size_t i = 1; i < items.size(); i++)
+        {
+            auto& entry = entries[items[i]];
+            others.emplace_back(distance(pool_.data() + self.offset, self.length,
+                pool_.data() + entry.offset, entry.length), items[i]);
+        }
+        std::stable_sort(others.begin(), others.end(),
+            [](const std::pair<uint32_t, uint32_t>& lhs, const std::pair<uint32_t, uint32_t>& rhs) -> bool
+            {
+                return lhs.first < rhs.first;
+            });
+
+        std::vector<std::vector<uint32_t>> groups;
+        std::vector<uint32_t> distances;
+        for (auto& item : others)
+        {
+            if (distances.empty() || distances.back() != item.first)
+            {
+                distances.push_back(item.first);
+                groups.emplace_back();
+            }
+            groups.back().push_back(item.second);
+        }
+
+        auto children = static_cast<uint32_t>(bks_.size());
+        bks_[t].children_begin = children;
+        bks_[t].children_end = children + static_cast<uint32_t>(groups.size());
+        bks_.resize(bks_.size() + groups.size());
+        for (size_t g = 0; g < groups.size(); g++)
+        {
+            bks_[children + g].distance = distances[g];
+            fill_bk(entries, children + static_cast<uint32_t>(g), groups[g]);
+        }
+    }
+
+    // search_bk 在BK树中查找编辑距离不超过limit的名称
+    // 由三角不等式，只需要进入距离在[d - limit, d + limit]内的子树
+    void search_bk(const std::vector<entry_t>& entries, uint32_t root, const char* key, size_t len,
+        uint32_t limit, std::vector<std::pair<uint32_t, uint32_t>>& dst) const
+    {
+        dst.clear();
+        if (root == invalid_id)
+        {
+            return;
+        }
+        std::vector<uint32_t> stack{ root };
+        while (!stack.empty())
+        {
+            auto& node = bks_[stack.back()];
+            stack.pop_back();
+            auto& entry = entries[node.entry];
+            // 子节点按距离升序，超过最远子节点距离+limit后精确值已经不影响结果
+            auto bound = limit;
+            if (node.children_end > node.children_begin)
+            {
+                bound += bks_[node.children_end - 1].distance;
+            }
+            auto d = distance(pool_.data() + entry.offset, entry.length, key, len, bound);
+            if (d <= limit)
+            {
+                dst.emplace_back(d, node.entry);
+            }
+            for (uint32_t c = node.children_begin; c < node.children_end; c++)
+            {
+                if (bks_[c].distance + limit >= d && bks_[c].distance <= d + limit)
+                {
+                    stack.push_back(c);
+                }
+            }
+        }
+    }
+
+    // distance 编辑距离(Levenshtein)
+    // @param bound uint32_t 距离超过bound时提前结束，返回bound + 1
+    static uint32_t distance(const char* a, size_t alen, const char* b, size_t blen,
+        uint32_t bound = std::numeric_limits<uint32_t>::max() - 1)
+    {
+        if ((alen > blen ? alen - blen : blen - alen) > bound)
+        {
+            return bound + 1;
+        }
+        // 名称都很短，一行状态放在栈上，超长时才分配
+        uint32_t buf[64];
+        std::vector<uint32_t> heap;
+        uint32_t* row = buf;
+        if (blen + 1 > sizeof(buf) / sizeof(buf[0]))
+        {
+            heap.resize(blen + 1);
+            row = heap.data();
+        }
+        for (size_t j = 0; j <= blen; j++)
+        {
+            row[j] = static_cast<uint32_t>(j);
+        }
+        for (size_t i = 1; i <= alen; i++)
+        {
+            uint32_t diag = row[0];
+            row[0] = static_cast<uint32_t>(i);
+            uint32_t low = row[0];
+            for (size_t j = 1; j <= blen; j++)
+            {
+                uint32_t up = row[j];
+                uint32_t cost = (a[i - 1] == b[j - 1]) ? 0 : 1;
+                row[j] = std::min(std::min(row[j] + 1, row[j - 1] + 1), diag + cost);
+                low = std::min(low, row[j]);
+                diag = up;
+            }
+            // 每行的最小值不会减小
+            if (low > bound)
+            {
+                return bound + 1;
+            }
+        }
+        return std::min(row[blen], bound + 1);
+    }
+
+    // threshold 拼写建议的编辑距离阈值，短名称只允许一处错误
+    static uint32_t threshold(size_t len)
+    {
+        return len <= 3 ? 1 : 2;
+    }
+
+    // match_long 在节点可见的长名称标记中按前缀匹配
+    // @param ids 以key为前缀的可见标记ID；没有时为与key有最长公共前缀的可见标记ID
+    // @return bool ids是否以key为前缀
+    bool match_long(uint32_t n, const char* key, size_t len, std::vector<uint32_t>& ids) const
+    {
+        ids.clear();
+        uint32_t begin = 0;
+        uint32_t end = 0;
+        bool prefixed = false;
+        lookup(nodes_[n].scope_trie, key, len, begin, end, prefixed);
+        for (uint32_t e = begin; e < end; e++)
+        {
+            ids.push_back(scope_longs_[e].id);
+        }
+        return prefixed;
+    }
+
+    // compare 比较索引项和名称
+    int compare(const entry_t& entry, const char* key, size_t len) const
+    {
+        size_t min_len = entry.length < len ? entry.length : len;
+        int cmp = memcmp(pool_.data() + entry.offset, key, min_len);
+        if (cmp != 0)
+        {
+            return cmp;
+        }
+        if (entry.length == len)
+        {
+            return 0;
+        }
+        return entry.length < len ? -1 : 1;
+    }
+
+    // find_long 在节点的合并视图中按长名称查找
+    // @param local bool 为false时只查找子命令可以继承的标记
+    uint32_t find_long(uint32_t n, const char* key, size_t len, bool local) const
+    {
+        uint32_t begin = 0;
+        uint32_t end = 0;
+        bool prefixed = false;
+        auto e = lookup(nodes_[n].scope_trie, key, len, begin, end, prefixed);
+        if (e == invalid_id)
+        {
+            return invalid_id;
+        }
+        return (local || scope_longs_[e].extend) ? scope_longs_[e].id : invalid_id;
+    }
+
+    // find_fast 在节点的快捷名称表中直接索引，不计算哈希也不生成字符串
+    // @param local bool 为false时只查找子命令可以继承的标记
+    uint32_t find_fast(uint32_t n, char c, bool local) const
+    {
+        auto u = static_cast<unsigned char>(c);
+        if (u >= short_limit)
+        {
+            return invalid_id;
+        }
+        auto id = shorts_[n * short_limit + u];
+        if (id == invalid_id || !(local || flags_[id]->extend()))
+        {
+            return invalid_id;
+        }
+        return id;
+    }
+
+    // append 添加索引项
+    void append(std::vector<entry_t>& entries, const std::string& key, uint32_t id, bool extend = false)
+    {
+        entry_t entry;
+        entry.offset = static_cast<uint32_t>(pool_.size());
+        entry.length = static_cast<uint32_t>(key.length());
+        entry.id = id;
+        entry.extend = extend;
+        pool_.append(key);
+        entries.push_back(entry);
+    }
+
+    // sort 对索引范围排序
+    void sort(std::vector<entry_t>& entries, uint32_t begin, uint32_t end)
+    {
+        std::sort(entries.begin() + begin, entries.begin() + end,
+            [this](const entry_t& lhs, const entry_t& rhs) -> bool
+            {
+                return compare(lhs, pool_.data() + rhs.offset, rhs.length) < 0;
+            });
+    }
+
+    // assign_id 分配标记在本表中的ID，多个节点共用的标记只分配一次
+    uint32_t assign_id(const pflag_t& flag)
+    {
+        auto it = ids_.find(flag.get());
+        if (it != ids_.end())
+        {
+            return it->second;
+        }
+        auto id = static_cast<uint32_t>(flags_.size());
+        ids_[flag.get()] = id;
+        flags_.push_back(flag);
+        flag->index_oneof(); // 通过oneof()修改的可选项在这里重新编译
+        options_.push_back(flag->oneof());
+        std::sort(options_.back().begin(), options_.back().end());
+        flag->tag_.store((uint64_t(serial_) << 32) | id, std::memory_order_release);
+        return id;
+    }
+
+    // build_flags 编译节点的标记
+    error_t build_flags(uint32_t n, const std::string& name)
+    {
+        auto& cmd = cmds_[n];
+
+        // 按名称排序，保证编译结果与unordered_map的遍历顺序无关
+        std::vector<std::pair<std::string, pflag_t>> locals;
+        for (auto& item : cmd->flags())
+        {
+            if (nullptr == item.second)
+            {
+                return make_error("error: flag is null. key=" + item.first, stack(n, name));
+            }
+            auto& flag = item.second;
+            if (item.first == "--" + flag->name())
+            {
+                locals.emplace_back(flag->name(), flag);
+                continue;
+            }
+            if (flag->fast().empty() || item.first != "-" + flag->fast())
+            {
+                return make_error("error: flag key mismatch. key=" + item.first, stack(n, name));
+            }
+        }
+        std::sort(locals.begin(), locals.end(),
+            [](const std::pair<std::string, pflag_t>& lhs, const std::pair<std::string, pflag_t>& rhs) -> bool
+            {
+                return lhs.first < rhs.first;
+            });
+
+        // 快捷名称表从上级命令的表复制，去掉不可继承的标记，再加入局部的标记，局部的标记遮盖继承的同名标记
+        auto parent = nodes_[n].parent;
+        shorts_.resize((n + 1) * short_limit, invalid_id);
+        auto shorts = shorts_.begin() + n * short_limit;
+        if (parent != invalid_id)
+        {
+            for (uint32_t c = 0; c < short_limit; c++)
+            {
+                auto id = shorts_[parent * short_limit + c];
+                shorts[c] = (id != invalid_id && flags_[id]->extend()) ? id : invalid_id;
+            }
+        }
+
+        nodes_[n].longs_begin = static_cast<uint32_t>(longs_.size());
+        for (auto& item : locals)
+        {
+            auto& flag = item.second;
+            auto id = assign_id(flag);
+
+            // 快捷名称注册失败时只有长名称被加入了列表
+            if (!flag->fast().empty())
+            {
+                auto fit = cmd->flags().find("-" + flag->fast());
+                if (fit == cmd->flags().end() || fit->second != flag)
+                {
+                    return make_error("error: double defined flag. fast=" + flag->fast()
+                        + " name=" + flag->name(), stack(n, name));
+                }
+            }
+
+            append(longs_, flag->name(), id, flag->extend());
+            if (!flag->fast().empty())
+            {
+                shorts[static_cast<unsigned char>(flag->fast()[0])] = id;
+            }
+        }
+        nodes_[n].longs_end = static_cast<uint32_t>(longs_.size());
+        sort(longs_, nodes_[n].longs_begin, nodes_[n].longs_end);
+
+        auto& node = nodes_[n];
+        node.scope_longs_begin = static_cast<uint32_t>(scope_longs_.size());
+        merge_scope(scope_longs_, longs_, node.longs_begin, node.longs_end,
+            node.parent == invalid_id ? 0 : nodes_[node.parent].scope_longs_begin,
+            node.parent == invalid_id ? 0 : nodes_[node.parent].scope_longs_end);
+        node.scope_longs_end = static_cast<uint32_t>(scope_longs_.size());
+        node.scope_trie = build_trie(scope_longs_, node.scope_longs_begin, node.scope_longs_end);
+        node.scope_bk = build_bk(scope_longs_, node.scope_longs_begin, node.scope_longs_end);
+        return ok;
+    }
+
+    // merge_scope 合并节点的视图：局部的标记，加上上级视图中可继承且没有被局部同名标记遮盖的标记
+    // 局部索引和上级视图都是有序的，按名称归并，结果有序
+    void merge_scope(std::vector<entry_t>& scope, const std::vector<entry_t>& locals,
+        uint32_t begin, uint32_t end, uint32_t parent_begin, uint32_t parent_end)
+    {
+        uint32_t i = begin;
+        uint32_t j = parent_begin;
+        while (i < end || j < parent_end)
+        {
+            if (j < parent_end && !scope[j].extend)
+            {
+                j++;
+                continue;
+            }
+            if (j == parent_end)
+            {
+                scope.push_back(locals[i++]);
+                continue;
+            }
+            auto inherited = scope[j];
+            if (i == end)
+            {
+                scope.push_back(inherited);
+                j++;
+                continue;
+            }
+            int cmp = compare(locals[i], pool_.data() + inherited.offset, inherited.length);
+            if (cmp <= 0)
+            {
+                scope.push_back(locals[i++]);
+                if (cmp == 0)
+                {
+                    j++;
+                }
+            }
+            else
+            {
+                scope.push_back(inherited);
+                j++;
+            }
+        }
+    }
+
+    // build_subs 编译节点的子命令
+    error_t build_subs(uint32_t n, const std::string& name)
+    {
+        auto cmd = cmds_[n];
+
+        std::vector<std::pair<std::string, pcmd_t>> subs(cmd->subs().begin(), cmd->subs().end());
+        std::sort(subs.begin(), subs.end(),
+            [](const std::pair<std::string, pcmd_t>& lhs, const std::pair<std::string, pcmd_t>& rhs) -> bool
+            {
+                return lhs.first < rhs.first;
+            });
+
+        nodes_[n].subs_begin = static_cast<uint32_t>(subs_.size());
+        for (auto& item : subs)
+        {
+            if (nullptr == item.second)
+            {
+                return make_error("error: cmd_t ptr is null. name=" + item.first, stack(n, name));
+            }
+            if (item.first.empty() || item.first[0] == '-'
+                || item.first.find_first_of(" \t\r\n=") != std::string::npos)
+            {
+                return make_error("error: invalid cmd name. name=" + item.first, stack(n, name));
+            }
+            if (item.first != item.second->name())
+            {
+                return make_error("error: cmd name mismatch. name=" + item.first, stack(n, name));
+            }
+            for (uint32_t i = n; i != invalid_id; i = nodes_[i].parent)
+            {
+                if (cmds_[i] == item.second)
+                {
+                    return make_error("error: cyclic cmd. name=" + item.first, stack(n, name));
+                }
+            }
+
+            node_t node;
+            node.parent = n;
+            append(subs_, item.first, static_cast<uint32_t>(nodes_.size()));
+            nodes_.push_back(node);
+            cmds_.push_back(item.second);
+        }
+        nodes_[n].subs_end = static_cast<uint32_t>(subs_.size());
+        nodes_[n].subs_trie = build_trie(subs_, nodes_[n].subs_begin, nodes_[n].subs_end);
+        nodes_[n].subs_bk = build_bk(subs_, nodes_[n].subs_begin, nodes_[n].subs_end);
+        return ok;
+    }
+
+    // nodes_ 命令节点
+    std::vector<node_t> nodes_;
+
+    // cmds_ 节点对应的命令
+    std::vector<pcmd_t> cmds_;
+
+    // flags_ 标记ID对应的标记，按ID直接索引
+    std::vector<pflag_t> flags_;
+
+    // ids_ 标记到本表ID的映射，ID在build时按出现顺序连续分配
+    std::unordered_map<const flag_t*, uint32_t> ids_;
+
+    // serial_ 命令表序号，每次build重新分配，用于识别标记中缓存的ID
+    uint32_t serial_{ 0 };
+
+    // subs_ 子命令索引
+    std::vector<entry_t> subs_;
+
+    // longs_ 长名称标记索引
+    std::vector<entry_t> longs_;
+
+    // shorts_ 快捷名称表，每个节点short_limit项，按字符直接索引到标记ID，包括继承的标记
+    std::vector<uint32_t> shorts_;
+
+    // tries_ 基数树节点
+    std::vector<trie_t> tries_;
+
+    // bks_ BK树节点
+    std::vector<bk_t> bks_;
+
+    // scope_longs_ 节点可见的全部长名称标记，每个节点一段
+    std::vector<entry_t> scope_longs_;
+
+    // options_ 标记ID对应的有序可选项
+    std::vector<std::vector<std::string>> options_;
+
+    // help_t 缓存的帮助信息
+    struct help_t
+    {
+        std::string key;
+        std::shared_ptr<const std::string> text;
+    };
+
+    // helps_ 节点的帮助信息缓存
+    mutable std::mutex help_mutex_;
+    mutable std::vector<help_t> helps_;
+
+    // pool_ 名称
+    std::string pool_;
+};
+
+// ----------------------------------------------------------------------------
+// context_t
+
+inline context_t::slot_t* context_t::slot(const flag_t* flag)
+{
+    return (nullptr == table_) ? nullptr : slot(table_->id_of(flag));
+}
+
+inline context_t::slot_t* context_t::slot_of(const flag_t* flag)
+{
+    auto id = (nullptr == table_) ? invalid_id : table_->id_of(flag);
+    if (id >= index_.size())
+    {
+        return nullptr; // 不在命令表中
+    }
+    if (index_[id] == 0)
+    {
+        slots_.emplace_back();
+        slots_.back().id = id;
+        index_[id] = static_cast<uint32_t>(slots_.size());
+    }
+    return &slots_[index_[id] - 1];
+}
+
+inline error_t context_t::settle()
+{
+    for (auto& item : slots_)
+    {
+        auto err = settle(table_->flag(item.id).get(), item);
+        if (err != ok)
+        {
+            return err;
+        }
+    }
+    return ok;
+}
+
+inline const std::string& context_t::stack() const
+{
+    if (!stack_ready_)
+    {
+        stack_ = table_->stack(node(), *name_);
+        stack_ready_ = true;
+    }
+    return stack_;
+}
+
+inline pflag_t context_t::find(const std::string& key, const cmd_t* from) const
+{
+    for (size_t i = chain_.size(); i > 0; i--)
+    {
+        if (chain_[i - 1].get() == from)
+        {
+            return table_->find_flag(nodes_[i - 1], key.c_str(), key.length());
+        }
+    }
+
+    // 不在命令分支中，只查找局部标记
+    auto it = from->flags().find(key);
+    if (it == from->flags().end())
+    {
+        return nullptr;
+    }
+    return it->second;
+}
+
+inline void context_t::collect(flags_t& dst, const cmd_t* from) const
+{
+    for (size_t i = chain_.size(); i > 0; i--)
+    {
+        if (chain_[i - 1].get() == from)
+        {
+            table_->collect(dst, nodes_[i - 1]);
+            return;
+        }
+    }
+    dst = from->flags();
+}
+
+// ----------------------------------------------------------------------------
+// cmd_t
+
+inline error_t cmd_t::on_help()
+{
+    auto ctx = context_t::current();
+    std::ostream& os = (nullptr != ctx) ? ctx->out() : std::cout;
+
+    std::shared_ptr<const std::string> text;
+    if (nullptr != ctx && ctx->cmd().get() == this)
+    {
+        text = ctx->table().help(ctx->node(), ctx->name(), ctx->desc(), [this, ctx]() -> std::string
+        {
+            flags_t visible;
+            ctx->collect(visible, this);
+            return render_help(ctx->name(), ctx->desc(), ctx->stack(), visible);
+        });
+    }
+    else
+    {
+        flags_t visible;
+        if (nullptr != ctx)
+        {
+            ctx->collect(visible, this);
+        }
+        else
+        {
+            visible = flags_;
+        }
+        text = std::make_shared<const std::string>(render_help(
+            (nullptr != ctx) ? ctx->name() : clips::name(),
+            (nullptr != ctx) ? ctx->desc() : clips::desc(),
+            stack(), visible));
+    }
+
+    os.write(text->data(), static_cast<std::streamsize>(text->size()));
+    os.flush();
+    return ok;
+}
+
+// ----------------------------------------------------------------------------
+// parse_result_t
+
+// parse_result_t 解析结果
+// 保存解析到的命令节点、转换后的标记值和命令参数，可以不经过分词、查找和转换直接执行。
+// 只在生成它的命令表上有效，重新freeze之后需要重新解析。
+class parse_result_t
+{
+public:
+    parse_result_t()
+    {
+    }
+
+    parse_result_t(const parse_result_t& cpy)
+        : table_(cpy.table_)
+        , nodes_(cpy.nodes_)
+        , tokens_(cpy.tokens_)
+        , args_(cpy.args_)
+    {
+        values_.reserve(cpy.values_.size());
+        for (auto& item : cpy.values_)
+        {
+            values_.emplace_back();
+            auto& value = values_.back();
+            value.id = item.id;
+            value.value = bool(item.value) ? item.value->clone() : nullptr;
+            value.text = item.text;
+            value.exist = item.exist;
+            value.pending = item.pending;
+        }
+    }
+
+    parse_result_t(parse_result_t&& mv) = default;
+    parse_result_t& operator=(parse_result_t&& mv) = default;
+
+    parse_result_t& operator=(const parse_result_t& rhs)
+    {
+        if (this != &rhs)
+        {
+            parse_result_t cpy(rhs);
+            *this = std::move(cpy);
+        }
+        return *this;
+    }
+
+    /// table 生成结果的命令表
+    const std::shared_ptr<const table_t>& table() const
+    {
+        return table_;
+    }
+
+    /// node 解析到的命令节点ID
+    uint32_t node() const
+    {
+        return nodes_.empty() ? invalid_id : nodes_.back();
+    }
+
+    /// nodes 命令分支的节点ID，从根命令到解析到的命令
+    const std::vector<uint32_t>& nodes() const
+    {
+        return nodes_;
+    }
+
+    /// tokens 原始参数
+    const argv_t& tokens() const
+    {
+        return tokens_;
+    }
+
+    /// args 命令参数，未去除引号
+    const argv_t& args() const
+    {
+        return args_;
+    }
+
+    /// flags 显式设置的标记，按设置的顺序
+    std::vector<pflag_t> flags() const
+    {
+        std::vector<pflag_t> ret;
+        ret.reserve(values_.size());
+        for (auto& item : values_)
+        {
+            if (item.exist)
+            {
+                ret.push_back(table_->flag(item.id));
+            }
+        }
+        return ret;
+    }
+
+    /// exist 标记是否显式设置
+    bool exist(const pflag_t& flag) const
+    {
+        auto item = find(flag);
+        return nullptr != item && item->exist;
+    }
+
+    /// value 转换后的值，没有设置或者类型不一致时返回nullptr
+    template<class T>
+    const T* value(const pflag_t& flag) const
+    {
+        auto item = find(flag);
+        if (nullptr == item || !bool(item->value)
+            || item->value->type_index() != std::type_index(typeid(T)))
+        {
+            return nullptr;
+        }
+        return &static_cast<const flag_t::value_holder<T>*>(item->value.get())->value_;
+    }
+
+    /// serialize 序列化为紧凑的二进制格式
+    /// 标记以所在的分支深度和名称保存，不依赖进程内的标记ID；值保存为输入的字符串
+    void serialize(std::string& dst) const
+    {
+        dst.clear();
+        dst.append(magic());
+        put(dst, static_cast<uint32_t>(nodes_.size()));
+        for (auto& item : nodes_)
+        {
+            put(dst, item);
+        }
+        put(dst, tokens_);
+        put(dst, args_);
+        put(dst, static_cast<uint32_t>(values_.size()));
+        for (auto& item : values_)
+        {
+            auto& flag = table_->flag(item.id);
+            put(dst, depth(flag));
+            put(dst, view_t(flag->name()));
+            dst.push_back(item.exist ? 1 : 0);
+            put(dst, view_t(item.text));
+        }
+    }
+
+    /// deserialize 从序列化的数据恢复，值在这里重新转换一次
+    /// @param table 命令表，必须和序列化时的命令树一致
+    error_t deserialize(const view_t& data, const std::shared_ptr<const table_t>& table)
+    {
+        if (nullptr == table)
+        {
+            return make_error("error: cmd table is not frozen.");
+        }
+        parse_result_t ret;
+        ret.table_ = table;
+        reader_t in{ data.data(), data.data() + data.size() };
+        if (data.size() < magic().size() || memcmp(data.data(), magic().data(), magic().size()) != 0)
+        {
+            return make_error("bad parse result.");
+        }
+        in.pos += magic().size();
+
+        uint32_t count = 0;
+        if (!in.get(count) || count == 0)
+        {
+            return make_error("bad parse result.");
+        }
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint32_t node = 0;
+            if (!in.get(node) || node >= table->size()
+                || table->node(node).parent != (i == 0 ? invalid_id : ret.nodes_.back()))
+            {
+                return make_error("bad parse result.");
+            }
+            ret.nodes_.push_back(node);
+        }
+        if (!in.get(ret.tokens_) || !in.get(ret.args_) || !in.get(count))
+        {
+            return make_error("bad parse result.");
+        }
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint32_t depth = 0;
+            view_t name;
+            char exist = 0;
+            view_t text;
+            if (!in.get(depth) || !in.get(name) || !in.get(exist) || !in.get(text)
+                || depth >= ret.nodes_.size())
+            {
+                return make_error("bad parse result.");
+            }
+            auto key = "--" + name.str();
+            auto pflag = table->find_flag(ret.nodes_[depth], key.c_str(), key.size());
+            if (nullptr == pflag)
+            {
+                return make_error("undefined flag. name=" + name.str());
+            }
+            ret.values_.emplace_back();
+            auto& value = ret.values_.back();
+            value.id = table->id_of(pflag.get());
+            value.text = text.str();
+            value.exist = (exist != 0);
+            auto err = pflag->parse_value(value.value, view_t(value.text));
+            if (err != ok)
+            {
+                return err;
+            }
+        }
+        if (in.pos != in.end)
+        {
+            return make_error("bad parse result.");
+        }
+        *this = std::move(ret);
+        return ok;
+    }
+
+private:
+    friend class app_t;
+
+    // value_t 单个标记的值
+    struct value_t
+    {
+        uint32_t id{ invalid_id };
+        flag_t::holder_ptr value;
+        std::string text;
+        bool exist{ false };
+
+        // pending 惰性模式下没有转换，只在内部缓存的结果中出现
+        bool pending{ false };
+    };
+
+    // reader_t 读取序列化的数据
+    struct reader_t
+    {
+        const char* pos;
+        const char* end;
+
+        bool get(uint32_t& dst)
+        {
+            if (end - pos < 4)
+            {
+                return false;
+            }
+            auto p = reinterpret_cast<const unsigned char*>(pos);
+            dst = uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+            pos += 4;
+            return true;
+        }
+
+        bool get(char& dst)
+        {
+            if (pos == end)
+            {
+                return false;
+            }
+            dst = *pos++;
+            return true;
+        }
+
+        bool get(view_t& dst)
+        {
+            uint32_t len = 0;
+            if (!get(len) || uint32_t(end - pos) < len)
+            {
+                return false;
+            }
+            dst = view_t(pos, len);
+            pos += len;
+            return true;
+        }
+
+        bool get(argv_t& dst)
+        {
+            uint32_t count = 0;
+            if (!get(count) || uint32_t(end - pos) / 4 < count)
+            {
+                return false;
+            }
+            dst.clear();
+            dst.reserve(count);
+            for (uint32_t i = 0; i < count; i++)
+            {
+                view_t item;
+                if (!get(item))
+                {
+                    return false;
+                }
+                dst.push_back(item.str());
+            }
+            return true;
+        }
+    };
+
+    // magic 序列化数据的标识和版本
+    static const std::string& magic()
+    {
+        static const std::string ret("clp1");
+        return ret;
+    }
+
+    static void put(std::string& dst, uint32_t value)
+    {
+        char buf[4] = {
+            char(value & 0xff), char((value >> 8) & 0xff),
+            char((value >> 16) & 0xff), char((value >> 24) & 0xff)
+        };
+        dst.append(buf, 4);
+    }
+
+    static void put(std::string& dst, const view_t& value)
+    {
+        put(dst, static_cast<uint32_t>(value.size()));
+        dst.append(value.data(), value.size());
+    }
+
+    static void put(std::string& dst, const argv_t& value)
+    {
+        put(dst, static_cast<uint32_t>(value.size()));
+        for (auto& item : value)
+        {
+            put(dst, view_t(item));
+        }
+    }
+
+    // find 查找标记的值
+    const value_t* find(const pflag_t& flag) const
+    {
+        if (nullptr == flag || nullptr == table_)
+        {
+            return nullptr;
+        }
+        auto id = table_->id_of(flag.get());
+        for (auto& item : values_)
+        {
+            if (item.id == id)
+            {
+                return &item;
+            }
+        }
+        return nullptr;
+    }
+
+    // depth 标记在命令分支中第一个可见的深度
+    uint32_t depth(const pflag_t& flag) const
+    {
+        auto key = "--" + flag->name();
+        for (uint32_t i = 0; i < nodes_.size(); i++)
+        {
+            if (table_->find_flag(nodes_[i], key.c_str(), key.size()) == flag)
+            {
+                return i;
+            }
+        }
+        return 0;
+    }
+
+    // table_ 命令表
+    std::shared_ptr<const table_t> table_;
+
+    // nodes_ 命令分支的节点ID
+    std::vector<uint32_t> nodes_;
+
+    // tokens_ 原始参数
+    argv_t tokens_;
+
+    // args_ 命令参数
+    argv_t args_;
+
+    // values_ 标记的值，按设置的顺序
+    std::vector<value_t> values_;
+};
+
+// ----------------------------------------------------------------------------
+// parse_cache_t
+
+// parse_cache_t 解析结果的LRU缓存，以规范化的参数序列为键，可在多个线程中同时使用
+class parse_cache_t
+{
+public:
+    using presult_t = std::shared_ptr<const parse_result_t>;
+
+    explicit parse_cache_t(size_t capacity)
+        : capacity_(capacity)
+    {
+    }
+
+    parse_cache_t(const parse_cache_t& cpy) = delete;
+    parse_cache_t& operator=(const parse_cache_t& rhs) = delete;
+
+    // key 规范化的参数序列，参数之间以'\0'分隔
+    static void key(const views_t& tokens, std::string& dst)
+    {
+        size_t len = 0;
+        for (auto& item : tokens)
+        {
+            len += item.size() + 1;
+        }
+        dst.clear();
+        dst.reserve(len);
+        for (auto& item : tokens)
+        {
+            dst.append(item.data(), item.size()).push_back('\0');
+        }
+    }
+
+    // get 查找，命中时移到最近使用的位置
+    presult_t get(const std::string& key)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(key);
+        if (it == index_.end())
+        {
+            misses_++;
+            return nullptr;
+        }
+        hits_++;
+        items_.splice(items_.begin(), items_, it->second);
+        return it->second->second;
+    }
+
+    // put 添加，超过容量时淘汰最久未使用的结果
+    void put(const std::string& key, const presult_t& result)
+    {
+        if (capacity_ == 0)
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(key);
+        if (it != index_.end())
+        {
+            it->second->second = result;
+            items_.splice(items_.begin(), items_, it->second);
+            return;
+        }
+        items_.emplace_front(key, result);
+        index_[key] = items_.begin();
+        if (items_.size() > capacity_)
+        {
+            index_.erase(items_.back().first);
+            items_.pop_back();
+        }
+    }
+
+    // clear 清空
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        items_.clear();
+        index_.clear();
+    }
+
+    // size 缓存的结果数
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return items_.size();
+    }
+
+    // capacity 容量
+    size_t capacity() const
+    {
+        return capacity_;
+    }
+
+    // hits 命中次数
+    size_t hits() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return hits_;
+    }
+
+    // misses 未命中次数
+    size_t misses() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return misses_;
+    }
+
+private:
+    using item_t = std::pair<std::string, presult_t>;
+
+    size_t capacity_{ 0 };
+    mutable std::mutex mutex_;
+    std::list<item_t> items_;
+    std::unordered_map<std::string, std::list<item_t>::iterator> index_;
+    size_t hits_{ 0 };
+    size_t misses_{ 0 };
+};
+
+// ----------------------------------------------------------------------------
+// repl_t
+
+// repl_t 交互模式的行编辑器
+// 标准输入是终端时(POSIX)使用raw模式逐个字符读取，支持Tab补全和上下键浏览历史记录；
+// 否则逐行读取。
+class repl_t
+{
+public:
+    // complete_t 补全函数，返回行中最后一个参数的候选项
+    using complete_t = std::function<void(const std::string& line, std::vector<std::string>& dst)>;
+
+    repl_t(std::istream& in, std::ostream& out, const std::string& prompt, const complete_t& complete)
+        : in_(in)
+        , out_(out)
+        , prompt_(prompt)
+        , complete_(complete)
+    {
+#ifndef _WIN32
+        raw_ = (&in == &std::cin) && ::isatty(STDIN_FILENO) && ::tcgetattr(STDIN_FILENO, &origin_) == 0;
+#endif
+    }
+
+    // read 读取一行，输入结束时返回false
+    bool read(std::string& line)
+    {
+        line.clear();
+#ifndef _WIN32
+        if (raw_)
+        {
+            return read_raw(line);
+        }
+#endif
+        out_ << prompt_ << std::flush;
+        if (!std::getline(in_, line))
+        {
+            return false;
+        }
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        remember(line);
+        return true;
+    }
+
+    // history 历史记录
+    const std::vector<std::string>& history() const
+    {
+        return history_;
+    }
+
+private:
+    repl_t(const repl_t& cpy) = delete;
+    repl_t& operator=(const repl_t& rhs) = delete;
+
+    // remember 添加历史记录，忽略空行和与上一条相同的行
+    void remember(const std::string& line)
+    {
+        if (line.find_first_not_of(" \t") == std::string::npos)
+        {
+            return;
+        }
+        if (!history_.empty() && history_.back() == line)
+        {
+            return;
+        }
+        history_.push_back(line);
+    }
+
+#ifndef _WIN32
+    // raw_mode_t 在作用域内把终端设置为raw模式
+    class raw_mode_t
+    {
+    public:
+        explicit raw_mode_t(const struct termios& origin)
+            : origin_(origin)
+        {
+            struct termios raw = origin;
+            raw.c_lflag &= ~(ECHO | ICANON | ISIG | IEXTEN);
+            raw.c_iflag &= ~(IXON | ICRNL);
+            raw.c_cc[VMIN] = 1;
+            raw.c_cc[VTIME] = 0;
+            ::tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw);
+        }
+
+        ~raw_mode_t()
+        {
+            ::tcsetattr(STDIN_FILENO, TCSAFLUSH, &origin_);
+        }
+
+    private:
+        struct termios origin_;
+    };
+
+    // read_raw 在raw模式下读取一行
+    bool read_raw(std::string& line)
+    {
+        raw_mode_t mode(origin_);
+        size_t pos = history_.size(); // 浏览历史记录的位置
+        std::string draft;            // 浏览历史记录前输入的内容
+        redraw(line);
+
+        char c = 0;
+        while (::read(STDIN_FILENO, &c, 1) == 1)
+        {
+            switch (c)
+            {
+            case '\r':
+            case '\n':
+                out_ << "\r\n" << std::flush;
+                remember(line);
+                return true;
+            case 4: // Ctrl-D
+                if (line.empty())
+                {
+                    out_ << "\r\n" << std::flush;
+                    return false;
+                }
+                break;
+            case 3: // Ctrl-C
+                line.clear();
+                out_ << "^C\r\n";
+                pos = history_.size();
+                break;
+            case 21: // Ctrl-U
+                line.clear();
+                break;
+            case 127:
+            case 8: // Backspace
+                if (!line.empty())
+                {
+                    line.pop_back();
+                }
+                break;
+            case '\t':
+                complete(line);
+                break;
+            case 27: // ESC [ A/B 上下键
+            {
+                char seq[2] = { 0, 0 };
+                if (::read(STDIN_FILENO, &seq[0], 1) != 1 || ::read(STDIN_FILENO, &seq[1], 1) != 1)
+                {
+                    break;
+                }
+                if (seq[0] != '[')
+                {
+                    break;
+                }
+                if (seq[1] == 'A' && pos > 0)
+                {
+                    if (pos == history_.size())
+                    {
+                        draft = line;
+                    }
+                    line = history_[--pos];
+                }
+                else if (seq[1] == 'B' && pos < history_.size())
+                {
+                    line = (++pos == history_.size()) ? draft : history_[pos];
+                }
+                break;
+            }
+            default:
+                if (static_cast<unsigned char>(c) >= 32)
+                {
+                    line.push_back(c);
+                }
+                break;
+            }
+            redraw(line);
+        }
+        return false;
+    }
+
+    // redraw 重新输出当前行
+    void redraw(const std::string& line)
+    {
+        out_ << "\r\x1b[K" << prompt_ << line << std::flush;
+    }
+
+    // complete 补全最后一个参数
+    // 只有一个候选项时直接补全，有多个时补全公共前缀，无法继续补全时列出所有候选项
+    void complete(std::string& line)
+    {
+        std::vector<std::string> cands;
+        if (nullptr != complete_)
+        {
+            complete_(line, cands);
+        }
+        if (cands.empty())
+        {
+            out_ << '\a';
+            return;
+        }
+
+        size_t begin = line.find_last_of(" \t");
+        begin = (begin == std::string::npos) ? 0 : begin + 1;
+        size_t len = line.size() - begin;
+
+        if (cands.size() == 1)
+        {
+            line.replace(begin, len, cands[0] + " ");
+            return;
+        }
+
+        size_t common = cands[0].size();
+        for (auto& item : cands)
+        {
+            size_t i = 0;
+            while (i < common && i < item.size() && item[i] == cands[0][i])
+            {
+                i++;
+            }
+            common = i;
+        }
+        if (common > len)
+        {
+            line.replace(begin, len, cands[0].substr(0, common));
+            return;
+        }
+
+        out_ << "\r\n";
+        for (auto& item : cands)
+        {
+            out_ << item << "  ";
+        }
+        out_ << "\r\n";
+    }
+
+    // origin_ 终端原来的设置
+    struct termios origin_;
+#endif
+
+    // in_ out_ 输入和输出
+    std::istream& in_;
+    std::ostream& out_;
+
+    // prompt_ 提示符
+    std::string prompt_;
+
+    // complete_ 补全函数
+    complete_t complete_;
+
+    // raw_ 是否使用raw模式
+    bool raw_{ false };
+
+    // history_ 历史记录
+    std::vector<std::string> history_;
+};
+
+#ifdef __linux__
+// ----------------------------------------------------------------------------
+// server_t
+
+// server_t 本地的命令服务
+// 在Unix socket上监听，使用epoll在单个线程中处理所有连接。每个连接是一次调用：
+// 客户端发送参数，服务端执行后依次返回标准输出、标准错误和退出码，然后关闭连接。
+// 请求交给dispatch后不等待结果，执行完成时在任意线程中调用reply，响应由事件循环发送。
+//
+// 请求: [uint32 argc] ([uint32 len] [bytes]) * argc
+// 响应: ([char type] [uint32 len] [bytes]) * n，type为'o'标准输出，'e'标准错误，'x'退出码(int32)
+class server_t
+{
+public:
+    // reply_t 返回一次请求的结果，可以在任意线程中调用，只有第一次调用有效
+    using reply_t = std::function<void(int code, const std::string& out, const std::string& err)>;
+
+    // dispatch_t 执行一次请求，完成时调用reply；argv引用的请求数据在reply之前一直有效
+    using dispatch_t = std::function<void(const views_t& argv, const reply_t& reply)>;
+
+    // max_request 请求的最大长度
+    static constexpr const size_t max_request = 16 * 1024 * 1024;
+
+    server_t()
+    {
+    }
+
+    ~server_t()
+    {
+        close();
+    }
+
+    // listen 监听，残留的socket文件会被替换，还有服务在监听或者不是socket文件时失败
+    // socket先在同一目录下的私有临时目录(0700)中创建并设置为0600，再改名到path，
+    // 不修改进程的umask，也不留其他用户可以连接的窗口
+    error_t listen(const std::string& path)
+    {
+        close();
+
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        std::string dir = path + ".XXXXXX";
+        std::string temp = dir + "/s";
+        if (path.empty() || temp.size() >= sizeof(addr.sun_path))
+        {
+            return make_error("error: invalid socket path.", path);
+        }
+
+        listen_fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+        event_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        reply_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (listen_fd_ < 0 || epoll_fd_ < 0 || event_fd_ < 0 || reply_fd_ < 0)
+        {
+            close();
+            return make_error("error: can not create socket.", path);
+        }
+
+        // 只替换残留的套接字文件，不删除其他文件，也不抢占还在监听的服务
+        struct stat st;
+        if (::lstat(path.c_str(), &st) == 0)
+        {
+            if (!S_ISSOCK(st.st_mode))
+            {
+                close();
+                return make_error("error: socket path exists and is not a socket.", path);
+            }
+            if (alive(path))
+            {
+                close();
+                return make_error("error: socket is in use.", path);
+            }
+        }
+
+        if (nullptr == ::mkdtemp(&dir[0]))
+        {
+            close();
+            return make_error("error: can not create socket.", path);
+        }
+        temp = dir + "/s";
+        memcpy(addr.sun_path, temp.c_str(), temp.size());
+        auto bound = ::bind(listen_fd_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0
+            && ::chmod(temp.c_str(), 0600) == 0
+            && ::rename(temp.c_str(), path.c_str()) == 0;
+        if (!bound)
+        {
+            ::unlink(temp.c_str());
+        }
+        ::rmdir(dir.c_str());
+        if (!bound || ::listen(listen_fd_, SOMAXCONN) != 0)
+        {
+            close();
+            return make_error("error: can not listen.", path);
+        }
+        path_ = path;
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = listen_fd_;
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &ev);
+        ev.data.fd = event_fd_;
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, event_fd_, &ev);
+        ev.data.fd = reply_fd_;
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, reply_fd_, &ev);
+        outbox_ = std::make_shared<outbox_t>();
+        outbox_->fd = reply_fd_;
+        return ok;
+    }
+
+    // run 事件循环，直到stop()，停止后不再接受新的连接
+    error_t run(const dispatch_t& dispatch)
+    {
+        if (listen_fd_ < 0)
+        {
+            return make_error("error: server is not listening.");
+        }
+
+        struct epoll_event events[64];
+        for (;;)
+        {
+            int n = ::epoll_wait(epoll_fd_, events, 64, -1);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return make_error("error: epoll_wait failed.", path_);
+            }
+            for (int i = 0; i < n; i++)
+            {
+                int fd = events[i].data.fd;
+                if (fd == event_fd_)
+                {
+                    uint64_t value = 0;
+                    INNER_CLIPS_CLI_UNUSED auto ret = ::read(event_fd_, &value, sizeof(value));
+                    shutdown();
+                    return ok;
+                }
+                if (fd == reply_fd_)
+                {
+                    on_reply();
+                    continue;
+                }
+                if (fd == listen_fd_)
+                {
+                    on_accept();
+                    continue;
+                }
+                auto it = conns_.find(fd);
+                if (it == conns_.end())
+                {
+                    continue;
+                }
+                if ((events[i].events & EPOLLIN) != 0)
+                {
+                    on_read(*it->second, dispatch);
+                }
+                else if ((events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) != 0)
+                {
+                    on_write(*it->second);
+                }
+            }
+        }
+    }
+
+    // stop 停止事件循环，可以在其他线程中调用
+    void stop()
+    {
+        if (event_fd_ >= 0)
+        {
+            uint64_t value = 1;
+            INNER_CLIPS_CLI_UNUSED auto ret = ::write(event_fd_, &value, sizeof(value));
+        }
+    }
+
+    // close 关闭所有连接并删除socket文件
+    void close()
+    {
+        shutdown();
+        if (nullptr != outbox_)
+        {
+            // 还在执行的请求完成时丢弃结果
+            std::lock_guard<std::mutex> lock(outbox_->mutex);
+            outbox_->fd = -1;
+            outbox_->frames.clear();
+        }
+        outbox_.reset();
+        if (epoll_fd_ >= 0)
+        {
+            ::close(epoll_fd_);
+        }
+        if (event_fd_ >= 0)
+        {
+            ::close(event_fd_);
+        }
+        if (reply_fd_ >= 0)
+        {
+            ::close(reply_fd_);
+        }
+        epoll_fd_ = event_fd_ = reply_fd_ = -1;
+    }
+
+private:
+    server_t(const server_t& cpy) = delete;
+    server_t& operator=(const server_t& rhs) = delete;
+
+    // shutdown 关闭监听和所有连接，并删除socket文件
+    void shutdown()
+    {
+        for (auto& item : conns_)
+        {
+            ::close(item.first);
+        }
+        conns_.clear();
+        if (listen_fd_ >= 0)
+        {
+            ::close(listen_fd_);
+            ::unlink(path_.c_str());
+        }
+        listen_fd_ = -1;
+        path_.clear();
+    }
+
+    // alive 是否有服务在path上监听
+    static bool alive(const std::string& path)
+    {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path, path.c_str(), path.size());
+        int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            return false;
+        }
+        auto ret = ::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+        ::close(fd);
+        return ret == 0;
+    }
+
+    // conn_t 连接
+    struct conn_t
+    {
+        int fd{ -1 };
+        uint64_t id{ 0 }; // 区分复用了同一个fd的连接
+        std::string in;
+        std::string out;
+        size_t sent{ 0 };
+    };
+
+    // on_accept 接受所有等待的连接
+    void on_accept()
+    {
+        for (;;)
+        {
+            int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0)
+            {
+                return;
+            }
+            struct epoll_event ev;
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLIN;
+            ev.data.fd = fd;
+            ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+            std::unique_ptr<conn_t> conn(new conn_t());
+            conn->fd = fd;
+            conn->id = ++serial_;
+            conns_[fd] = std::move(conn);
+        }
+    }
+
+    // on_read 读取请求，完整时交给dispatch执行
+    void on_read(conn_t& conn, const dispatch_t& dispatch)
+    {
+        char buf[4096];
+        bool eof = false;
+        for (;;)
+        {
+            auto len = ::read(conn.fd, buf, sizeof(buf));
+            if (len > 0)
+            {
+                conn.in.append(buf, static_cast<size_t>(len));
+                if (conn.in.size() > max_request)
+                {
+                    drop(conn);
+                    return;
+                }
+                continue;
+            }
+            if (len == 0)
+            {
+                eof = true;
+                break;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                break;
+            }
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            drop(conn);
+            return;
+        }
+
+        views_t argv;
+        if (!unpack(conn.in, argv))
+        {
+            if (eof)
+            {
+                drop(conn); // 请求不完整时对端已关闭
+            }
+            return;
+        }
+
+        // 请求完整后不再读取，只关注连接关闭；请求数据交给reply持有，连接先关闭时也有效
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.data.fd = conn.fd;
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, conn.fd, &ev);
+        auto data = std::make_shared<std::string>(std::move(conn.in));
+        unpack(*data, argv);
+
+        auto outbox = outbox_;
+        auto fd = conn.fd;
+        auto id = conn.id;
+        auto once = std::make_shared<std::atomic<bool>>(false);
+        reply_t reply = [outbox, data, fd, id, once](int code, const std::string& out, const std::string& err)
+        {
+            if (once->exchange(true))
+            {
+                return;
+            }
+            frame_t frame;
+            frame.fd = fd;
+            frame.id = id;
+            pack(frame.data, 'o', out);
+            pack(frame.data, 'e', err);
+            int32_t code32 = static_cast<int32_t>(code);
+            pack(frame.data, 'x', std::string(reinterpret_cast<const char*>(&code32), sizeof(code32)));
+
+            std::lock_guard<std::mutex> lock(outbox->mutex);
+            if (outbox->fd < 0)
+            {
+                return; // 服务已经关闭
+            }
+            outbox->frames.push_back(std::move(frame));
+            uint64_t value = 1;
+            INNER_CLIPS_CLI_UNUSED auto ret = ::write(outbox->fd, &value, sizeof(value));
+        };
+        dispatch(argv, reply);
+    }
+
+    // on_reply 取出执行完成的响应并开始发送，连接已经关闭时丢弃
+    void on_reply()
+    {
+        uint64_t value = 0;
+        INNER_CLIPS_CLI_UNUSED auto ret = ::read(reply_fd_, &value, sizeof(value));
+        std::vector<frame_t> frames;
+        {
+            std::lock_guard<std::mutex> lock(outbox_->mutex);
+            frames.swap(outbox_->frames);
+        }
+        for (auto& item : frames)
+        {
+            auto it = conns_.find(item.fd);
+            if (it == conns_.end() || it->second->id != item.id)
+            {
+                continue;
+            }
+            auto& conn = *it->second;
+            conn.out = std::move(item.data);
+
+            struct epoll_event ev;
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLOUT;
+            ev.data.fd = conn.fd;
+            ::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, conn.fd, &ev);
+            on_write(conn);
+        }
+    }
+
+    // on_write 发送结果，发送完成后关闭连接
+    void on_write(conn_t& conn)
+    {
+        while (conn.sent < conn.out.size())
+        {
+            auto len = ::send(conn.fd, conn.out.data() + conn.sent, conn.out.size() - conn.sent, MSG_NOSIGNAL);
+            if (len > 0)
+            {
+                conn.sent += static_cast<size_t>(len);
+                continue;
+            }
+            if (len < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                return;
+            }
+            break;
+        }
+        drop(conn);
+    }
+
+    // drop 关闭连接
+    void drop(conn_t& conn)
+    {
+        int fd = conn.fd;
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        conns_.erase(fd);
+    }
+
+    // unpack 解析请求，参数为引用请求内存的视图
+    static bool unpack(const std::string& in, views_t& argv)
+    {
+        argv.clear();
+        size_t pos = 0;
+        uint32_t argc = 0;
+        if (!read_u32(in, pos, argc))
+        {
+            return false;
+        }
+        for (uint32_t i = 0; i < argc; i++)
+        {
+            uint32_t len = 0;
+            if (!read_u32(in, pos, len) || in.size() - pos < len)
+            {
+                return false;
+            }
+            argv.emplace_back(in.data() + pos, len);
+            pos += len;
+        }
+        return true;
+    }
+
+    // read_u32 读取uint32
+    static bool read_u32(const std::string& in, size_t& pos, uint32_t& value)
+    {
+        if (in.size() - pos < sizeof(value))
+        {
+            return false;
+        }
+        memcpy(&value, in.data() + pos, sizeof(value));
+        pos += sizeof(value);
+        return true;
+    }
+
+    // pack 添加响应帧，空的输出不发送
+    static void pack(std::string& out, char type, const std::string& data)
+    {
+        if (data.empty() && type != 'x')
+        {
+            return;
+        }
+        uint32_t len = static_cast<uint32_t>(data.size());
+        out.push_back(type);
+        out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+        out.append(data);
+    }
+
+    // frame_t 一次请求的全部响应帧
+    struct frame_t
+    {
+        int fd{ -1 };
+        uint64_t id{ 0 };
+        std::string data;
+    };
+
+    // outbox_t 执行完成的响应，执行线程写入后通知事件循环
+    struct outbox_t
+    {
+        std::mutex mutex;
+        int fd{ -1 }; // 通知用的eventfd，服务关闭后为-1
+        std::vector<frame_t> frames;
+    };
+
+    // path_ socket文件
+    std::string path_;
+
+    // listen_fd_ epoll_fd_ event_fd_ reply_fd_ 监听、epoll、停止通知和响应通知
+    int listen_fd_{ -1 };
+    int epoll_fd_{ -1 };
+    int event_fd_{ -1 };
+    int reply_fd_{ -1 };
+
+    // outbox_ 执行完成的响应
+    std::shared_ptr<outbox_t> outbox_;
+
+    // serial_ 连接序号
+    uint64_t serial_{ 0 };
+
+    // conns_ 连接
+    std::unordered_map<int, std::unique_ptr<conn_t>> conns_;
+};
+
+/// forward 把参数转发给本地的命令服务执行
+/// 只转发参数，不需要初始化命令树，可以作为很小的客户端程序。
+/// @return int 命令的退出码，连接失败时为-1，调用方可以改为在本地执行
+inline int forward(const std::string& path, const views_t& argv, std::ostream& out, std::ostream& err)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path))
+    {
+        return -1;
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size());
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    if (::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+
+    std::string req;
+    uint32_t argc = static_cast<uint32_t>(argv.size());
+    req.append(reinterpret_cast<const char*>(&argc), sizeof(argc));
+    for (auto& item : argv)
+    {
+        uint32_t len = static_cast<uint32_t>(item.size());
+        req.append(reinterpret_cast<const char*>(&len), sizeof(len));
+        req.append(item.data(), item.size());
+    }
+    size_t sent = 0;
+    while (sent < req.size())
+    {
+        auto len = ::send(fd, req.data() + sent, req.size() - sent, MSG_NOSIGNAL);
+        if (len < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (len <= 0)
+        {
+            ::close(fd);
+            return -1;
+        }
+        sent += static_cast<size_t>(len);
+    }
+
+    // 响应帧在到达时就输出
+    int code = -1;
+    std::string buf;
+    char tmp[4096];
+    for (;;)
+    {
+        auto len = ::read(fd, tmp, sizeof(tmp));
+        if (len < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (len <= 0)
+        {
+            break;
+        }
+        buf.append(tmp, static_cast<size_t>(len));
+
+        size_t pos = 0;
+        while (buf.size() - pos >= 1 + sizeof(uint32_t))
+        {
+            uint32_t size = 0;
+            memcpy(&size, buf.data() + pos + 1, sizeof(size));
+            if (buf.size() - pos - 1 - sizeof(size) < size)
+            {
+                break;
+            }
+            const char* data = buf.data() + pos + 1 + sizeof(size);
+            switch (buf[pos])
+            {
+            case 'o':
+                out.write(data, size);
+                break;
+            case 'e':
+                err.write(data, size);
+                break;
+            case 'x':
+                if (size == sizeof(int32_t))
+                {
+                    int32_t code32 = 0;
+                    memcpy(&code32, data, sizeof(code32));
+                    code = code32;
+                }
+                break;
+            default:
+                break;
+            }
+            pos += 1 + sizeof(size) + size;
+        }
+        buf.erase(0, pos);
+    }
+    ::close(fd);
+    out.flush();
+    err.flush();
+    return code;
+}
+
+/// forward 把argv[1:]转发给本地的命令服务执行，输出写入std::cout和std::cerr
+inline int forward(const std::string& path, int argc, char* argv[])
+{
+    views_t views;
+    for (int i = 1; i < argc; i++)
+    {
+        views.emplace_back(argv[i]);
+    }
+    return forward(path, views, std::cout, std::cerr);
+}
+#endif
+
+// ----------------------------------------------------------------------------
+// app_t
+
+// app_t 应用，持有命令树，负责解析和执行
+// 初始化(CLIPS_INIT和手动绑定)完成后命令树只读，每次exec都在独立的解析上下文中进行，
+// 所以同一个app_t可以在多个线程中同时exec。
+class app_t
+{
+public:
+    app_t()
+        : root_(new cmd_t())
+    {
+        root_->flag<bool>("help", "h", false, "help", true);
+    }
+
+    virtual ~app_t()
+    {
+    }
+
+    // path 模块路径
+    const std::string& path() const
+    {
+        return path_;
+    }
+
+    // name 应用名称
+    void name(const std::string& name)
+    {
+        name_ = utils::filename(name);
+    }
+
+    // name 应用名称
+    const std::string& name() const
+    {
+        return name_;
+    }
+
+    // desc 应用描述
+    void desc(const std::string& desc)
+    {
+        desc_ = desc;
+    }
+
+    // desc 应用描述
+    const std::string& desc() const
+    {
+        return desc_;
+    }
+
+    // version 版本号
+    void version(const std::string& version)
+    {
+        version_ = version;
+    }
+
+    // version 版本号
+    const std::string& version() const
+    {
+        return version_;
+    }
+
+    // argv 返回所有原始参数
+    // 命令执行期间返回本次执行的原始参数
+    const argv_t& argv(void)
+    {
+        auto ctx = context_t::current();
+        if (nullptr != ctx)
+        {
+            return ctx->argv();
+        }
+        std::lock_guard<std::mutex> lock(init_mutex_);
+        if (!argv_ready_)
+        {
+            argv_.clear();
+            for (int i = 1; i < argc_; i++)
+            {
+                argv_.push_back(argvp_[i]);
+            }
+            argv_ready_ = true;
+        }
+        return argv_;
+    }
+
+    // root 根命令
+    const pcmd_t& root() const
+    {
+        return root_;
+    }
+
+    // bind 绑定根函数
+    error_t bind(func_t func)
+    {
+        return root_->bind(func);
+    }
+
+    // bind 绑定子指令
+    error_t bind(pcmd_t& ptr)
+    {
+        return root_->bind(ptr);
+    }
+
+    // bind 绑定类型化的根函数
+    template<class T>
+    error_t bind(const schema_t<T>& schema, typename schema_t<T>::func_t func)
+    {
+        return root_->bind(schema, func);
+    }
+
+    // flag 标记
+    template <class T,
+        class = typename std::enable_if<!std::is_pointer<T>::value
+        && !std::is_const<T>::value
+        && !std::is_reference<T>::value, T>::type>
+        flag_ref<T> flag(const std::string& name, const std::string& fast, T default_value,
+            const std::string& desc, bool extend = false)
+    {
+        return root_->flag(name, fast, default_value, desc, extend);
+    }
+
+    // flag 标记
+    template <class T,
+        class = typename std::enable_if<!std::is_pointer<T>::value
+        && !std::is_const<T>::value
+        && !std::is_reference<T>::value
+        && !std::is_same<T, double>::value
+        && !std::is_same<T, float>::value
+        && !std::is_same<T, bool>::value, T>::type>
+        flag_ref<T> flag(const std::string& name, const std::string& fast, T default_value,
+            const std::vector<T>& options, const std::string& desc, bool extend = false)
+    {
+        return root_->flag(name, fast, default_value, options, desc, extend);
+    }
+
+    // pflag 标记
+    template <class T,
+        class = typename std::enable_if<!std::is_pointer<T>::value
+        && !std::is_const<T>::value
+        && !std::is_reference<T>::value, T>::type>
+        error_t pflag(T* ptr, const std::string& name, const std::string& fast, T default_value,
+            const std::string& desc, bool extend = false)
+    {
+        return root_->pflag(ptr, name, fast, default_value, desc, extend);
+    }
+
+    // pflag 标记
+    template <class T,
+        class = typename std::enable_if<!std::is_pointer<T>::value
+        && !std::is_const<T>::value
+        && !std::is_reference<T>::value
+        && !std::is_same<T, double>::value
+        && !std::is_same<T, float>::value
+        && !std::is_same<T, bool>::value, T>::type>
+        error_t pflag(T* ptr, const std::string& name, const std::string& fast, T default_value,
+            const std::vector<T>& options, const std::string& desc, bool extend = false)
+    {
+        return root_->pflag(ptr, name, fast, default_value, options, desc, extend);
+    }
+
+    // _bind_init_func 绑定初始化函数
+    bool _bind_init_func(_init_func_t func, const char* file, int line)
+    {
+        _inits_.push_back(std::make_tuple(func, file, line));
+        return false; // 返回值只是为了初始化一个全局静态变量，没有其他作用
+    }
+
+    // init 执行初始化函数并编译命令树，只会执行一次
+    error_t init()
+    {
+        if (inited_.load(std::memory_order_acquire))
+        {
+            return init_error_;
+        }
+        std::lock_guard<std::mutex> lock(init_mutex_);
+        if (!inited_.load(std::memory_order_relaxed))
+        {
+            init_error_ = bind_init();
+            if (init_error_ == ok)
+            {
+                init_error_ = freeze();
+            }
+            inited_.store(true, std::memory_order_release);
+        }
+        return init_error_;
+    }
+
+    // freeze 编译命令树
+    // 将命令树编译为连续存储的命令表，之后的解析都基于命令表进行，
+    // 重复或冲突的定义会在这里一次性检查出来。
+    // 首次exec时会自动执行，初始化之后修改了命令树需要重新调用。
+    error_t freeze()
+    {
+        auto table = std::make_shared<table_t>();
+        auto err = table->build(root_, name_);
+        if (err != ok)
+        {
+            return err;
+        }
+        auto sources = std::make_shared<sources_t>();
+        err = load_sources(*table, *sources);
+        if (err != ok)
+        {
+            return err;
+        }
+        std::atomic_store(&table_, std::shared_ptr<const table_t>(table));
+        std::atomic_store(&sources_, std::shared_ptr<const sources_t>(sources));
+        return ok;
+    }
+
+    // table 编译后的命令表，freeze之前为nullptr
+    std::shared_ptr<const table_t> table() const
+    {
+        return std::atomic_load(&table_);
+    }
+
+    // exec 执行命令
+    error_t exec(const std::string& argv)
+    {
+        auto ret = init();
+        if (ret != ok)
+        {
+            return ret;
+        }
+
+        context_t ctx;
+        ctx.line_ = argv;
+        ret = tokenize(ctx, ctx.line_);
+        if (ret != ok)
+        {
+            return ret;
+        }
+        return parse(ctx);
+    }
+
+    // exec 执行命令
+    // 参数只以视图的形式引用argv，不复制
+    error_t exec(int argc, char* argv[])
+    {
+        {
+            std::lock_guard<std::mutex> lock(init_mutex_);
+            path_ = argv[0];
+            if (name_.empty())
+            {
+                name_ = utils::filename(argv[0]);
+            }
+            argc_ = argc;
+            argvp_ = argv;
+            argv_ready_ = false;
+        }
+
+        auto ret = init();
+        if (ret != ok)
+        {
+            return ret;
+        }
+
+        context_t ctx;
+        ctx.tokens_.reserve(argc > 1 ? argc - 1 : 0);
+        for (int i = 1; i < argc; i++)
+        {
+            ctx.tokens_.emplace_back(argv[i]);
+        }
+        return parse(ctx);
+    }
+
+    // parse 只解析，不执行，结果可以缓存、序列化，或者之后再执行
+    error_t parse(const std::string& argv, parse_result_t& dst)
+    {
+        auto ret = init();
+        if (ret != ok)
+        {
+            return ret;
+        }
+
+        context_t ctx;
+        ctx.line_ = argv;
+        ret = tokenize(ctx, ctx.line_);
+        if (ret == ok)
+        {
+            ret = resolve(ctx);
+        }
+        if (ret == ok)
+        {
+            ret = ctx.settle(); // 只解析时总是校验，结果中的值都已经转换
+        }
+        if (ret != ok)
+        {
+            return ret;
+        }
+        snapshot(ctx, dst);
+        return ok;
+    }
+
+    // exec 执行解析结果
+    // 结果来自其他命令表(重新freeze过)时返回错误
+    error_t exec(const parse_result_t& result)
+    {
+        auto ret = init();
+        if (ret != ok)
+        {
+            return ret;
+        }
+        if (nullptr == result.table_ || result.table_ != table())
+        {
+            return make_error("parse result is stale.");
+        }
+
+        context_t ctx;
+        restore(ctx, result);
+        bool handled = false;
+        ret = builtin(ctx, handled);
+        if (handled)
+        {
+            return ret;
+        }
+        return invoke(ctx);
+    }
+
+    // builtins 在根命令上添加内置标记，可以多次调用，已经添加的不会重复添加
+    // 与已有的根标记同名时返回错误；已经freeze时重新freeze
+    error_t builtins(builtin_t which)
+    {
+        // 先检查名称，失败时不留下部分添加的标记
+        std::vector<std::string> names;
+        if ((which & builtin_t::batch) && nullptr == batch_)
+        {
+            names.insert(names.end(), { "batch", "keep-going", "jobs", "independent" });
+        }
+#ifdef __linux__
+        if ((which & builtin_t::serve) && nullptr == serve_)
+        {
+            names.push_back("serve");
+        }
+#endif
+        if ((which & builtin_t::completion) && nullptr == completion_)
+        {
+            names.push_back("completion");
+        }
+        for (auto& name : names)
+        {
+            if (root_->flags().count("--" + name) != 0)
+            {
+                return make_error("error: double defined flag. name=" + name);
+            }
+        }
+
+        if ((which & builtin_t::batch) && nullptr == batch_)
+        {
+            batch_ = root_->flag<std::string>("batch", "", "", "run command lines from a file, - for stdin").flag();
+            keep_going_ = root_->flag<bool>("keep-going", "", false, "continue the batch after a failed line").flag();
+            jobs_ = root_->flag<uint32_t>("jobs", "", 1, "batch threads, 0 for all cores").flag();
+            independent_ = root_->flag<bool>("independent", "", false, "all batch lines are independent").flag();
+        }
+#ifdef __linux__
+        if ((which & builtin_t::serve) && nullptr == serve_)
+        {
+            serve_ = root_->flag<std::string>("serve", "", "", "serve forwarded commands on a unix socket").flag();
+        }
+#endif
+        if ((which & builtin_t::completion) && nullptr == completion_)
+        {
+            completion_ = root_->flag<std::string>("completion", "", "",
+                "print a static completion script, bash or zsh").flag();
+        }
+        if (nullptr != table())
+        {
+            return freeze();
+        }
+        return ok;
+    }
+
+    // abbrev 是否接受无歧义的前缀缩写，子命令和长名称标记都有效，默认不接受
+    // 例如 app rem set-u 可以匹配 app remote set-url
+    void abbrev(bool abbrev)
+    {
+        abbrev_.store(abbrev, std::memory_order_release);
+        auto cache = this->cache();
+        if (nullptr != cache)
+        {
+            cache->clear(); // 缓存的结果依赖这个选项
+        }
+    }
+
+    // abbrev 是否接受无歧义的前缀缩写
+    bool abbrev() const
+    {
+        return abbrev_.load(std::memory_order_acquire);
+    }
+
+    // lazy 惰性转换，解析时只记录标记的文本，第一次cast时才转换和校验，默认关闭
+    // 转换失败时cast抛出flag_cast_exception，exec返回错误；需要提前报告错误的命令使用cmd_t::eager
+    void lazy(bool lazy)
+    {
+        lazy_.store(lazy, std::memory_order_release);
+    }
+
+    // lazy 是否惰性转换
+    bool lazy() const
+    {
+        return lazy_.load(std::memory_order_acquire);
+    }
+
+    // cache 打开解析结果缓存，exec、批处理、交互模式和命令服务中重复的命令行
+    // 直接使用缓存的结果；capacity为0时关闭
+    void cache(size_t capacity)
+    {
+        std::shared_ptr<parse_cache_t> cache;
+        if (capacity != 0)
+        {
+            cache = std::make_shared<parse_cache_t>(capacity);
+        }
+        std::atomic_store(&cache_, cache);
+    }
+
+    // cache 解析结果缓存，未打开时为nullptr
+    std::shared_ptr<parse_cache_t> cache() const
+    {
+        return std::atomic_load(&cache_);
+    }
+
+    // config 配置文件，优先级在默认值之后、环境变量之前，空字符串时关闭
+    // 格式：#或;开始的注释行，[cmd sub]命令段，name = value标记的值
+    // freeze时按命令表解析并检查，已经freeze过时立即重新加载
+    error_t config(const std::string& path)
+    {
+        {
+            std::lock_guard<std::mutex> lock(sources_mutex_);
+            config_ = path;
+        }
+        return reload();
+    }
+
+    // env 环境变量的前缀，优先级在配置文件之后、命令参数之前，空字符串时关闭
+    // PREFIX_NAME 对应名称为name的标记，名称转为大写，-转为_
+    error_t env(const std::string& prefix)
+    {
+        {
+            std::lock_guard<std::mutex> lock(sources_mutex_);
+            env_ = prefix;
+        }
+        return reload();
+    }
+
+    // batch 批处理，逐行执行文件中的命令
+    // 文件映射到内存，每行的参数只以视图的形式引用，不复制。
+    // 空行和以#开始的行会被忽略。
+    // @param path std::string 文件路径，"-"为标准输入
+    // @param policy batch_policy_t 出错时的策略
+    // @param report batch_report_t 每行的执行结果，可以为nullptr
+    // @return error_t 全部成功时为ok；在第一个错误停止时为该行的错误，否则为失败的行数
+    error_t batch(const std::string& path, batch_policy_t policy = batch_policy_t::stop,
+        const batch_report_t& report = nullptr)
+    {
+        batch_options_t options;
+        options.policy = policy;
+        options.report = report;
+        return batch(path, options);
+    }
+
+    // batch 批处理，逐行执行输入流中的命令
+    error_t batch(std::istream& is, batch_policy_t policy = batch_policy_t::stop,
+        const batch_report_t& report = nullptr)
+    {
+        batch_options_t options;
+        options.policy = policy;
+        options.report = report;
+        return batch(is, options);
+    }
+
+    // batch 批处理，可以并行执行
+    // 并行执行时每行的输出缓存在各自的解析上下文中(clips::out())，按输入的顺序输出，
+    // 每行的执行结果也按输入的顺序报告。
+    error_t batch(const std::string& path, const batch_options_t& options)
+    {
+        auto ret = init();
+        if (ret != ok)
+        {
+            return ret;
+        }
+        if (path == "-")
+        {
+            return run_batch(std::cin, path, options);
+        }
+        return run_batch(path, options);
+    }
+
+    // batch 批处理，可以并行执行
+    error_t batch(std::istream& is, const batch_options_t& options)
+    {
+        auto ret = init();
+        if (ret != ok)
+        {
+            return ret;
+        }
+        return run_batch(is, "-", options);
+    }
+
+    // repl 交互模式
+    // 逐行读取命令并执行，命令树只初始化一次，每行都在独立的解析上下文中解析，互不影响。
+    // 输入exit或quit，或者在空行上按Ctrl-D时退出；出错时输出错误并继续。
+    // 终端中支持Tab补全(子命令和标记名称来自命令表)和上下键浏览历史记录。
+    error_t repl(std::istream& in = std::cin, std::ostream& out = std::cout)
+    {
+        auto ret = init();
+        if (ret != ok)
+        {
+            return ret;
+        }
+
+        repl_t reader(in, out, name_ + "> ", [this](const std::string& line, std::vector<std::string>& dst)
+        {
+            complete(line, dst);
+        });
+        auto table = this->table();
+
+        std::string line;
+        while (reader.read(line))
+        {
+            context_t ctx;
+            ctx.line_ = line;
+            ctx.out_ = &out;
+            auto err = tokenize(ctx, ctx.line_);
+            if (err != ok)
+            {
+                out << err << std::endl;
+                continue;
+            }
+            if (ctx.tokens_.size() == 0)
+            {
+                continue;
+            }
+            auto& first = ctx.tokens_[0];
+            if ((first == "exit" || first == "quit") && ctx.tokens_.size() == 1
+                && table->find_sub(0, first.data(), first.size()) == invalid_id)
+            {
+                break;
+            }
+            err = parse(ctx);
+            if (err != ok)
+            {
+                out << err << std::endl;
+            }
+        }
+        return ok;
+    }
+
+#ifdef __linux__
+    // serve 本地命令服务，在Unix socket上执行转发的命令，直到出错或者server.stop()
+    // 命令树只初始化一次，每次请求都在独立的解析上下文中解析，同步的命令函数交给执行器执行，
+    // 没有设置执行器时使用临时的线程池，事件循环不等待命令执行。
+    // 只有命令的输出(clips::out())和错误信息返回给客户端，写入std::cout的内容仍然输出到服务端。
+    error_t serve(server_t& server)
+    {
+        auto ret = init();
+        if (ret != ok)
+        {
+            return ret;
+        }
+        return run_server(server);
+    }
+
+    // serve 本地命令服务
+    // @param path std::string socket文件路径
+    error_t serve(const std::string& path)
+    {
+        auto ret = init();
+        if (ret != ok)
+        {
+            return ret;
+        }
+        server_t server;
+        ret = server.listen(path);
+        if (ret != ok)
+        {
+            return ret;
+        }
+        return serve(server);
+    }
+#endif
+
+    // dispatch 执行一次转发的命令，返回退出码
+    // @param argv views_t 参数，不包括应用名称
+    int dispatch(const views_t& argv, std::ostream& out, std::ostream& err) const
+    {
+        context_t ctx;
+        ctx.tokens_ = argv;
+        ctx.out_ = &out;
+        auto ret = parse(ctx);
+        if (ret != ok)
+        {
+            err << ret << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // executor 设置执行器，exec_async时同步的命令函数交给执行器执行
+    // nullptr时在调用exec_async的线程中执行；执行器的生命周期由调用方保证
+    void executor(executor_t* executor)
+    {
+        executor_.store(executor, std::memory_order_release);
+    }
+
+    // executor 执行器
+    executor_t* executor() const
+    {
+        return executor_.load(std::memory_order_acquire);
+    }
+
+    // exec_async 异步执行命令，完成时调用done
+    // 解析在调用线程中完成；异步函数直接在调用线程中启动，同步函数交给执行器执行，
+    // 所以一个调度线程可以同时有大量执行中的命令。
+    void exec_async(const std::string& argv, const done_t& done)
+    {
+        auto ret = init();
+        if (ret != ok)
+        {
+            done(ret);
+            return;
+        }
+
+        std::shared_ptr<context_t> ctx(new context_t());
+        ctx->line_ = argv;
+        ret = tokenize(*ctx, ctx->line_);
+        if (ret != ok)
+        {
+            done(ret);
+            return;
+        }
+        parse_async(ctx, done, executor());
+    }
+
+    // exec_async 异步执行命令，返回std::future
+    std::future<error_t> exec_async(const std::string& argv)
+    {
+        auto promise = std::make_shared<std::promise<error_t>>();
+        auto future = promise->get_future();
+        exec_async(argv, [promise](const error_t& err)
+        {
+            promise->set_value(err);
+        });
+        return future;
+    }
+
+    // complete 补全命令行的最后一个参数
+    // 最后一个参数以-开始时补全标记，否则补全子命令；命令参数开始后不再补全子命令
+    // 和执行时一样按shell的规则切分，引号没有闭合时不补全
+    void complete(const std::string& line, std::vector<std::string>& dst) const
+    {
+        dst.clear();
+        context_t ctx;
+        if (tokenize(ctx, line) != ok)
+        {
+            return;
+        }
+        auto& words = ctx.tokens_;
+        if (words.empty() || line.empty() || utils::is_blank(line.back()))
+        {
+            words.push_back(view_t());
+        }
+        complete(words, dst);
+    }
+
+    // complete 补全最后一个词，words不包括应用名称
+    // 需要值的标记之后补全它的可选项，--flag=之后同样补全可选项
+    void complete(const views_t& words, std::vector<std::string>& dst) const
+    {
+        dst.clear();
+        auto table = this->table();
+        if (nullptr == table || words.empty())
+        {
+            return;
+        }
+        auto abbrev = this->abbrev();
+        auto& prefix = words.back();
+
+        uint32_t node = 0;
+        bool args = false;
+        pflag_t pending; // 等待值的标记
+        for (size_t i = 0; i + 1 < words.size(); i++)
+        {
+            auto& item = words[i];
+            if (nullptr != pending)
+            {
+                pending = nullptr;
+                continue;
+            }
+            if (item.starts_with('-') && item.size() > 1)
+            {
+                if (item.find('=') == view_t::npos)
+                {
+                    auto pflag = table->find_flag(node, item.data(), item.size(), abbrev);
+                    if (nullptr != pflag && !pflag->castable<bool>())
+                    {
+                        pending = pflag;
+                    }
+                }
+                continue;
+            }
+            if (args)
+            {
+                continue;
+            }
+            auto sub = table->find_sub(node, item.data(), item.size(), abbrev);
+            if (sub == invalid_id)
+            {
+                args = true;
+                continue;
+            }
+            node = sub;
+        }
+
+        if (nullptr != pending)
+        {
+            table->options(table->id_of(pending.get()), prefix, dst);
+            return;
+        }
+        auto equal = prefix.find('=');
+        if (prefix.starts_with('-') && equal != view_t::npos)
+        {
+            auto name = prefix.substr(0, equal);
+            auto pflag = table->find_flag(node, name.data(), name.size(), abbrev);
+            if (nullptr != pflag)
+            {
+                table->options(table->id_of(pflag.get()), prefix.substr(equal + 1), dst);
+                for (auto& item : dst)
+                {
+                    item = name.str() + "=" + item;
+                }
+            }
+            return;
+        }
+        if (args && !prefix.starts_with('-'))
+        {
+            return;
+        }
+        table->complete(node, prefix, dst);
+    }
+
+    // completion 生成静态的补全脚本，按TAB时不需要运行应用
+    // @param shell std::string "bash" 或 "zsh"
+    error_t completion(const std::string& shell, std::ostream& os)
+    {
+        auto ret = init();
+        if (ret != ok)
+        {
+            return ret;
+        }
+        return write_completion(shell, os);
+    }
+
+private:
+    app_t(const app_t& cpy) = delete;
+    app_t& operator=(const app_t& rhs) = delete;
+
+    // sources_t 标记的分层来源，freeze时按命令表解析，每个键只查找一次
+    struct sources_t
+    {
+        // entry_t 标记ID、值的文本和加载时转换好的值
+        // text引用映射的配置文件或held，value不关联绑定的变量
+        struct entry_t
+        {
+            uint32_t id{ invalid_id };
+            view_t text;
+            flag_t::holder_ptr value;
+        };
+
+        // file 映射的配置文件
+        mapped_file_t file;
+
+        // held 环境变量的值
+        std::list<std::string> held;
+
+        // entries 按优先级从低到高：配置文件，环境变量
+        std::vector<entry_t> entries;
+
+        // visible 每个命令节点可见的entries下标，保持优先级顺序
+        std::vector<std::vector<uint32_t>> visible;
+    };
+
+    // reload 已经freeze过时重新加载标记来源
+    error_t reload()
+    {
+        auto table = this->table();
+        if (nullptr == table)
+        {
+            return ok;
+        }
+        auto sources = std::make_shared<sources_t>();
+        auto err = load_sources(*table, *sources);
+        if (err != ok)
+        {
+            return err;
+        }
+        std::atomic_store(&sources_, std::shared_ptr<const sources_t>(sources));
+        auto cache = this->cache();
+        if (nullptr != cache)
+        {
+            cache->clear(); // 缓存的结果包括来源中的值
+        }
+        return ok;
+    }
+
+    // load_sources 加载配置文件和环境变量
+    error_t load_sources(const table_t& table, sources_t& dst)
+    {
+        std::string config;
+        std::string env;
+        {
+            std::lock_guard<std::mutex> lock(sources_mutex_);
+            config = config_;
+            env = env_;
+        }
+        if (!config.empty())
+        {
+            auto err = load_config(table, dst, config);
+            if (err != ok)
+            {
+                return err;
+            }
+        }
+        if (!env.empty())
+        {
+            auto err = load_env(table, dst, env);
+            if (err != ok)
+            {
+                return err;
+            }
+        }
+        index_sources(table, dst);
+        return ok;
+    }
+
+    // convert_source 加载时转换来源中的值，执行时只复制
+    static error_t convert_source(const table_t& table, const pflag_t& flag, const view_t& text, sources_t::entry_t& entry)
+    {
+        entry.id = table.id_of(flag.get());
+        entry.text = text;
+        entry.value = flag->holder_->value(); // 不写入绑定的变量
+        return flag->parse_value(entry.value, text);
+    }
+
+    // index_sources 按命令节点索引可见的来源，被局部标记遮盖或不可继承的标记不可见
+    static void index_sources(const table_t& table, sources_t& dst)
+    {
+        dst.visible.assign(table.size(), std::vector<uint32_t>());
+        if (dst.entries.empty())
+        {
+            return;
+        }
+        for (uint32_t i = 0; i < dst.entries.size(); i++)
+        {
+            auto& flag = table.flag(dst.entries[i].id);
+            auto name = flag->name();
+            for (uint32_t n = 0; n < table.size(); n++)
+            {
+                if (table.find_name(n, name.data(), name.size()) == flag)
+                {
+                    dst.visible[n].push_back(i);
+                }
+            }
+        }
+    }
+
+    // load_config 映射配置文件，一次遍历解析，值以视图引用映射的内存
+    // 值两端成对的引号会被去掉
+    static error_t load_config(const table_t& table, sources_t& dst, const std::string& path)
+    {
+        auto err = dst.file.open(path);
+        if (err != ok)
+        {
+            return err;
+        }
+        auto data = dst.file.view();
+        uint32_t node = 0;
+        size_t number = 0;
+        size_t pos = 0;
+        while (pos < data.size())
+        {
+            auto end = data.find('\n', pos);
+            if (end == view_t::npos)
+            {
+                end = data.size();
+            }
+            auto line = utils::trim_blank(data.substr(pos, end - pos));
+            pos = end + 1;
+            number++;
+            if (line.empty() || line[0] == '#' || line[0] == ';')
+            {
+                continue;
+            }
+
+            if (line[0] == '[')
+            {
+                if (line[line.size() - 1] != ']')
+                {
+                    return make_error("error: config section error.", path + ":" + std::to_string(number));
+                }
+                views_t names;
+                utils::split_blank(names, line.substr(1, line.size() - 2));
+                node = 0;
+                for (auto& name : names)
+                {
+                    node = table.find_sub(node, name.data(), name.size());
+                    if (node == invalid_id)
+                    {
+                        return make_error("error: undefined cmd in config.", path + ":" + std::to_string(number));
+                    }
+                }
+                continue;
+            }
+
+            auto equal = line.find('=');
+            if (equal == view_t::npos)
+            {
+                return make_error("error: config line error.", path + ":" + std::to_string(number));
+            }
+            auto key = utils::trim_blank(line.substr(0, equal));
+            auto value = utils::trim_blank(line.substr(equal + 1));
+            if (value.size() >= 2 && (value[0] == '"' || value[0] == '\'') && value[value.size() - 1] == value[0])
+            {
+                value = value.substr(1, value.size() - 2);
+            }
+            auto flag = table.find_name(node, key.data(), key.size());
+            if (nullptr == flag)
+            {
+                return make_error("error: undefined flag in config.", path + ":" + std::to_string(number));
+            }
+            sources_t::entry_t entry;
+            err = convert_source(table, flag, value, entry);
+            if (err != ok)
+            {
+                return make_error(err.msg(), path + ":" + std::to_string(number));
+            }
+            dst.entries.push_back(std::move(entry));
+        }
+        return ok;
+    }
+
+    // load_env 一次遍历环境变量，按名称索引查找对应的标记，只索引本表中的标记
+    // 同名的标记可能有不同的类型，跳过转换失败的，所有同名标记都转换失败时才报告错误
+    static error_t load_env(const table_t& table, sources_t& dst, const std::string& prefix)
+    {
+        std::unordered_map<std::string, std::vector<uint32_t>> names;
+        for (uint32_t id = 0; id < table.flag_limit(); id++)
+        {
+            auto& flag = table.flag(id);
+            std::string name = flag->name();
+            for (auto& c : name)
+            {
+                c = (c == '-') ? '_' : static_cast<char>(toupper(static_cast<unsigned char>(c)));
+            }
+            names[name].push_back(id);
+        }
+
+#ifdef _WIN32
+        char** envp = _environ;
+#else
+        char** envp = environ;
+#endif
+        for (; nullptr != envp && nullptr != *envp; envp++)
+        {
+            const char* item = *envp;
+            if (strncmp(item, prefix.c_str(), prefix.size()) != 0 || item[prefix.size()] != '_')
+            {
+                continue;
+            }
+            auto equal = strchr(item, '=');
+            if (nullptr == equal)
+            {
+                continue;
+            }
+            auto name = item + prefix.size() + 1;
+            auto it = names.find(std::string(name, equal - name));
+            if (it == names.end())
+            {
+                continue;
+            }
+            dst.held.emplace_back(equal + 1);
+            view_t value(dst.held.back());
+            error_t first;
+            bool converted = false;
+            for (auto id : it->second)
+            {
+                sources_t::entry_t entry;
+                auto err = convert_source(table, table.flag(id), value, entry);
+                if (err != ok)
+                {
+                    if (!converted && first == ok)
+                    {
+                        first = err;
+                    }
+                    continue;
+                }
+                converted = true;
+                dst.entries.push_back(std::move(entry));
+            }
+            if (!converted)
+            {
+                return make_error(first.msg(), std::string(item, equal - item));
+            }
+        }
+        return ok;
+    }
+
+    // apply 命令参数中没有的标记使用来源中的值，exist保持为false
+    // 来源按优先级从低到高排列，后面的覆盖前面的
+    void apply(context_t& ctx) const
+    {
+        auto sources = std::atomic_load(&sources_);
+        if (nullptr == sources || sources->entries.empty() || ctx.node() >= sources->visible.size())
+        {
+            return;
+        }
+        auto& visible = sources->visible[ctx.node()];
+        if (visible.empty())
+        {
+            return;
+        }
+        ctx.sources_ = sources;
+        for (auto i : visible)
+        {
+            auto& entry = sources->entries[i];
+            auto& flag = ctx.table_->flag(entry.id);
+            auto slot = ctx.slot_of(flag.get());
+            if (nullptr == slot || slot->exist)
+            {
+                continue;
+            }
+
+            // 值在加载时已经转换过，这里只复制，绑定的变量通过assign写入
+            if (!bool(slot->value))
+            {
+                slot->value = flag->holder_->clone();
+            }
+            slot->value->assign(*entry.value);
+            slot->text = entry.text;
+            slot->pending = false;
+        }
+    }
+
+    // batch_t 一次批处理的状态
+    struct batch_t
+    {
+        std::string path;
+        const batch_options_t* options{ nullptr };
+        std::ostream* out{ nullptr };
+        error_t first;
+        size_t failed{ 0 };
+        bool stopped{ false };
+    };
+
+    // line_t 并行批处理中的一行
+    struct line_t
+    {
+        size_t number{ 0 };
+
+        // text 标准输入时复制的行，view引用text或映射的文件
+        std::string text;
+        view_t view;
+
+        // out 缓存的输出
+        std::ostringstream out;
+
+        error_t err;
+        bool skipped{ false };
+        bool ready{ false };
+    };
+
+    // reader_t 逐行读取，没有更多的行时返回false
+    using reader_t = std::function<bool(view_t& line)>;
+
+    // batch_depth 当前线程批处理的嵌套深度
+    static int& batch_depth()
+    {
+        static thread_local int depth{ 0 };
+        return depth;
+    }
+
+    // run_batch 批处理文件
+    error_t run_batch(const std::string& path, const batch_options_t& options) const
+    {
+        mapped_file_t file;
+        auto err = file.open(path);
+        if (err != ok)
+        {
+            return err;
+        }
+
+        auto data = file.view();
+        size_t pos = 0;
+        return run_lines(path, options, false, [&data, &pos](view_t& line) -> bool
+        {
+            if (pos >= data.size())
+            {
+                return false;
+            }
+            auto end = data.find('\n', pos);
+            if (end == view_t::npos)
+            {
+                end = data.size();
+            }
+            line = data.substr(pos, end - pos);
+            pos = end + 1;
+            return true;
+        });
+    }
+
+    // run_batch 批处理输入流
+    error_t run_batch(std::istream& is, const std::string& path, const batch_options_t& options) const
+    {
+        std::string text;
+        return run_lines(path, options, true, [&is, &text](view_t& line) -> bool
+        {
+            if (!std::getline(is, text))
+            {
+                return false;
+            }
+            line = text;
+            return true;
+        });
+    }
+
+    // run_lines 逐行执行
+    // @param copy bool 读取到的行在读取下一行后是否会失效
+    error_t run_lines(const std::string& path, const batch_options_t& options, bool copy,
+        const reader_t& next) const
+    {
+        if (batch_depth() != 0)
+        {
+            return make_error("error: nested batch.", path);
+        }
+        batch_depth()++;
+
+        auto ctx = context_t::current();
+        batch_t state;
+        state.path = path;
+        state.options = &options;
+        state.out = (nullptr != ctx) ? &ctx->out() : &std::cout;
+
+        size_t jobs = options.jobs;
+        if (jobs == 0)
+        {
+            jobs = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        if (jobs == 1)
+        {
+            run_serial(state, next);
+        }
+        else
+        {
+            run_parallel(state, next, copy, jobs);
+        }
+
+        batch_depth()--;
+        return batch_result(state);
+    }
+
+    // run_serial 串行执行，输出直接写入当前的输出流
+    void run_serial(batch_t& state, const reader_t& next) const
+    {
+        view_t text;
+        size_t number = 0;
+        bool parallel = false;
+        while (!state.stopped && next(text))
+        {
+            number++;
+            if (!batch_text(text, parallel))
+            {
+                continue;
+            }
+            context_t ctx;
+            ctx.out_ = state.out;
+            auto err = tokenize(ctx, text);
+            batch_done(state, number, (err != ok) ? err : parse(ctx));
+        }
+    }
+
+    // run_parallel 并行执行
+    // 以&开始的行(或者所有行都相互独立时的每一行)交给线程池执行；
+    // 其他的行需要等待之前的行全部完成后才执行。
+    void run_parallel(batch_t& state, const reader_t& next, bool copy, size_t jobs) const
+    {
+        std::ostream& os = *state.out;
+        auto policy = state.options->policy;
+
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::atomic<size_t> first_failed{ std::numeric_limits<size_t>::max() };
+        std::deque<std::unique_ptr<line_t>> lines;
+
+        // run 执行一行，在第一个出错的行之后的行不再执行
+        auto run = [this, policy, &mutex, &cv, &first_failed](line_t* item)
+        {
+            if (item->number > first_failed.load(std::memory_order_acquire))
+            {
+                item->skipped = true;
+            }
+            else
+            {
+                context_t ctx;
+                ctx.out_ = &item->out;
+                item->err = tokenize(ctx, item->view);
+                if (item->err == ok)
+                {
+                    item->err = parse(ctx);
+                }
+                if (item->err != ok && policy == batch_policy_t::stop)
+                {
+                    auto failed = first_failed.load(std::memory_order_acquire);
+                    while (item->number < failed
+                        && !first_failed.compare_exchange_weak(failed, item->number, std::memory_order_acq_rel))
+                    {
+                    }
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                item->ready = true;
+            }
+            cv.notify_all();
+        };
+
+        // emit 按输入的顺序输出已完成的行，直到未输出的行不超过keep
+        auto emit = [this, &state, &os, &mutex, &cv, &lines](size_t keep)
+        {
+            while (lines.size() > keep)
+            {
+                auto& item = *lines.front();
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cv.wait(lock, [&item]() { return item.ready; });
+                }
+                if (!state.stopped && !item.skipped)
+                {
+                    os << item.out.str();
+                    batch_done(state, item.number, item.err);
+                }
+                lines.pop_front();
+            }
+        };
+
+        pool_t pool(jobs);
+        size_t limit = jobs * 64;
+        view_t text;
+        size_t number = 0;
+        while (!state.stopped && next(text))
+        {
+            number++;
+            bool parallel = state.options->independent;
+            if (!batch_text(text, parallel))
+            {
+                continue;
+            }
+
+            lines.emplace_back(new line_t());
+            auto item = lines.back().get();
+            item->number = number;
+            if (copy)
+            {
+                item->text.assign(text.data(), text.size());
+                item->view = item->text;
+            }
+            else
+            {
+                item->view = text;
+            }
+
+            if (parallel)
+            {
+                pool.push(std::bind(run, item));
+                emit(limit);
+            }
+            else
+            {
+                emit(1);
+                if (state.stopped)
+                {
+                    lines.pop_back();
+                    break;
+                }
+                run(item);
+                emit(0);
+            }
+        }
+        emit(0);
+    }
+
+    // batch_text 预处理一行：去除行首的&，空行和注释返回false
+    // @param parallel bool 以&开始时设置为true
+    static bool batch_text(view_t& text, bool& parallel)
+    {
+        size_t pos = 0;
+        while (pos < text.size() && utils::is_blank(text[pos]))
+        {
+            pos++;
+        }
+        if (pos < text.size() && text[pos] == '&')
+        {
+            parallel = true;
+            pos++;
+        }
+        text = text.substr(pos);
+        pos = 0;
+        while (pos < text.size() && utils::is_blank(text[pos]))
+        {
+            pos++;
+        }
+        return pos < text.size() && text[pos] != '#';
+    }
+
+    // batch_done 记录一行的执行结果
+    static void batch_done(batch_t& state, size_t number, const error_t& err)
+    {
+        auto& report = state.options->report;
+        if (nullptr != report)
+        {
+            report(number, err);
+        }
+        if (err == ok)
+        {
+            return;
+        }
+        if (state.failed++ == 0)
+        {
+            state.first = make_error(err.msg(), state.path + ":" + std::to_string(number) + " " + err.stack());
+        }
+        if (state.options->policy == batch_policy_t::stop)
+        {
+            state.stopped = true;
+        }
+    }
+
+    // batch_result 批处理的执行结果
+    static error_t batch_result(const batch_t& state)
+    {
+        if (state.failed == 0)
+        {
+            return ok;
+        }
+        if (state.options->policy == batch_policy_t::stop)
+        {
+            return state.first;
+        }
+        return make_error("batch failed. lines=" + std::to_string(state.failed), state.path);
+    }
+
+    // exec_batch 执行内置的批处理标记
+    error_t exec_batch(context_t& ctx) const
+    {
+        std::string path;
+        batch_options_t options;
+        {
+            context_t::scope_t scope(ctx);
+            path = batch_->cast<std::string>();
+            if (keep_going_->cast<bool>())
+            {
+                options.policy = batch_policy_t::keep_going;
+            }
+            options.jobs = jobs_->cast<uint32_t>();
+            options.independent = independent_->cast<bool>();
+        }
+        if (path.empty())
+        {
+            return make_error("no value of flag.", ctx.breadcrumb(ctx.tokens_.size()));
+        }
+        if (ctx.positionals_.size() != 0)
+        {
+            return make_error("unexpected args with batch.", ctx.breadcrumb(ctx.tokens_.size()));
+        }
+
+        // 继续执行时输出每个失败的行
+        if (options.policy == batch_policy_t::keep_going)
+        {
+            options.report = [&path](size_t line, const error_t& err)
+            {
+                if (err != ok)
+                {
+                    std::cout << path << ":" << line << " " << err << std::endl;
+                }
+            };
+        }
+        if (path == "-")
+        {
+            return run_batch(std::cin, path, options);
+        }
+        return run_batch(path, options);
+    }
+
+#ifdef __linux__
+    // exec_serve 执行内置的命令服务标记
+    error_t exec_serve(context_t& ctx) const
+    {
+        std::string path;
+        {
+            context_t::scope_t scope(ctx);
+            path = serve_->cast<std::string>();
+        }
+        if (path.empty())
+        {
+            return make_error("no value of flag.", ctx.breadcrumb(ctx.tokens_.size()));
+        }
+        if (ctx.positionals_.size() != 0)
+        {
+            return make_error("unexpected args with serve.", ctx.breadcrumb(ctx.tokens_.size()));
+        }
+        server_t server;
+        auto ret = server.listen(path);
+        if (ret != ok)
+        {
+            return ret;
+        }
+        return run_server(server);
+    }
+
+    // run_server 运行命令服务，执行完成时把输出和错误信息交给reply
+    error_t run_server(server_t& server) const
+    {
+        auto exec = executor();
+        std::unique_ptr<pool_t> pool; // 在server.run返回后等待还在执行的命令
+        if (nullptr == exec)
+        {
+            pool.reset(new pool_t(std::max<size_t>(1, std::thread::hardware_concurrency())));
+            exec = pool.get();
+        }
+        return server.run([this, exec](const views_t& argv, const server_t::reply_t& reply)
+        {
+            std::shared_ptr<context_t> ctx(new context_t());
+            std::shared_ptr<std::ostringstream> out(new std::ostringstream());
+            ctx->tokens_ = argv;
+            ctx->out_ = out.get();
+            parse_async(ctx, [out, reply](const error_t& err)
+            {
+                if (err != ok)
+                {
+                    std::ostringstream msg;
+                    msg << err << std::endl;
+                    reply(1, out->str(), msg.str());
+                    return;
+                }
+                reply(0, out->str(), "");
+            }, exec);
+        });
+    }
+#endif
+
+    // bind_init 初始化
+    error_t bind_init()
+    {
+        for (auto& item : _inits_)
+        {
+            auto ret = std::get<0>(item)();
+            if (ret != ok)
+            {
+                ret.stack(std::get<1>(item) + ":" + std::to_string(std::get<2>(item)));
+                return ret;
+            }
+        }
+        return ok;
+    }
+
+    // is_true 是否为bool真值
+    static bool is_true(const view_t& text)
+    {
+        return text == "True" || text == "true" || text == "1";
+    }
+
+    // is_false 是否为bool假值
+    static bool is_false(const view_t& text)
+    {
+        return text == "False" || text == "false" || text == "0";
+    }
+
+    // parse 解析，并执行解析到的命令
+    error_t parse(context_t& ctx) const
+    {
+        error_t err;
+        if (hidden(ctx, err))
+        {
+            return err;
+        }
+        err = resolve(ctx);
+        if (err != ok)
+        {
+            return err;
+        }
+        bool handled = false;
+        err = builtin(ctx, handled);
+        if (handled)
+        {
+            return err;
+        }
+        return invoke(ctx);
+    }
+
+    // resolve 解析参数，打开缓存时先查找缓存，未命中时解析并缓存成功的结果
+    error_t resolve(context_t& ctx) const
     {
-        root_->flag<bool>("help", "h", false, "help", true);
+        auto ret = expand(ctx);
+        if (ret != ok)
+        {
+            return ret;
+        }
+        ret = lookup(ctx);
+        if (ret == ok && ctx.cmd()->eager())
+        {
+            ret = ctx.settle();
+        }
+        return ret;
     }
 
-    // bind_init 初始化
-    error_t bind_init()
+    // lookup 使用缓存的结果或者扫描参数
+    error_t lookup(context_t& ctx) const
     {
-        for (auto& item : _inits_)
+        auto cache = this->cache();
+        if (nullptr == cache)
         {
-            auto ret = std::get<0>(item)();
+            return scan(ctx);
+        }
+        std::string key;
+        parse_cache_t::key(ctx.tokens_, key);
+        auto hit = cache->get(key);
+        if (nullptr != hit && hit->table_ == table())
+        {
+            ctx.result_ = hit;
+            restore(ctx, *hit);
+            return ok;
+        }
+        auto err = scan(ctx);
+        if (err == ok)
+        {
+            auto result = std::make_shared<parse_result_t>();
+            snapshot(ctx, *result);
+            cache->put(key, result);
+        }
+        return err;
+    }
+
+    // expand 展开@file响应文件，文件中的参数按shell的规则切分，以视图引用映射的内存
+    // 响应文件可以嵌套，循环引用时返回错误；文件不存在时保留原参数
+    error_t expand(context_t& ctx) const
+    {
+        auto it = std::find_if(ctx.tokens_.begin(), ctx.tokens_.end(), [](const view_t& item) -> bool
+        {
+            return item.size() > 1 && item[0] == '@';
+        });
+        if (it == ctx.tokens_.end())
+        {
+            return ok;
+        }
+        views_t tokens;
+        std::vector<std::string> stack;
+        auto ret = expand(ctx, ctx.tokens_, tokens, stack);
+        if (ret != ok)
+        {
+            return ret;
+        }
+        ctx.tokens_.swap(tokens);
+        return ok;
+    }
+
+    // expand 展开src中的响应文件到dst
+    // @param stack std::vector<std::string> 正在展开的文件的绝对路径，用于检测循环引用
+    error_t expand(context_t& ctx, const views_t& src, views_t& dst, std::vector<std::string>& stack) const
+    {
+        for (auto& item : src)
+        {
+            if (item.size() < 2 || item[0] != '@')
+            {
+                dst.push_back(item);
+                continue;
+            }
+
+            auto path = item.substr(1).str();
+#ifndef _WIN32
+            char* real = ::realpath(path.c_str(), nullptr);
+#else
+            char* real = ::_fullpath(nullptr, path.c_str(), 0);
+#endif
+            if (nullptr == real)
+            {
+                dst.push_back(item);
+                continue;
+            }
+            std::string key(real);
+            free(real);
+            if (std::find(stack.begin(), stack.end(), key) != stack.end())
+            {
+                return make_error("error: response file cycle.", path);
+            }
+
+            ctx.files_.emplace_back();
+            auto& file = ctx.files_.back();
+            auto ret = file.open(key);
+            if (ret != ok)
+            {
+                ctx.files_.pop_back();
+                dst.push_back(item);
+                continue;
+            }
+            views_t words;
+            if (!utils::split_quoted(words, file.view(), ctx.held_))
+            {
+                return make_error("error: unterminated quote in response file.", path);
+            }
+            stack.push_back(key);
+            ret = expand(ctx, words, dst, stack);
+            stack.pop_back();
             if (ret != ok)
             {
-                ret.stack(std::get<1>(item) + ":" + std::to_string(std::get<2>(item)));
                 return ret;
             }
         }
         return ok;
     }
 
-    // parse 解析
-    error_t parse(const argv_t& argv)
+    // tokenize 按shell的规则把一行命令切分到ctx.tokens_，exec、repl、批处理和补全共用
+    // 结果引用line或者ctx.held_中保存的字符串，引号没有闭合时返回错误
+    static error_t tokenize(context_t& ctx, const view_t& line)
+    {
+        ctx.tokens_.clear();
+        if (!utils::split_quoted(ctx.tokens_, line, ctx.held_))
+        {
+            return make_error("error: unterminated quote.");
+        }
+        return ok;
+    }
+
+    // snapshot 保存上下文中的解析结果
+    static void snapshot(const context_t& ctx, parse_result_t& dst)
+    {
+        dst.table_ = ctx.table_;
+        dst.nodes_ = ctx.nodes_;
+        dst.tokens_.clear();
+        dst.tokens_.reserve(ctx.tokens_.size());
+        for (auto& item : ctx.tokens_)
+        {
+            dst.tokens_.push_back(item.str());
+        }
+        dst.args_.clear();
+        dst.args_.reserve(ctx.positionals_.size());
+        for (auto& item : ctx.positionals_)
+        {
+            dst.args_.push_back(item.str());
+        }
+        dst.values_.clear();
+        dst.values_.reserve(ctx.slots_.size());
+        for (auto& item : ctx.slots_)
+        {
+            dst.values_.emplace_back();
+            auto& value = dst.values_.back();
+            value.id = item.id;
+            value.value = bool(item.value) ? item.value->clone() : nullptr;
+            value.text = item.text.str();
+            value.exist = item.exist;
+            value.pending = item.pending;
+        }
+    }
+
+    // restore 从解析结果恢复上下文，不分词、不查找、不转换
+    // result 必须在上下文的生命周期内有效
+    void restore(context_t& ctx, const parse_result_t& result) const
+    {
+        ctx.name_ = &name_;
+        ctx.desc_ = &desc_;
+        ctx.table_ = result.table_;
+        ctx.lazy_ = this->lazy();
+        auto& table = *ctx.table_;
+        ctx.index_.assign(table.flag_limit(), 0);
+        for (auto& item : result.nodes_)
+        {
+            ctx.chain_.push_back(table.cmd(item));
+            ctx.nodes_.push_back(item);
+        }
+        ctx.slots_.reserve(result.values_.size());
+        for (auto& item : result.values_)
+        {
+            ctx.slots_.emplace_back();
+            auto& slot = ctx.slots_.back();
+            slot.id = item.id;
+            slot.value = bool(item.value) ? item.value->clone() : nullptr;
+            slot.text = view_t(item.text);
+            slot.exist = item.exist;
+            slot.pending = item.pending;
+            ctx.index_[item.id] = static_cast<uint32_t>(ctx.slots_.size());
+        }
+        ctx.positionals_.reserve(result.args_.size());
+        for (auto& item : result.args_)
+        {
+            ctx.positionals_.emplace_back(item);
+        }
+        if (ctx.tokens_.empty())
+        {
+            ctx.tokens_.reserve(result.tokens_.size());
+            for (auto& item : result.tokens_)
+            {
+                ctx.tokens_.emplace_back(item);
+            }
+        }
+    }
+
+    // scan 解析参数，找到命令和标记的值
+    // 只读取命令树，所有状态都写入ctx；参数全部以视图处理，不复制
+    error_t scan(context_t& ctx) const
     {
-        std::stringstream full_stack;
-        std::stringstream pcmd_stack;
-        full_stack << name_;
-        pcmd_stack << name_;
+        ctx.name_ = &name_;
+        ctx.desc_ = &desc_;
+        ctx.table_ = table();
+        if (nullptr == ctx.table_)
+        {
+            return make_error("error: cmd table is not frozen.");
+        }
+
+        auto& table = *ctx.table_;
+        auto& argv = ctx.tokens_;
+        auto& args = ctx.positionals_;
+        auto abbrev = this->abbrev();
+        ctx.lazy_ = this->lazy();
+        ctx.index_.assign(table.flag_limit(), 0);
 
-        auto& pcmd = root_;
-        pcmd->stack(pcmd_stack.str());
+        uint32_t node = 0;
+        pcmd_t pcmd = table.cmd(node);
+        ctx.chain_.push_back(pcmd);
+        ctx.nodes_.push_back(node);
 
-        args_t args;
+        // 成功路径上不生成任何字符串，出错时才由参数下标生成错误位置
         size_t i = 0;
         while (i < argv.size())
         {
-            full_stack << " " << argv[i];
+            auto& token = argv[i];
 
             // 命令和参数处理
-            if (!utils::starts_with(argv[i].c_str(), "-"))
+            if (!token.starts_with('-'))
+            {
+                if (args.size() != 0)
+                {
+                    // 后面的都是参数了，不是子命令
+                    args.push_back(token);
+                    i++;
+                    continue;
+                }
+
+                auto sub = table.find_sub(node, token.data(), token.size(), abbrev);
+                if (sub == invalid_id)
+                {
+                    // 缩写有歧义时报错，而不是当作参数
+                    std::vector<std::string> names;
+                    bool prefixed = table.candidates(node, token, names);
+                    if (abbrev && prefixed && names.size() > 1)
+                    {
+                        return make_error("ambiguous cmd." + hint("candidates", names), ctx.breadcrumb(i + 1));
+                    }
+
+                    // 有子命令但是没有函数的命令不接受参数，给出拼写建议
+                    if (table.node(node).subs_end != table.node(node).subs_begin && !pcmd->is_bound())
+                    {
+                        if (!prefixed)
+                        {
+                            table.suggest(node, token, names);
+                        }
+                        return make_error("undefined cmd." + hint(prefixed ? "candidates" : "did you mean", names),
+                            ctx.breadcrumb(i + 1));
+                    }
+                    args.push_back(token);
+                    i++;
+                    continue;
+                }
+
+                node = sub;
+                pcmd = table.cmd(node);
+                ctx.chain_.push_back(pcmd);
+                ctx.nodes_.push_back(node);
+
+                i++;
+                continue;
+            }
+
+            // 组合的快捷名称：-xvf file，-n5
+            if (token.size() > 2 && token[1] != '-' && token[2] != '=')
+            {
+                i++;
+                auto ret = scan_shorts(ctx, node, token, i);
+                if (ret != ok)
+                {
+                    return ret;
+                }
+                continue;
+            }
+
+            // flagt提取
+            auto flag_name = token;
+            view_t flag_value;
+
+            auto flag_equal_pos = token.find('=');
+            if (flag_equal_pos != view_t::npos)
+            {
+                flag_value = token.substr(flag_equal_pos + 1);
+                flag_name = token.substr(0, flag_equal_pos);
+            }
+            i++;
+
+            auto pflag = table.find_flag(node, flag_name.data(), flag_name.size(), abbrev);
+            if (nullptr == pflag)
+            {
+                std::vector<std::string> names;
+                bool prefixed = table.candidates(node, flag_name, names);
+                if (abbrev && prefixed && names.size() > 1)
+                {
+                    return make_error("ambiguous flag." + hint("candidates", names), ctx.breadcrumb(i));
+                }
+                if (!prefixed)
+                {
+                    table.suggest(node, flag_name, names);
+                }
+                return make_error("undefined flag." + hint(prefixed ? "candidates" : "did you mean", names),
+                    ctx.breadcrumb(i));
+            }
+
+            // flag转换
+            auto flag = pflag.get();
+            if (pflag->castable<bool>())
+            {
+                if (flag_equal_pos == view_t::npos)
+                {
+                    if (i < argv.size())
+                    {
+                        flag_value = argv[i].trim('\'');
+                        if (is_true(flag_value))
+                        {
+                            ctx.parse(flag, "1");
+                            i++;
+                        }
+                        else if (is_false(flag_value))
+                        {
+                            ctx.parse(flag, "0");
+                            i++;
+                        }
+                        else
+                        {
+                            ctx.parse(flag, "1");
+                        }
+                    }
+                    else
+                    {
+                        ctx.parse(flag, "1");
+                    }
+                }
+                else
+                {
+                    if (is_true(flag_value))
+                    {
+                        ctx.parse(flag, "1");
+                    }
+                    else if (is_false(flag_value))
+                    {
+                        ctx.parse(flag, "0");
+                    }
+                    else
+                    {
+                        return make_error("bool value error.", ctx.breadcrumb(i));
+                    }
+                }
+            }
+            else
+            {
+                if (flag_equal_pos == view_t::npos)
+                {
+                    if (i < argv.size())
+                    {
+                        flag_value = argv[i].trim('\'');
+                        if (flag_value.starts_with('-') && flag_value.size() > 1) // 单独的"-"可以作为值，如标准输入
+                        {
+                            return make_error("no value of flag.", ctx.breadcrumb(i));
+                        }
+                        auto ret = ctx.parse(flag, flag_value);
+                        if (ret != ok)
+                        {
+                            return make_error(ret.msg(), ctx.breadcrumb(i + 1));
+                        }
+                        i++;
+                    }
+                    else
+                    {
+                        return make_error("no value of flag ", ctx.breadcrumb(i));
+                    }
+                }
+                else
+                {
+                    auto ret = ctx.parse(flag, flag_value);
+                    if (ret != ok)
+                    {
+                        return make_error(ret.msg(), ctx.breadcrumb(i));
+                    }
+                }
+            }
+        }
+
+        apply(ctx);
+        return ok;
+    }
+
+    // scan_shorts 解析组合的快捷名称
+    // bool标记可以连续组合；需要值的标记取剩余的字符作为值，没有剩余字符时取下一个参数
+    // @param i size_t 下一个参数的下标，取下一个参数作为值时后移
+    error_t scan_shorts(context_t& ctx, uint32_t node, const view_t& token, size_t& i) const
+    {
+        auto& table = *ctx.table_;
+        auto& argv = ctx.tokens_;
+        for (size_t j = 1; j < token.size(); j++)
+        {
+            auto pflag = table.find_short(node, token[j]);
+            if (nullptr == pflag)
+            {
+                return make_error("undefined flag. fast=" + std::string(1, token[j]), ctx.breadcrumb(i));
+            }
+            auto flag = pflag.get();
+            if (pflag->castable<bool>())
+            {
+                ctx.parse(flag, "1");
+                continue;
+            }
+
+            auto flag_value = token.substr(j + 1);
+            if (flag_value.starts_with('='))
+            {
+                flag_value = flag_value.substr(1);
+            }
+            if (flag_value.empty())
+            {
+                if (i >= argv.size())
+                {
+                    return make_error("no value of flag ", ctx.breadcrumb(i));
+                }
+                flag_value = argv[i].trim('\'');
+                if (flag_value.starts_with('-') && flag_value.size() > 1)
+                {
+                    return make_error("no value of flag.", ctx.breadcrumb(i));
+                }
+                i++;
+            }
+            auto ret = ctx.parse(flag, flag_value);
+            if (ret != ok)
+            {
+                return make_error(ret.msg(), ctx.breadcrumb(i));
+            }
+            return ok;
+        }
+        return ok;
+    }
+
+    // hint 错误信息中的候选名称
+    static std::string hint(const char* label, const std::vector<std::string>& names)
+    {
+        if (names.empty())
+        {
+            return "";
+        }
+        std::string ret(" ");
+        ret.append(label).append(":");
+        size_t limit = 8;
+        for (size_t i = 0; i < names.size() && i < limit; i++)
+        {
+            ret.append(i == 0 ? " " : ", ").append(names[i]);
+        }
+        if (names.size() > limit)
+        {
+            ret.append(", ...");
+        }
+        return ret;
+    }
+
+    // hidden 执行隐藏的补全入口 __complete，输出最后一个词的候选项，每行一个
+    // 没有同名的子命令时才有效，在解析之前处理
+    // @return bool 是否是补全入口
+    bool hidden(context_t& ctx, error_t& err) const
+    {
+        auto& tokens = ctx.tokens_;
+        if (tokens.empty() || tokens[0] != "__complete")
+        {
+            return false;
+        }
+        auto table = this->table();
+        if (nullptr == table || table->find_sub(0, tokens[0].data(), tokens[0].size()) != invalid_id)
+        {
+            return false;
+        }
+        views_t words(tokens.begin() + 1, tokens.end());
+        if (words.empty())
+        {
+            words.push_back(view_t());
+        }
+        std::vector<std::string> dst;
+        complete(words, dst);
+        std::string text;
+        for (auto& item : dst)
+        {
+            text.append(item).push_back('\n');
+        }
+        ctx.out() << text << std::flush;
+        err = ok;
+        return true;
+    }
+
+    // write_completion 生成补全脚本
+    // 脚本中按节点编号：逐个词沿子命令走到节点，再按节点给出子命令、标记或者标记的可选项
+    error_t write_completion(const std::string& shell, std::ostream& os) const
+    {
+        if (shell != "bash" && shell != "zsh")
+        {
+            return make_error("unsupported shell. shell=" + shell);
+        }
+        auto table = this->table();
+        if (nullptr == table)
+        {
+            return make_error("error: cmd table is not frozen.");
+        }
+        bool zsh = (shell == "zsh");
+        auto& name = name_;
+        std::string func = "_";
+        for (auto c : name)
+        {
+            func.push_back(isalnum(static_cast<unsigned char>(c)) ? c : '_');
+        }
+        func.append("_complete");
+
+        // 需要值的标记，出现时跳过下一个词
+        std::vector<std::string> valued;
+        // 节点:标记 -> 可选项
+        std::vector<std::pair<std::string, std::string>> choices;
+        for (uint32_t n = 0; n < table->size(); n++)
+        {
+            for (auto id : table->visible(n))
             {
-                if (args.size() != 0)
+                auto& pflag = table->flag(id);
+                if (pflag->castable<bool>())
                 {
-                    // 后面的都是参数了，不是子命令
-                    args.push_back(utils::trim(argv[i], "\'"));
-                    i++;
                     continue;
                 }
-
-                auto cit = pcmd->subs().find(argv[i]);
-                if (cit == pcmd->subs().end())
+                std::vector<std::string> keys{ "--" + pflag->name() };
+                if (!pflag->fast().empty() && table->find_flag(n, ("-" + pflag->fast()).c_str(), 2) == pflag)
                 {
-                    args.push_back(utils::trim(argv[i], "\'"));
-                    i++;
-                    continue;
+                    keys.push_back("-" + pflag->fast());
                 }
-
-                for (auto& item : pcmd->flags())
+                std::vector<std::string> items;
+                table->options(id, view_t(), items);
+                for (auto& key : keys)
                 {
-                    if (item.second->extend() && cit->second->flags().count(item.first) == 0)
+                    valued.push_back(key);
+                    if (!items.empty())
                     {
-                        item.second->stack(pcmd_stack.str());
-                        cit->second->flags()[item.first] = item.second;
+                        choices.emplace_back(std::to_string(n) + ":" + key, utils::join(items, " "));
                     }
                 }
+            }
+        }
+        std::sort(valued.begin(), valued.end());
+        valued.erase(std::unique(valued.begin(), valued.end()), valued.end());
 
-                cit->second->parent(pcmd);
-                pcmd = cit->second;
-                pcmd_stack << " " << argv[i];
-                pcmd->stack(pcmd_stack.str());
+        std::string cur = zsh ? "${words[CURRENT]}" : "${COMP_WORDS[COMP_CWORD]}";
+        std::string prev = zsh ? "${words[CURRENT-1]}" : "${COMP_WORDS[COMP_CWORD-1]}";
+        std::string word = zsh ? "${words[i]}" : "${COMP_WORDS[i]}";
+        std::string stop = zsh ? "CURRENT" : "COMP_CWORD";
 
-                i++;
-                continue;
+        std::ostringstream out;
+        if (zsh)
+        {
+            out << "#compdef " << name << "\n";
+        }
+        out << "# " << shell << " completion for " << name << ", generated by clips\n"
+            << func << "()\n"
+            << "{\n"
+            << "    local cur=\"" << cur << "\" prev=\"" << prev << "\"\n"
+            << "    local node=0 args= i w list=\n"
+            << "    for ((i = " << (zsh ? 2 : 1) << "; i < " << stop << "; i++)); do\n"
+            << "        w=\"" << word << "\"\n"
+            << "        case \"$w\" in\n";
+        if (!valued.empty())
+        {
+            out << "            " << patterns(valued) << ") i=$((i + 1)); continue ;;\n";
+        }
+        out << "            -*) continue ;;\n"
+            << "        esac\n"
+            << "        [[ -n $args ]] && continue\n"
+            << "        case \"$node:$w\" in\n";
+        for (uint32_t n = 1; n < table->size(); n++)
+        {
+            out << "            " << quote(std::to_string(table->node(n).parent) + ":" + table->cmd(n)->name())
+                << ") node=" << n << " ;;\n";
+        }
+        out << "            *) args=1 ;;\n"
+            << "        esac\n"
+            << "    done\n";
+
+        if (!choices.empty())
+        {
+            out << "    case \"$node:$prev\" in\n";
+            for (auto& item : choices)
+            {
+                out << "        " << quote(item.first) << ") list=" << quote(item.second) << " ;;\n";
+            }
+            out << "    esac\n";
+        }
+        out << "    if [[ -z $list ]]; then\n"
+            << "        case \"$cur\" in\n"
+            << "            -*)\n"
+            << "                case $node in\n";
+        for (uint32_t n = 0; n < table->size(); n++)
+        {
+            std::vector<std::string> items;
+            table->complete(n, "--", items);
+            if (!items.empty())
+            {
+                out << "                    " << n << ") list=" << quote(utils::join(items, " ")) << " ;;\n";
             }
+        }
+        out << "                esac ;;\n"
+            << "            *)\n"
+            << "                [[ -z $args ]] && case $node in\n";
+        for (uint32_t n = 0; n < table->size(); n++)
+        {
+            std::vector<std::string> items;
+            table->complete(n, "", items);
+            if (!items.empty())
+            {
+                out << "                    " << n << ") list=" << quote(utils::join(items, " ")) << " ;;\n";
+            }
+        }
+        out << "                esac ;;\n"
+            << "        esac\n"
+            << "    fi\n";
+        if (zsh)
+        {
+            out << "    if [[ -z $list ]]; then\n"
+                << "        _files\n"
+                << "    else\n"
+                << "        compadd -- ${=list}\n"
+                << "    fi\n"
+                << "}\n"
+                << "compdef " << func << " " << name << "\n";
+        }
+        else
+        {
+            out << "    COMPREPLY=($(compgen -W \"$list\" -- \"$cur\"))\n"
+                << "}\n"
+                << "complete -o default -F " << func << " " << name << "\n";
+        }
+        os << out.str();
+        os.flush();
+        return ok;
+    }
 
-            // flagt提取
-            auto flag_name = argv[i];
-            std::string flag_value("");
+    // quote shell的单引号字符串
+    static std::string quote(const std::string& text)
+    {
+        std::string ret("'");
+        for (auto c : text)
+        {
+            if (c == '\'')
+            {
+                ret.append("'\\''");
+            }
+            else
+            {
+                ret.push_back(c);
+            }
+        }
+        ret.push_back('\'');
+        return ret;
+    }
 
-            auto flag_equal_pos = flag_name.find("=");
-            if (flag_equal_pos != std::string::npos)
+    // patterns case语句的模式列表
+    static std::string patterns(const std::vector<std::string>& items)
+    {
+        std::string ret;
+        for (auto& item : items)
+        {
+            if (!ret.empty())
             {
-                flag_value = flag_name.substr(flag_equal_pos + 1, flag_name.length() - flag_equal_pos - 1);
-                flag_name = flag_name.substr(0, flag_equal_pos);
+                ret.push_back('|');
             }
-            i++;
+            ret.append(quote(item));
+        }
+        return ret;
+    }
 
-            auto fit = pcmd->flags().find(flag_name);
-            if (fit == pcmd->flags().end())
+    // builtin 执行内置的批处理和命令服务标记，只在根命令上有效
+    // @param handled bool 是否执行了内置标记
+    error_t builtin(context_t& ctx, bool& handled) const
+    {
+        handled = false;
+        if (ctx.node() != 0)
+        {
+            return ok;
+        }
+        auto item = (nullptr == completion_) ? nullptr : ctx.slot(completion_.get());
+        if (nullptr != item && item->exist)
+        {
+            handled = true;
+            if (ctx.positionals_.size() != 0)
             {
-                return make_error("undefined flag.", full_stack.str());
+                return make_error("unexpected args with completion.", ctx.breadcrumb(ctx.tokens_.size()));
             }
+            return write_completion(item->text.str(), ctx.out());
+        }
+        item = (nullptr == batch_) ? nullptr : ctx.slot(batch_.get());
+        if (nullptr != item && item->exist)
+        {
+            handled = true;
+            return exec_batch(ctx);
+        }
+#ifdef __linux__
+        item = (nullptr == serve_) ? nullptr : ctx.slot(serve_.get());
+        if (nullptr != item && item->exist)
+        {
+            handled = true;
+            return exec_serve(ctx);
+        }
+#endif
+        return ok;
+    }
 
-            // flag转换
-            auto pflag = fit->second;
-            pflag->exist(true);
-            if (pflag->castable<bool>())
+    // parse_async 解析，并异步执行解析到的命令，同步的命令函数交给exec执行，nullptr时直接执行
+    // ctx在done之前一直有效
+    void parse_async(const std::shared_ptr<context_t>& ctx, const done_t& done, executor_t* exec) const
+    {
+        error_t err;
+        if (hidden(*ctx, err))
+        {
+            done(err);
+            return;
+        }
+        err = resolve(*ctx);
+        if (err != ok)
+        {
+            done(err);
+            return;
+        }
+        bool handled = false;
+        err = builtin(*ctx, handled);
+        if (handled)
+        {
+            done(err);
+            return;
+        }
+
+        auto& pcmd = ctx->cmd();
+        if (pcmd->is_async())
+        {
+            auto once = std::make_shared<std::atomic<bool>>(false);
+            auto finish = [ctx, done, once](const error_t& err)
             {
-                if (flag_equal_pos == std::string::npos)
-                {
-                    if (i < argv.size())
-                    {
-                        flag_value = utils::trim(argv[i], "\'");
-                        if (flag_value.compare("True") == 0 || flag_value.compare("true") == 0 || flag_value.compare("1") == 0)
-                        {
-                            pflag->parse("1");
-                            full_stack << " " << argv[i];
-                            i++;
-                        }
-                        else if (flag_value.compare("False") == 0 || flag_value.compare("false") == 0 || flag_value.compare("0") == 0)
-                        {
-                            pflag->parse("0");
-                            full_stack << " " << argv[i];
-                            i++;
-                        }
-                        else
-                        {
-                            pflag->parse("1");
-                        }
-                    }
-                    else
-                    {
-                        pflag->parse("1");
-                    }
-                }
-                else
+                if (!once->exchange(true))
                 {
-                    if (flag_value.compare("True") == 0 || flag_value.compare("true") == 0 || flag_value.compare("1") == 0)
-                    {
-                        pflag->parse("1");
-                    }
-                    else if (flag_value.compare("False") == 0 || flag_value.compare("false") == 0 || flag_value.compare("0") == 0)
-                    {
-                        pflag->parse("0");
-                    }
-                    else
-                    {
-                        return make_error("bool value error.", full_stack.str());
-                    }
+                    done(err);
                 }
+            };
+            try
+            {
+                context_t::scope_t scope(*ctx);
+                pcmd->on_exec_async(pcmd, ctx->args_view(), finish);
             }
-            else
+            catch (std::exception& e)
             {
-                if (flag_equal_pos == std::string::npos)
-                {
-                    if (i < argv.size())
-                    {
-                        flag_value = utils::trim(argv[i], "\'");
-                        if (utils::starts_with(flag_value.c_str(), "-"))
-                        {
-                            return make_error("no value of flag.", full_stack.str());
-                        }
-                        full_stack << " " << argv[i];
-                        auto ret = pflag->parse(flag_value);
-                        if (ret != ok)
-                        {
-                            return make_error(ret.msg(), full_stack.str());
-                        }
-                        i++;
-                    }
-                    else
-                    {
-                        return make_error("no value of flag ", full_stack.str());
-                    }
-                }
-                else
-                {
-                    auto ret = pflag->parse(flag_value);
-                    if (ret != ok)
-                    {
-                        return make_error(ret.msg(), full_stack.str());
-                    }
-                }
+                done(make_error(e.what()));
             }
+            return;
         }
 
+        auto task = [ctx, done]()
+        {
+            done(invoke(*ctx));
+        };
+        if (nullptr == exec)
+        {
+            task();
+            return;
+        }
+        exec->post(task);
+    }
+
+    // invoke 在解析上下文中执行解析到的命令
+    static error_t invoke(context_t& ctx)
+    {
+        auto& pcmd = ctx.cmd();
         error_t err;
         try
         {
-            err = pcmd->on_exec(pcmd, args);
+            context_t::scope_t scope(ctx);
+            err = pcmd->on_exec(pcmd, ctx.args_view());
         }
         catch (flag_cast_exception& e)
         {
@@ -2383,14 +9172,89 @@ private:
     // version_ 版本
     std::string version_;
 
-    // argv_ 原始命令
+    // argc_ argvp_ exec(int, char**)时的原始参数，只引用不复制
+    int argc_{ 0 };
+    char** argvp_{ nullptr };
+
+    // argv_ 原始命令，第一次访问时生成
     argv_t argv_;
+    bool argv_ready_{ false };
 
     // root_ 根命令
     pcmd_t root_;
 
+    // batch_ keep_going_ jobs_ independent_ 内置的批处理标记，没有添加时为nullptr
+    pflag_t batch_;
+    pflag_t keep_going_;
+    pflag_t jobs_;
+    pflag_t independent_;
+
+    // serve_ 内置的命令服务标记
+    pflag_t serve_;
+
+    // completion_ 内置的补全脚本标记
+    pflag_t completion_;
+
+    // table_ 编译后的命令表，通过atomic_load/atomic_store访问
+    std::shared_ptr<const table_t> table_;
+
+    // executor_ 执行器
+    std::atomic<executor_t*> executor_{ nullptr };
+
+    // cache_ 解析结果缓存，nullptr时不缓存
+    std::shared_ptr<parse_cache_t> cache_;
+
+    // config_ env_ 配置文件和环境变量前缀，通过sources_mutex_访问
+    std::string config_;
+    std::string env_;
+    std::mutex sources_mutex_;
+
+    // sources_ 按命令表解析的标记来源，通过atomic_load/atomic_store访问
+    std::shared_ptr<const sources_t> sources_;
+
+    // abbrev_ 是否接受前缀缩写
+    std::atomic<bool> abbrev_{ false };
+
+    // lazy_ 是否惰性转换
+    std::atomic<bool> lazy_{ false };
+
     // _inits_ 初始化函数
     _inits_t _inits_;
+
+    // inited_ 初始化函数是否已执行
+    std::atomic<bool> inited_{ false };
+
+    // init_error_ 初始化函数的执行结果
+    error_t init_error_;
+
+    // init_mutex_ 初始化锁
+    std::mutex init_mutex_;
+};
+
+// ----------------------------------------------------------------------------
+// inner
+
+// inner 内部使用，全局默认应用
+class inner : public app_t
+{
+public:
+    // get 获取实例
+    static inner& get()
+    {
+        static std::unique_ptr<inner> ins_{ nullptr };
+        static std::once_flag flagone;
+        std::call_once(flagone, []() {
+            ins_.reset(new inner());
+        });
+        return *ins_;
+    }
+
+private:
+    inner(const inner& cpy) = delete;
+    inner& operator=(const inner& rhs) = delete;
+    inner()
+    {
+    }
 };
 
 // ----------------------------------------------------------------------------
@@ -2408,7 +9272,7 @@ inline const std::string& path()
 /// 如果不指定应用名称，则在exec解析时会使用argv[0]代替；
 inline void name(const std::string& name)
 {
-    inner::get().name();
+    inner::get().name(name);
 }
 
 /// name 应用名称
@@ -2437,6 +9301,60 @@ inline const argv_t& argv()
     return inner::get().argv();
 }
 
+/// freeze 编译命令树，检查重复或冲突的定义
+/// 首次exec时会自动执行，初始化之后修改了命令树需要重新调用
+inline error_t freeze()
+{
+    auto err = inner::get().init();
+    if (err != ok)
+    {
+        return err;
+    }
+    return inner::get().freeze();
+}
+
+/// context 当前线程正在执行的解析上下文
+/// 只在命令执行期间有效，否则为nullptr
+inline context_t* context()
+{
+    return context_t::current();
+}
+
+/// context_bound_t bind_context返回的函数对象，调用时在绑定的解析上下文中执行
+template<class F>
+class context_bound_t
+{
+public:
+    context_bound_t(context_t* ctx, F func)
+        : ctx_(ctx)
+        , func_(std::move(func))
+    {
+    }
+
+    template<class... Args>
+    auto operator()(Args&&... args) -> decltype(std::declval<F&>()(std::forward<Args>(args)...))
+    {
+        if (nullptr == ctx_)
+        {
+            return func_(std::forward<Args>(args)...);
+        }
+        context_t::scope_t scope(*ctx_);
+        return func_(std::forward<Args>(args)...);
+    }
+
+private:
+    context_t* ctx_;
+    F func_;
+};
+
+/// bind_context 把函数绑定到当前的解析上下文，异步命令函数的延续在其他线程中也可以读取flag
+/// 解析上下文在done之后失效：延续必须在调用done之前读取，并且不要和命令函数同时读取
+template<class F>
+context_bound_t<typename std::decay<F>::type> bind_context(F&& func)
+{
+    return context_bound_t<typename std::decay<F>::type>(context_t::current(), std::forward<F>(func));
+}
+
 /// bind 绑定根函数
 inline error_t bind(func_t func)
 {
@@ -2449,12 +9367,19 @@ inline error_t bind(pcmd_t& ptr)
     return inner::get().bind(ptr);
 }
 
+/// bind 绑定类型化的根函数，schema中的标记会被添加到根命令
+template<class T>
+inline error_t bind(const schema_t<T>& schema, typename schema_t<T>::func_t func)
+{
+    return inner::get().bind(schema, func);
+}
+
 /// flag 标记
 template <class T,
     class = typename std::enable_if<!std::is_pointer<T>::value
     && !std::is_const<T>::value
     && !std::is_reference<T>::value, T>::type>
-    inline error_t flag(const std::string& name, const std::string& fast, T default_value,
+    inline flag_ref<T> flag(const std::string& name, const std::string& fast, T default_value,
         const std::string& desc, bool extend = false)
 {
     return inner::get().flag(name, fast, default_value, desc, extend);
@@ -2468,7 +9393,7 @@ template <class T,
     && !std::is_same<T, double>::value
     && !std::is_same<T, float>::value
     && !std::is_same<T, bool>::value, T>::type>
-    inline error_t flag(const std::string& name, const std::string& fast, T default_value,
+    inline flag_ref<T> flag(const std::string& name, const std::string& fast, T default_value,
         const std::vector<T>& options, const std::string& desc, bool extend = false)
 {
     return inner::get().flag(name, fast, default_value, options, desc, extend);
@@ -2511,6 +9436,120 @@ inline error_t exec(int argc, char* argv[])
     return inner::get().exec(argc, argv);
 }
 
+/// parse 只解析，不执行
+inline error_t parse(const std::string& argv, parse_result_t& dst)
+{
+    return inner::get().parse(argv, dst);
+}
+
+/// exec 执行解析结果
+inline error_t exec(const parse_result_t& result)
+{
+    return inner::get().exec(result);
+}
+
+/// cache 打开解析结果缓存，capacity为0时关闭
+inline void cache(size_t capacity)
+{
+    inner::get().cache(capacity);
+}
+
+/// abbrev 是否接受无歧义的前缀缩写
+inline void abbrev(bool abbrev)
+{
+    inner::get().abbrev(abbrev);
+}
+
+/// builtins 在根命令上添加内置标记，如 builtins(builtin_t::batch | builtin_t::completion)
+inline error_t builtins(builtin_t which)
+{
+    return inner::get().builtins(which);
+}
+
+/// lazy 惰性转换，第一次cast时才转换和校验标记的值
+inline void lazy(bool lazy)
+{
+    inner::get().lazy(lazy);
+}
+
+/// config 配置文件，优先级在默认值之后、环境变量之前
+inline error_t config(const std::string& path)
+{
+    return inner::get().config(path);
+}
+
+/// env 环境变量的前缀，PREFIX_NAME 对应名称为name的标记
+inline error_t env(const std::string& prefix)
+{
+    return inner::get().env(prefix);
+}
+
+/// batch 批处理，逐行执行文件中的命令，"-"为标准输入
+inline error_t batch(const std::string& path, batch_policy_t policy = batch_policy_t::stop,
+    const batch_report_t& report = nullptr)
+{
+    return inner::get().batch(path, policy, report);
+}
+
+/// batch 批处理，逐行执行输入流中的命令
+inline error_t batch(std::istream& is, batch_policy_t policy = batch_policy_t::stop,
+    const batch_report_t& report = nullptr)
+{
+    return inner::get().batch(is, policy, report);
+}
+
+/// batch 批处理，可以并行执行，"-"为标准输入
+inline error_t batch(const std::string& path, const batch_options_t& options)
+{
+    return inner::get().batch(path, options);
+}
+
+/// batch 批处理，可以并行执行
+inline error_t batch(std::istream& is, const batch_options_t& options)
+{
+    return inner::get().batch(is, options);
+}
+
+/// repl 交互模式，逐行读取命令并执行
+inline error_t repl(std::istream& in = std::cin, std::ostream& out = std::cout)
+{
+    return inner::get().repl(in, out);
+}
+
+#ifdef __linux__
+/// serve 本地命令服务，在Unix socket上执行转发的命令
+inline error_t serve(const std::string& path)
+{
+    return inner::get().serve(path);
+}
+#endif
+
+/// executor 设置执行器，exec_async时同步的命令函数交给执行器执行
+inline void executor(executor_t* executor)
+{
+    inner::get().executor(executor);
+}
+
+/// exec_async 异步执行命令，完成时调用done
+inline void exec_async(const std::string& argv, const done_t& done)
+{
+    inner::get().exec_async(argv, done);
+}
+
+/// exec_async 异步执行命令，返回std::future
+inline std::future<error_t> exec_async(const std::string& argv)
+{
+    return inner::get().exec_async(argv);
+}
+
+/// out 命令的输出流
+/// 并行批处理时每行的输出先缓存，再按输入的顺序输出，命令函数应该使用它代替std::cout
+inline std::ostream& out()
+{
+    auto ctx = context_t::current();
+    return (nullptr != ctx) ? ctx->out() : std::cout;
+}
+
 // _bind_init_func 绑定初始化函数, 内部使用
 inline bool _bind_init_func(_init_func_t func, const char* file, int line)
 {
@@ -17,6 +17,1270 @@
 
 #include "catch.hpp"
 
+#include <thread>
+#include <atomic>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <algorithm>
+#include <mutex>
+#include <future>
+
 TEST_CASE("cmd")
 {
+    SECTION("app concurrent exec")
+    {
+        clips::app_t app;
+        app.name("app");
+
+        std::atomic<int> mismatch{ 0 };
+        auto sub = clips::make_cmd("sub");
+        sub->flag<int>("num", "n", 0, "num");
+        sub->bind([&](const clips::pcmd_t& pcmd, const clips::args_t& args) -> clips::error_t
+        {
+            if (args.size() != 1 || std::to_string(pcmd->cast<int>("--num")) != args[0])
+            {
+                mismatch++;
+            }
+            return clips::ok;
+        });
+        REQUIRE(app.bind(sub) == clips::ok);
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++)
+        {
+            threads.emplace_back([&app, t]()
+            {
+                for (int i = 0; i < 200; i++)
+                {
+                    auto n = std::to_string(t * 1000 + i);
+                    app.exec("sub --num=" + n + " " + n);
+                }
+            });
+        }
+        for (auto& item : threads)
+        {
+            item.join();
+        }
+        REQUIRE(mismatch == 0);
+
+        // 解析状态不会残留到下一次执行
+        REQUIRE(app.exec("sub 0") == clips::ok);
+        REQUIRE(mismatch == 0);
+    }
+
+    SECTION("args view")
+    {
+        clips::app_t app;
+        std::string line("view 'a x' b");
+
+        std::vector<std::string> got;
+        auto view = clips::make_cmd("view");
+        view->bind([&](const clips::pcmd_t& pcmd, const clips::args_view_t& args) -> clips::error_t
+        {
+            for (size_t i = 0; i < args.size(); i++)
+            {
+                got.push_back(args.str(i));
+            }
+            REQUIRE(args.raw(0) == "a x"); // 引号在切分时已经去掉
+            return clips::ok;
+        });
+        REQUIRE(app.bind(view) == clips::ok);
+        REQUIRE(app.exec(line) == clips::ok);
+        REQUIRE(got.size() == 2);
+        REQUIRE(got[0] == "a x");
+        REQUIRE(got[1] == "b");
+        REQUIRE(app.exec("view 'a") != clips::ok);
+        REQUIRE(got.size() == 2);
+    }
+
+    SECTION("freeze")
+    {
+        clips::app_t app;
+        auto sub = clips::make_cmd("sub");
+        auto leaf = clips::make_cmd("leaf");
+        REQUIRE(sub->bind(leaf) == clips::ok);
+        REQUIRE(app.bind(sub) == clips::ok);
+        REQUIRE(app.freeze() == clips::ok);
+        REQUIRE(app.table()->size() == 3);
+        REQUIRE(app.table()->find_sub(0, "sub", 3) == 1);
+        REQUIRE(app.table()->find_sub(0, "leaf", 4) == clips::invalid_id);
+        REQUIRE(app.table()->find_flag(2, "-h", 2) != nullptr);
+
+        // 局部的标记遮盖继承的同名标记
+        auto host = leaf->flag<int>("host", "h", 0, "host");
+        REQUIRE(host == clips::ok);
+        REQUIRE(sub->flag<int>("help", "", 0, "help") == clips::ok);
+        REQUIRE(app.freeze() == clips::ok);
+        REQUIRE(app.table()->find_flag(2, "-h", 2) == host.flag());
+        REQUIRE(app.table()->find_flag(1, "--help", 6) == sub->flags().at("--help"));
+        REQUIRE(app.table()->find_flag(1, "-h", 2) == app.table()->find_flag(0, "-h", 2));
+
+        // 循环绑定
+        clips::app_t cyclic;
+        auto loop = clips::make_cmd("loop");
+        REQUIRE(loop->bind(loop) == clips::ok);
+        REQUIRE(cyclic.bind(loop) == clips::ok);
+        REQUIRE(cyclic.freeze() != clips::ok);
+    }
+
+    SECTION("schema")
+    {
+        struct opts_t
+        {
+            uint32_t depth{ 0 };
+            bool force{ false };
+            std::string mode;
+        };
+
+        clips::schema_t<opts_t> schema;
+        schema.flag(&opts_t::depth, "depth", "d", 1, "depth")
+            .flag(&opts_t::force, "force", "f", false, "force")
+            .flag(&opts_t::mode, "mode", "m", "fast", { "fast", "safe" }, "mode", false);
+        REQUIRE(schema.size() == 3);
+
+        clips::app_t app;
+        opts_t got;
+        std::string arg;
+        auto copy = clips::make_cmd("copy");
+        REQUIRE(copy->bind(schema, [&](const clips::pcmd_t& pcmd, const opts_t& opts, const clips::args_view_t& args) -> clips::error_t
+        {
+            got = opts;
+            arg = args.str(0);
+            REQUIRE(pcmd->cast<uint32_t>("--depth") == opts.depth);
+            return clips::ok;
+        }) == clips::ok);
+        REQUIRE(copy->flags().size() == 6);
+        REQUIRE(app.bind(copy) == clips::ok);
+
+        REQUIRE(app.exec("copy -d 3 --mode=safe -f src") == clips::ok);
+        REQUIRE(got.depth == 3);
+        REQUIRE(got.force);
+        REQUIRE(got.mode == "safe");
+        REQUIRE(arg == "src");
+
+        // 未输入的标记使用默认值
+        REQUIRE(app.exec("copy dst") == clips::ok);
+        REQUIRE(got.depth == 1);
+        REQUIRE(!got.force);
+        REQUIRE(got.mode == "fast");
+
+        REQUIRE(app.exec("copy --mode=slow") != clips::ok);
+
+        // 同一个schema重复绑定
+        REQUIRE(copy->bind(schema, [](const clips::pcmd_t& pcmd, const opts_t& opts, const clips::args_view_t& args) -> clips::error_t
+        {
+            return clips::ok;
+        }) != clips::ok);
+
+        // 中途失败时移除已经添加的标记
+        auto move = clips::make_cmd("move");
+        REQUIRE(move->flag<int>("force", "", 0, "force") == clips::ok);
+        REQUIRE(move->bind(schema, [](const clips::pcmd_t& pcmd, const opts_t& opts, const clips::args_view_t& args) -> clips::error_t
+        {
+            return clips::ok;
+        }) != clips::ok);
+        REQUIRE(move->flags().size() == 1);
+    }
+
+    SECTION("batch")
+    {
+        clips::app_t app;
+        std::vector<std::string> got;
+        auto echo = clips::make_cmd("echo");
+        echo->flag<int>("num", "n", 0, "num");
+        echo->bind([&](const clips::pcmd_t& pcmd, const clips::args_view_t& args) -> clips::error_t
+        {
+            got.push_back(args.str(0) + std::to_string(pcmd->cast<int>("--num")));
+            return clips::ok;
+        });
+        REQUIRE(app.bind(echo) == clips::ok);
+
+        std::vector<size_t> failed;
+        auto report = [&](size_t line, const clips::error_t& err)
+        {
+            if (err != clips::ok)
+            {
+                failed.push_back(line);
+            }
+        };
+
+        // 空行和注释会被忽略，连续的空白字符只作为一个分隔符
+        std::istringstream script("echo a\n\n# echo b\n  echo\tc  -n 2\r\necho d --num=x\necho e\n");
+        REQUIRE(app.batch(script, clips::batch_policy_t::stop, report) != clips::ok);
+        REQUIRE(got.size() == 2);
+        REQUIRE(got[1] == "c2");
+        REQUIRE(failed.size() == 1);
+        REQUIRE(failed[0] == 5);
+
+        got.clear();
+        failed.clear();
+        script.clear();
+        script.seekg(0);
+        REQUIRE(app.batch(script, clips::batch_policy_t::keep_going, report) != clips::ok);
+        REQUIRE(got.size() == 3);
+        REQUIRE(got[2] == "e0");
+        REQUIRE(failed.size() == 1);
+
+        // 按shell的规则切分，引号没有闭合的行是出错的行
+        got.clear();
+        failed.clear();
+        std::istringstream quoted("echo \"x y\" -n 1\necho 'oops\necho z\n");
+        REQUIRE(app.batch(quoted, clips::batch_policy_t::keep_going, report) != clips::ok);
+        REQUIRE(got.size() == 2);
+        REQUIRE(got[0] == "x y1");
+        REQUIRE(failed.size() == 1);
+        REQUIRE(failed[0] == 2);
+
+        // 内置的批处理标记需要显式添加，与已有的根标记同名时失败
+        clips::app_t plain;
+        REQUIRE(plain.flag<int>("jobs", "j", 1, "jobs") == clips::ok);
+        REQUIRE(plain.builtins(clips::builtin_t::batch) != clips::ok);
+        REQUIRE(plain.builtins(clips::builtin_t::completion) == clips::ok);
+        REQUIRE(plain.exec("--batch x") != clips::ok);
+        REQUIRE(app.builtins(clips::builtin_t::batch) == clips::ok);
+        REQUIRE(app.builtins(clips::builtin_t::batch) == clips::ok);
+        const char* path = "clips_batch_test.txt";
+        {
+            std::ofstream ofs(path);
+            ofs << "echo f -n 1\necho g";
+        }
+        got.clear();
+        REQUIRE(app.exec(std::string("--batch ") + path) == clips::ok);
+        REQUIRE(got.size() == 2);
+        REQUIRE(got[1] == "g0");
+        REQUIRE(app.batch("not_exist.txt") != clips::ok);
+        std::remove(path);
+    }
+
+    SECTION("parallel batch")
+    {
+        clips::app_t app;
+        std::atomic<int> count{ 0 };
+        auto echo = clips::make_cmd("echo");
+        echo->bind([&](const clips::pcmd_t& pcmd, const clips::args_view_t& args) -> clips::error_t
+        {
+            count++;
+            if (args.size() == 0)
+            {
+                return clips::make_error("no args");
+            }
+            clips::out() << args[0] << std::endl;
+            return clips::ok;
+        });
+        REQUIRE(app.bind(echo) == clips::ok);
+
+        std::string script;
+        std::string expect;
+        for (int i = 0; i < 500; i++)
+        {
+            script += "echo " + std::to_string(i) + "\n";
+            expect += std::to_string(i) + "\n";
+        }
+
+        // 输出和执行结果都按输入的顺序
+        std::ostringstream out;
+        std::vector<size_t> lines;
+        clips::batch_options_t options;
+        options.jobs = 4;
+        options.independent = true;
+        options.report = [&lines](size_t line, const clips::error_t& err)
+        {
+            lines.push_back(line);
+        };
+        std::istringstream is(script);
+        auto old = std::cout.rdbuf(out.rdbuf());
+        auto err = app.batch(is, options);
+        std::cout.rdbuf(old);
+        REQUIRE(err == clips::ok);
+        REQUIRE(out.str() == expect);
+        REQUIRE(lines.size() == 500);
+        REQUIRE(std::is_sorted(lines.begin(), lines.end()));
+        REQUIRE(count == 500);
+
+        // 只有以&开始的行并行执行，在第一个出错的行停止
+        out.str("");
+        lines.clear();
+        options.independent = false;
+        std::istringstream marked("echo a\n&echo b\n&echo\n&echo c\necho d\n");
+        old = std::cout.rdbuf(out.rdbuf());
+        err = app.batch(marked, options);
+        std::cout.rdbuf(old);
+        REQUIRE(err != clips::ok);
+        REQUIRE(out.str() == "a\nb\n");
+        REQUIRE(lines.size() == 3);
+
+        // 继续执行时报告失败的行数
+        out.str("");
+        marked.clear();
+        marked.seekg(0);
+        options.policy = clips::batch_policy_t::keep_going;
+        old = std::cout.rdbuf(out.rdbuf());
+        err = app.batch(marked, options);
+        std::cout.rdbuf(old);
+        REQUIRE(err.msg() == "batch failed. lines=1");
+        REQUIRE(out.str() == "a\nb\nc\nd\n");
+    }
+
+    SECTION("repl")
+    {
+        clips::app_t app;
+        app.name("app");
+        std::vector<int> got;
+        auto copy = clips::make_cmd("copy");
+        copy->flag<int>("depth", "d", 0, "depth");
+        copy->flag<bool>("dry", "", false, "dry run");
+        copy->bind([&](const clips::pcmd_t& pcmd, const clips::args_view_t& args) -> clips::error_t
+        {
+            got.push_back(pcmd->cast<int>("--depth"));
+            return clips::ok;
+        });
+        auto commit = clips::make_cmd("commit");
+        REQUIRE(app.bind(copy) == clips::ok);
+        REQUIRE(app.bind(commit) == clips::ok);
+
+        // 每行独立解析，上一行的值不会残留；出错后继续，exit之后的行不再执行
+        std::istringstream in("copy --depth 3\n\ncopy --depth=x\ncopy 'a\ncopy\nexit\ncopy -d 5\n");
+        std::ostringstream out;
+        REQUIRE(app.repl(in, out) == clips::ok);
+        REQUIRE(got.size() == 2);
+        REQUIRE(got[0] == 3);
+        REQUIRE(got[1] == 0);
+        REQUIRE(out.str().find("parse failed") != std::string::npos);
+        REQUIRE(out.str().find("unterminated quote") != std::string::npos);
+
+        // 补全来自命令表
+        std::vector<std::string> cands;
+        app.complete("co", cands);
+        REQUIRE(cands.size() == 2);
+        REQUIRE(cands[0] == "commit");
+        app.complete("copy --d", cands);
+        REQUIRE(cands.size() == 2);
+        REQUIRE(cands[0] == "--depth");
+        REQUIRE(cands[1] == "--dry");
+        app.complete("copy ", cands);
+        REQUIRE(cands.empty());
+        app.complete("copy arg --h", cands);
+        REQUIRE(cands.size() == 1);
+        REQUIRE(cands[0] == "--help");
+
+        // 和执行时一样切分，引号内的空白不分隔参数
+        app.complete("copy \"a b\" --d", cands);
+        REQUIRE(cands.size() == 2);
+        app.complete("copy 'a --d", cands);
+        REQUIRE(cands.empty());
+    }
+
+#ifdef __linux__
+    SECTION("serve")
+    {
+        clips::app_t app;
+        app.name("app");
+        std::atomic<int> calls{ 0 };
+        auto echo = clips::make_cmd("echo");
+        echo->flag<int>("num", "n", 0, "num");
+        echo->bind([&](const clips::pcmd_t& pcmd, const clips::args_view_t& args) -> clips::error_t
+        {
+            calls++;
+            clips::out() << args.str(0) << pcmd->cast<int>("--num") << std::endl;
+            return clips::ok;
+        });
+        REQUIRE(app.bind(echo) == clips::ok);
+        std::promise<void> release;
+        auto released = release.get_future().share();
+        auto wait = clips::make_cmd("wait");
+        wait->bind([released](const clips::pcmd_t& pcmd, const clips::args_view_t& args) -> clips::error_t
+        {
+            released.wait();
+            clips::out() << "done" << std::endl;
+            return clips::ok;
+        });
+        REQUIRE(app.bind(wait) == clips::ok);
+        clips::pool_t pool(2);
+        app.executor(&pool);
+
+        // 不删除已经存在的普通文件
+        const char* data = "clips_serve_test.db";
+        {
+            std::ofstream file(data);
+            file << "data";
+        }
+        clips::server_t refused;
+        REQUIRE(refused.listen(data) != clips::ok);
+        REQUIRE(std::ifstream(data).good());
+        std::remove(data);
+
+        // 替换没有服务在监听的残留socket文件
+        const char* path = "clips_serve_test.sock";
+        {
+            struct sockaddr_un addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            strcpy(addr.sun_path, path);
+            int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            REQUIRE(::bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0);
+            ::close(fd);
+        }
+        clips::server_t server;
+        REQUIRE(server.listen(path) == clips::ok);
+        struct stat st;
+        REQUIRE(::lstat(path, &st) == 0);
+        REQUIRE((st.st_mode & 0777) == 0600);
+
+        // 还有服务在监听时不替换
+        clips::server_t second;
+        REQUIRE(second.listen(path) != clips::ok);
+        std::thread loop([&]()
+        {
+            app.serve(server);
+        });
+
+        std::ostringstream out;
+        std::ostringstream err;
+        clips::views_t argv{ "echo", "a", "-n", "3" };
+        REQUIRE(clips::forward(path, argv, out, err) == 0);
+        REQUIRE(out.str() == "a3\n");
+        REQUIRE(err.str().empty());
+
+        // 每次请求独立解析，出错时返回错误信息和退出码
+        out.str("");
+        argv = { "echo", "b", "--num=x" };
+        REQUIRE(clips::forward(path, argv, out, err) == 1);
+        REQUIRE(out.str().empty());
+        REQUIRE(err.str().find("parse failed") != std::string::npos);
+
+        argv = { "echo", "c" };
+        out.str("");
+        REQUIRE(clips::forward(path, argv, out, err) == 0);
+        REQUIRE(out.str() == "c0\n");
+
+        // 执行中的命令不阻塞事件循环，其他请求照常返回
+        std::ostringstream wait_out;
+        std::ostringstream wait_err;
+        int wait_code = -1;
+        std::thread waiting([&]()
+        {
+            clips::views_t wait_argv{ "wait" };
+            wait_code = clips::forward(path, wait_argv, wait_out, wait_err);
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        argv = { "echo", "d" };
+        out.str("");
+        REQUIRE(clips::forward(path, argv, out, err) == 0);
+        REQUIRE(out.str() == "d0\n");
+        release.set_value();
+        waiting.join();
+        REQUIRE(wait_code == 0);
+        REQUIRE(wait_out.str() == "done\n");
+
+        server.stop();
+        loop.join();
+        REQUIRE(calls == 3);
+        REQUIRE(clips::forward(path, argv, out, err) == -1);
+    }
+#endif
+
+    SECTION("async")
+    {
+        clips::app_t app;
+        app.name("app");
+
+        // 异步命令函数在其他线程中完成
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        auto fetch = clips::make_cmd("fetch");
+        fetch->flag<int>("num", "n", 0, "num");
+        fetch->bind([&](const clips::pcmd_t& pcmd, const clips::args_view_t& args, const clips::done_t& done)
+        {
+            auto num = pcmd->cast<int>("--num");
+            std::lock_guard<std::mutex> lock(mutex);
+            workers.emplace_back([num, done]()
+            {
+                done(num < 0 ? clips::make_error("negative") : clips::ok);
+            });
+        });
+        std::atomic<int> sync{ 0 };
+        auto count = clips::make_cmd("count");
+        count->bind([&](const clips::pcmd_t& pcmd, const clips::args_t& args) -> clips::error_t
+        {
+            sync++;
+            return clips::ok;
+        });
+        REQUIRE(app.bind(fetch) == clips::ok);
+        REQUIRE(app.bind(count) == clips::ok);
+        REQUIRE(fetch->is_async());
+        REQUIRE_FALSE(count->is_async());
+
+        auto future = app.exec_async("fetch --num=3");
+        REQUIRE(future.get() == clips::ok);
+        REQUIRE(app.exec_async("fetch --num=-1").get() != clips::ok);
+        REQUIRE(app.exec_async("fetch --num=x").get() != clips::ok);
+
+        // 同步执行时等待异步命令函数完成
+        REQUIRE(app.exec("fetch -n 1") == clips::ok);
+        REQUIRE(app.exec("fetch -n -1") != clips::ok);
+
+        // 其他线程中的延续通过bind_context读取flag，重复调用done时只有第一次有效
+        std::atomic<int> relayed{ -1 };
+        auto relay = clips::make_cmd("relay");
+        relay->flag<int>("num", "n", 0, "num");
+        relay->bind([&](const clips::pcmd_t& pcmd, const clips::args_view_t& args, const clips::done_t& done)
+        {
+            auto next = clips::bind_context([pcmd, done, &relayed]()
+            {
+                relayed = pcmd->cast<int>("--num");
+                done(clips::ok);
+                done(clips::make_error("twice"));
+            });
+            std::lock_guard<std::mutex> lock(mutex);
+            workers.emplace_back(next);
+        });
+        REQUIRE(app.bind(relay) == clips::ok);
+        REQUIRE(app.freeze() == clips::ok);
+        REQUIRE(app.exec("relay -n 5") == clips::ok);
+        REQUIRE(relayed == 5);
+        REQUIRE(app.exec_async("relay -n 6").get() == clips::ok);
+        REQUIRE(relayed == 6);
+
+        // 同步命令函数交给执行器执行
+        clips::pool_t pool(2);
+        app.executor(&pool);
+        REQUIRE(app.executor() == &pool);
+        std::atomic<int> done{ 0 };
+        for (int i = 0; i < 16; i++)
+        {
+            app.exec_async("count", [&](const clips::error_t& err)
+            {
+                if (err == clips::ok)
+                {
+                    done++;
+                }
+            });
+        }
+        REQUIRE(app.exec_async("count").get() == clips::ok);
+        while (done.load() != 16)
+        {
+            std::this_thread::yield();
+        }
+        REQUIRE(sync.load() == 17);
+        app.executor(nullptr);
+
+        // 忙碌线程队列中的任务被空闲线程窃取，析构时处理完所有任务
+        std::atomic<int> ran{ 0 };
+        {
+            clips::pool_t uneven(4);
+            uneven.push([&]() { std::this_thread::sleep_for(std::chrono::milliseconds(20)); ran++; });
+            for (int i = 0; i < 399; i++)
+            {
+                uneven.push([&]() { ran++; });
+            }
+        }
+        REQUIRE(ran.load() == 400);
+
+        // 排在阻塞的任务之后的任务总能被另一个线程取走，不会错过唤醒
+        int stolen = 0;
+        for (int round = 0; round < 200; round++)
+        {
+            std::atomic<bool> release{ false };
+            std::atomic<bool> behind{ false };
+            clips::pool_t pair(2);
+            pair.push([&]() { while (!release.load()) { std::this_thread::yield(); } });
+            pair.push([]() {});
+            pair.push([&]() { behind = true; });
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+            while (!behind.load() && std::chrono::steady_clock::now() < deadline)
+            {
+                std::this_thread::yield();
+            }
+            stolen += behind.load() ? 1 : 0;
+            release = true;
+        }
+        REQUIRE(stolen == 200);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& item : workers)
+        {
+            item.join();
+        }
+    }
+
+    SECTION("parse result")
+    {
+        clips::app_t app;
+        app.name("app");
+        std::vector<std::string> got;
+        auto copy = clips::make_cmd("copy");
+        copy->flag<int>("depth", "d", 0, "depth");
+        copy->flag<std::string>("mode", "m", "fast", "mode");
+        copy->flag<bool>("force", "f", false, "force");
+        copy->bind([&](const clips::pcmd_t& pcmd, const clips::args_t& args) -> clips::error_t
+        {
+            got.push_back(std::to_string(pcmd->cast<int>("--depth")) + pcmd->cast<std::string>("--mode")
+                + (pcmd->cast<bool>("--force") ? "f" : "") + (args.empty() ? "" : args[0]));
+            return clips::ok;
+        });
+        REQUIRE(app.bind(copy) == clips::ok);
+
+        // 只解析，不执行
+        clips::parse_result_t result;
+        REQUIRE(app.parse("copy -d 3 --force a.txt", result) == clips::ok);
+        REQUIRE(got.empty());
+        REQUIRE(result.node() == app.table()->find_sub(0, "copy", 4));
+        REQUIRE(result.args().size() == 1);
+        REQUIRE(result.args()[0] == "a.txt");
+        auto depth = copy->flags().at("--depth");
+        auto mode = copy->flags().at("--mode");
+        REQUIRE(result.exist(depth));
+        REQUIRE_FALSE(result.exist(mode));
+        REQUIRE(result.flags().size() == 2);
+        REQUIRE(*result.value<int>(depth) == 3);
+        REQUIRE(result.value<std::string>(depth) == nullptr);
+        REQUIRE(app.parse("copy -d x", result) != clips::ok);
+
+        // 重复执行
+        REQUIRE(app.exec(result) == clips::ok);
+        REQUIRE(app.exec(result) == clips::ok);
+        REQUIRE(got.size() == 2);
+        REQUIRE(got[1] == "3fastfa.txt");
+
+        // 序列化
+        std::string data;
+        result.serialize(data);
+        clips::parse_result_t loaded;
+        REQUIRE(loaded.deserialize(data, app.table()) == clips::ok);
+        REQUIRE(*loaded.value<int>(depth) == 3);
+        REQUIRE(app.exec(loaded) == clips::ok);
+        REQUIRE(got.back() == "3fastfa.txt");
+        REQUIRE(loaded.deserialize(data.substr(0, data.size() - 1), app.table()) != clips::ok);
+
+        // 缓存命中时直接使用解析结果
+        app.cache(2);
+        got.clear();
+        REQUIRE(app.exec("copy -d 1 -m safe x") == clips::ok);
+        REQUIRE(app.exec("copy -d 1 -m safe x") == clips::ok);
+        REQUIRE(app.exec("copy -d 2") == clips::ok);
+        REQUIRE(app.exec("copy -d 1 -m safe x") == clips::ok);
+        REQUIRE(app.exec("copy -d x") != clips::ok);
+        REQUIRE(got.size() == 4);
+        REQUIRE(got[1] == "1safex");
+        REQUIRE(got[3] == "1safex");
+        REQUIRE(app.cache()->hits() == 2);
+        REQUIRE(app.cache()->size() == 2);
+        REQUIRE(app.exec("copy -d 3") == clips::ok);
+        REQUIRE(app.cache()->size() == 2);
+
+        // 重新freeze之后旧的结果失效
+        REQUIRE(app.freeze() == clips::ok);
+        REQUIRE(app.exec(result) != clips::ok);
+        REQUIRE(app.exec("copy -d 1 -m safe x") == clips::ok);
+        REQUIRE(got.back() == "1safex");
+        app.cache(0);
+        REQUIRE(app.cache() == nullptr);
+    }
+
+    SECTION("abbrev")
+    {
+        clips::app_t app;
+        app.name("app");
+        std::string got;
+        auto remote = clips::make_cmd("remote");
+        auto rename = clips::make_cmd("rename");
+        auto set_url = clips::make_cmd("set-url");
+        set_url->flag<bool>("verbose", "v", false, "verbose");
+        set_url->flag<int>("version", "", 0, "version");
+        set_url->flag<int>("depth", "d", 0, "depth");
+        set_url->bind([&](const clips::pcmd_t& pcmd, const clips::args_t& args) -> clips::error_t
+        {
+            got = std::to_string(pcmd->cast<int>("--depth")) + (args.empty() ? "" : args[0]);
+            return clips::ok;
+        });
+        REQUIRE(remote->bind(set_url) == clips::ok);
+        REQUIRE(app.bind(remote) == clips::ok);
+        REQUIRE(app.bind(rename) == clips::ok);
+        REQUIRE(app.freeze() == clips::ok);
+
+        // 基数树的精确查找和候选
+        auto& table = *app.table();
+        REQUIRE(table.find_sub(0, "remote", 6) != clips::invalid_id);
+        REQUIRE(table.find_sub(0, "rem", 3) == clips::invalid_id);
+        REQUIRE(table.find_sub(0, "rem", 3, true) == table.find_sub(0, "remote", 6));
+        REQUIRE(table.find_sub(0, "re", 2, true) == clips::invalid_id);
+        REQUIRE(table.find_sub(0, "remotes", 7, true) == clips::invalid_id);
+        std::vector<std::string> names;
+        REQUIRE(table.candidates(0, "re", names));
+        REQUIRE(names.size() == 2);
+        REQUIRE(names[0] == "remote");
+        REQUIRE_FALSE(table.candidates(0, "remx", names));
+        REQUIRE(names.size() == 1);
+        REQUIRE(names[0] == "remote");
+        REQUIRE_FALSE(table.candidates(0, "x", names));
+        REQUIRE(names.empty());
+
+        // 默认不接受缩写，未定义的标记带上候选
+        REQUIRE(app.exec("rem set-url") != clips::ok); // 根命令收到参数，没有函数
+        REQUIRE(got.empty());
+        auto err = app.exec("remote set-url --dep 1");
+        REQUIRE(err.msg() == "undefined flag. candidates: --depth");
+
+        app.abbrev(true);
+        REQUIRE(app.exec("rem set --dep 3 x") == clips::ok);
+        REQUIRE(got == "3x");
+        REQUIRE(app.exec("remote set-url --verb") == clips::ok);
+        err = app.exec("r set-url");
+        REQUIRE(err.msg() == "ambiguous cmd. candidates: remote, rename");
+        err = app.exec("remote set-url --ver");
+        REQUIRE(err.msg() == "ambiguous flag. candidates: --verbose, --version");
+
+        // 不是任何名称的前缀时不接受
+        err = app.exec("remote set-url --verbosx");
+        REQUIRE(err.msg() == "undefined flag. did you mean: --verbose");
+        REQUIRE(app.exec("remote set-url --vxyz") != clips::ok);
+
+        // 空的名称不是缩写，即使只有一个子命令
+        REQUIRE(table.find_sub(table.find_sub(0, "remote", 6), "", 0, true) == clips::invalid_id);
+        got.clear();
+        app.exec("remote ");
+        REQUIRE(got.empty());
+    }
+
+    SECTION("suggest")
+    {
+        clips::app_t app;
+        app.name("app");
+        auto remote = clips::make_cmd("remote");
+        auto status = clips::make_cmd("status");
+        status->flag<int>("depth", "d", 0, "depth");
+        status->flag<bool>("verbose", "", false, "verbose");
+        status->bind([](const clips::pcmd_t& pcmd, const clips::args_t& args) -> clips::error_t
+        {
+            return clips::ok;
+        });
+        REQUIRE(app.bind(remote) == clips::ok);
+        REQUIRE(app.bind(status) == clips::ok);
+        REQUIRE(app.freeze() == clips::ok);
+
+        std::vector<std::string> names;
+        app.table()->suggest(0, "stauts", names);
+        REQUIRE(names.size() == 1);
+        REQUIRE(names[0] == "status");
+        app.table()->suggest(0, "xyz", names);
+        REQUIRE(names.empty());
+
+        // 有子命令但是没有函数的命令，未知的子命令是错误
+        auto err = app.exec("stats");
+        REQUIRE(err.msg() == "undefined cmd. did you mean: status");
+        REQUIRE(err.stack() == "app stats");
+        err = app.exec("xyz");
+        REQUIRE(err.msg() == "undefined cmd.");
+
+        // 标记的拼写建议包括继承的标记
+        err = app.exec("status --dpeth 1");
+        REQUIRE(err.msg() == "undefined flag. did you mean: --depth");
+        err = app.exec("status --hlep");
+        REQUIRE(err.msg() == "undefined flag. did you mean: --help");
+        REQUIRE(app.exec("status a b") == clips::ok);
+    }
+
+    SECTION("completion")
+    {
+        clips::app_t app;
+        app.name("app");
+        auto copy = clips::make_cmd("copy");
+        copy->flag<int>("depth", "d", 0, "depth");
+        copy->flag<std::string>("mode", "m", "fast", { "safe", "fast" }, "mode", false);
+        copy->flag<bool>("force", "f", false, "force");
+        auto remote = clips::make_cmd("remote");
+        auto add = clips::make_cmd("add");
+        REQUIRE(remote->bind(add) == clips::ok);
+        REQUIRE(app.bind(copy) == clips::ok);
+        REQUIRE(app.bind(remote) == clips::ok);
+        REQUIRE(app.builtins(clips::builtin_t::all) == clips::ok);
+        REQUIRE(app.freeze() == clips::ok);
+
+        // 标记的值：可选项，--flag=形式同样补全；值不会被当作命令参数
+        std::vector<std::string> cands;
+        app.complete("copy --mode ", cands);
+        REQUIRE(cands.size() == 2);
+        REQUIRE(cands[0] == "fast");
+        app.complete("copy -m s", cands);
+        REQUIRE(cands.size() == 1);
+        REQUIRE(cands[0] == "safe");
+        app.complete("copy --mode=f", cands);
+        REQUIRE(cands.size() == 1);
+        REQUIRE(cands[0] == "--mode=fast");
+        app.complete("copy --depth 3 --f", cands);
+        REQUIRE(cands.size() == 1);
+        REQUIRE(cands[0] == "--force");
+        app.complete("--jobs 2 rem", cands);
+        REQUIRE(cands.size() == 1);
+        REQUIRE(cands[0] == "remote");
+
+        // 隐藏的补全入口
+        std::ostringstream out;
+        std::ostringstream err;
+        clips::views_t words{ "__complete", "remote", "" };
+        REQUIRE(app.dispatch(words, out, err) == 0);
+        REQUIRE(out.str() == "add\n");
+
+        // 静态补全脚本
+        std::ostringstream bash;
+        REQUIRE(app.completion("bash", bash) == clips::ok);
+        REQUIRE(bash.str().find("complete -o default -F _app_complete app") != std::string::npos);
+        REQUIRE(bash.str().find("'2:add') node=3 ;;") != std::string::npos);
+        REQUIRE(bash.str().find("'1:--mode') list='fast safe' ;;") != std::string::npos);
+        std::ostringstream zsh;
+        REQUIRE(app.completion("zsh", zsh) == clips::ok);
+        REQUIRE(zsh.str().find("#compdef app") == 0);
+        REQUIRE(app.completion("fish", zsh) != clips::ok);
+    }
+
+    SECTION("help")
+    {
+        clips::app_t app;
+        app.name("app");
+        auto zoo = clips::make_cmd("zoo");
+        zoo->brief("zoo brief");
+        auto bar = clips::make_cmd("bar");
+        bar->brief("bar brief");
+        bar->flag<int>("zeta", "z", 0, "zeta");
+        bar->flag<int>("alpha", "a", 0, "alpha");
+        REQUIRE(app.bind(zoo) == clips::ok);
+        REQUIRE(app.bind(bar) == clips::ok);
+
+        auto help = [&app](const std::string& line) -> std::string
+        {
+            std::ostringstream out;
+            std::ostringstream err;
+            clips::views_t words;
+            clips::utils::split_blank(words, line);
+            app.dispatch(words, out, err);
+            return out.str();
+        };
+
+        // 命令和标记按名称排序
+        REQUIRE(app.freeze() == clips::ok);
+        auto text = help("-h");
+        REQUIRE(text.find("bar brief") < text.find("zoo brief"));
+        text = help("bar --help");
+        REQUIRE(text.find("--alpha") < text.find("--help"));
+        REQUIRE(text.find("--help") < text.find("--zeta"));
+
+        // 缓存的结果与第一次相同；重新freeze之后重新生成
+        REQUIRE(help("bar --help") == text);
+        bar->brief("changed");
+        REQUIRE(help("-h").find("changed") == std::string::npos);
+        REQUIRE(app.freeze() == clips::ok);
+        REQUIRE(help("-h").find("changed") != std::string::npos);
+        app.name("other");
+        REQUIRE(help("-h").find("other [cmds...] -h") != std::string::npos);
+    }
+
+    SECTION("scope")
+    {
+        clips::app_t app;
+        app.name("app");
+        auto a = clips::make_cmd("a");
+        auto b = clips::make_cmd("b");
+        auto c = clips::make_cmd("c");
+        a->flag<int>("level", "l", 1, "level", true);
+        a->flag<bool>("local", "o", false, "local");
+        b->flag<int>("depth", "d", 2, "depth", true);
+        c->flag<std::string>("name", "n", "", "name");
+        c->bind([](const clips::pcmd_t& pcmd, const clips::args_t& args) -> clips::error_t
+        {
+            return clips::ok;
+        });
+        REQUIRE(b->bind(c) == clips::ok);
+        REQUIRE(a->bind(b) == clips::ok);
+        REQUIRE(app.bind(a) == clips::ok);
+        REQUIRE(app.freeze() == clips::ok);
+
+        // 合并视图包括沿分支继承的标记，不包括上级命令不可继承的标记
+        auto ids = app.table()->visible(3);
+        std::vector<std::string> names;
+        for (auto id : ids)
+        {
+            names.push_back(app.table()->flag(id)->name());
+        }
+        REQUIRE(names == std::vector<std::string>({ "depth", "help", "level", "name" }));
+        REQUIRE(app.exec("a b c -l 3 --depth 4 -n x") == clips::ok);
+        REQUIRE(app.exec("a b c --local").msg() == "undefined flag.");
+        REQUIRE(app.exec("a b c -o").msg() == "undefined flag.");
+    }
+
+    SECTION("short bundle")
+    {
+        clips::app_t app;
+        app.name("app");
+        std::string got;
+        auto tar = clips::make_cmd("tar");
+        tar->flag<bool>("extract", "x", false, "extract", true);
+        tar->flag<bool>("verbose", "v", false, "verbose");
+        tar->flag<std::string>("file", "f", "", "file");
+        tar->flag<int>("level", "n", 0, "level");
+        tar->bind([&](const clips::pcmd_t& pcmd, const clips::args_t& args) -> clips::error_t
+        {
+            got = std::string(pcmd->cast<bool>("--extract") ? "x" : "") + (pcmd->cast<bool>("--verbose") ? "v" : "")
+                + pcmd->cast<std::string>("--file") + std::to_string(pcmd->cast<int>("--level"));
+            return clips::ok;
+        });
+        REQUIRE(app.bind(tar) == clips::ok);
+
+        REQUIRE(app.exec("tar -xvf a.tar") == clips::ok);
+        REQUIRE(got == "xva.tar0");
+        REQUIRE(app.exec("tar -n5") == clips::ok);
+        REQUIRE(got == "5");
+        REQUIRE(app.exec("tar -vn=7 -fb.tar") == clips::ok);
+        REQUIRE(got == "vb.tar7");
+        REQUIRE(app.exec("tar -n 3") == clips::ok);
+        REQUIRE(got == "3");
+
+        REQUIRE(app.exec("tar -xq").msg() == "undefined flag. fast=q");
+        REQUIRE(app.exec("tar -xf").msg() == "no value of flag ");
+        REQUIRE(app.exec("tar -xf -v").msg() == "no value of flag.");
+        REQUIRE(app.exec("tar -nx") != clips::ok);
+
+        // 快捷名称只能是ASCII字符
+        auto bad = clips::make_cmd("bad");
+        REQUIRE(bad->flag<int>("wide", "\xe4", 0, "wide") != clips::ok);
+    }
+
+    SECTION("list flag")
+    {
+        clips::app_t app;
+        app.name("app");
+        std::vector<int> ids;
+        std::vector<std::string> tags;
+        auto run = clips::make_cmd("run");
+        run->flag<std::vector<int>>("ids", "i", std::vector<int>{ 7 }, "ids");
+        run->pflag<std::vector<std::string>>(&tags, "tag", "t", std::vector<std::string>(), "tags");
+        run->bind([&](const clips::pcmd_t& pcmd, const clips::args_t& args) -> clips::error_t
+        {
+            ids = pcmd->cast<std::vector<int>>("--ids");
+            return clips::ok;
+        });
+        REQUIRE(app.bind(run) == clips::ok);
+
+        REQUIRE(app.exec("run") == clips::ok);
+        REQUIRE(ids == std::vector<int>({ 7 }));
+        REQUIRE(run->flags().at("--ids")->default_value() == "7");
+
+        // 分隔的值和重复的标记，重复时追加而不是覆盖
+        REQUIRE(app.exec("run --ids=1,2,3 -i 4 --tag a -t b,c") == clips::ok);
+        REQUIRE(ids == std::vector<int>({ 1, 2, 3, 4 }));
+        REQUIRE(tags == std::vector<std::string>({ "a", "b", "c" }));
+        REQUIRE(app.exec("run --ids=") == clips::ok);
+        REQUIRE(ids.empty());
+        REQUIRE(app.exec("run --ids=1,x").msg().find("parse failed.") == 0);
+
+        // 解析结果的文本包括重复的值
+        clips::parse_result_t result;
+        REQUIRE(app.parse("run --ids 1 --ids 2,3", result) == clips::ok);
+        std::string data;
+        result.serialize(data);
+        clips::parse_result_t loaded;
+        REQUIRE(loaded.deserialize(data, app.table()) == clips::ok);
+        REQUIRE(*loaded.value<std::vector<int>>(run->flags().at("--ids")) == std::vector<int>({ 1, 2, 3 }));
+
+        std::string text;
+        for (int i = 0; i < 100000; i++)
+        {
+            text.append(i == 0 ? "" : ",").append(std::to_string(i));
+        }
+        REQUIRE(app.exec("run --ids=" + text) == clips::ok);
+        REQUIRE(ids.size() == 100000);
+        REQUIRE(ids.back() == 99999);
+    }
+
+    SECTION("response file")
+    {
+        clips::app_t app;
+        app.name("app");
+        std::vector<std::string> got;
+        auto copy = clips::make_cmd("copy");
+        copy->flag<int>("depth", "d", 0, "depth");
+        copy->bind([&](const clips::pcmd_t& pcmd, const clips::args_t& args) -> clips::error_t
+        {
+            got = args;
+            got.push_back(std::to_string(pcmd->cast<int>("--depth")));
+            return clips::ok;
+        });
+        REQUIRE(app.bind(copy) == clips::ok);
+
+        {
+            std::ofstream outer("clips_outer.rsp");
+            outer << "# generated\ncopy -d 2 'a b'\n@clips_inner.rsp\n";
+            std::ofstream inner("clips_inner.rsp");
+            inner << "\"c\\\"d\" e";
+        }
+        REQUIRE(app.exec("@clips_outer.rsp f") == clips::ok);
+        REQUIRE(got == std::vector<std::string>({ "a b", "c\"d", "e", "f", "2" }));
+
+        // 文件不存在时保留原参数
+        REQUIRE(app.exec("copy @clips_none.rsp") == clips::ok);
+        REQUIRE(got[0] == "@clips_none.rsp");
+
+        // 循环引用
+        {
+            std::ofstream inner("clips_inner.rsp");
+            inner << "@./clips_outer.rsp";
+        }
+        REQUIRE(app.exec("@clips_outer.rsp").msg() == "error: response file cycle.");
+        {
+            std::ofstream inner("clips_inner.rsp");
+            inner << "'x";
+        }
+        REQUIRE(app.exec("@clips_outer.rsp").msg() == "error: unterminated quote in response file.");
+        std::remove("clips_outer.rsp");
+        std::remove("clips_inner.rsp");
+    }
+
+#ifndef _WIN32
+    SECTION("sources")
+    {
+        clips::app_t app;
+        app.name("app");
+        std::string got;
+        auto copy = clips::make_cmd("copy");
+        copy->flag<int>("depth", "d", 0, "depth");
+        copy->flag<std::string>("dry-run", "", "no", "dry run");
+        copy->flag<std::string>("mode", "m", "fast", "mode", true);
+        copy->bind([&](const clips::pcmd_t& pcmd, const clips::args_t& args) -> clips::error_t
+        {
+            got = std::to_string(pcmd->cast<int>("--depth")) + pcmd->cast<std::string>("--mode")
+                + pcmd->cast<std::string>("--dry-run") + (pcmd->flags().at("--depth")->exist() ? "!" : "");
+            return clips::ok;
+        });
+        REQUIRE(app.bind(copy) == clips::ok);
+
+        const char* path = "clips_sources.ini";
+        {
+            std::ofstream ofs(path);
+            ofs << "# defaults\n[copy]\ndepth = 3\nmode = \"slow\"\n; comment\ndry-run=yes\n";
+        }
+        REQUIRE(app.config(path) == clips::ok);
+        ::setenv("CLIPSTEST_MODE", "env", 1);
+        ::setenv("CLIPSTEST_DRY_RUN", "maybe", 1);
+        REQUIRE(app.env("CLIPSTEST") == clips::ok);
+
+        // 默认值 < 配置文件 < 环境变量 < 命令参数
+        REQUIRE(app.exec("copy") == clips::ok);
+        REQUIRE(got == "3envmaybe");
+        REQUIRE(app.exec("copy -d 5 --mode cli") == clips::ok);
+        REQUIRE(got == "5climaybe!");
+
+        REQUIRE(app.env("") == clips::ok);
+        REQUIRE(app.exec("copy") == clips::ok);
+        REQUIRE(got == "3slowyes");
+
+        // 配置文件中的错误在加载时报告
+        {
+            std::ofstream ofs(path);
+            ofs << "[copy]\ndepth = x\n";
+        }
+        REQUIRE(app.config(path).stack() == std::string(path) + ":2");
+        {
+            std::ofstream ofs(path);
+            ofs << "[copy]\ndepht = 1\n";
+        }
+        REQUIRE(app.config(path).msg() == "error: undefined flag in config.");
+        {
+            std::ofstream ofs(path);
+            ofs << "[move]\n";
+        }
+        REQUIRE(app.config(path).msg() == "error: undefined cmd in config.");
+        REQUIRE(app.config("") == clips::ok);
+        REQUIRE(app.exec("copy") == clips::ok);
+        REQUIRE(got == "0fastno");
+
+        // 只应用解析到的命令可见的标记
+        auto move = clips::make_cmd("move");
+        move->flag<int>("level", "l", 0, "level");
+        move->flag<std::string>("depth", "", "-", "depth");
+        move->bind([&](const clips::pcmd_t& pcmd, const clips::args_t& args) -> clips::error_t
+        {
+            got = pcmd->cast<std::string>("--depth") + std::to_string(pcmd->cast<int>("--level"));
+            return clips::ok;
+        });
+        REQUIRE(app.bind(move) == clips::ok);
+        REQUIRE(app.freeze() == clips::ok);
+        {
+            std::ofstream ofs(path);
+            ofs << "[copy]\ndepth = 3\n";
+        }
+        REQUIRE(app.config(path) == clips::ok);
+        clips::parse_result_t result;
+        REQUIRE(app.parse("move -l 2", result) == clips::ok);
+        std::string data;
+        result.serialize(data);
+        clips::parse_result_t loaded;
+        REQUIRE(loaded.deserialize(data, app.table()) == clips::ok);
+        REQUIRE(app.exec(loaded) == clips::ok);
+        REQUIRE(got == "-2");
+
+        // 同名标记类型不同时，环境变量只应用到能转换的标记
+        ::setenv("CLIPSTEST_DEPTH", "deep", 1);
+        REQUIRE(app.env("CLIPSTEST") == clips::ok);
+        REQUIRE(app.exec("move") == clips::ok);
+        REQUIRE(got == "deep0");
+        REQUIRE(app.exec("copy") == clips::ok);
+        REQUIRE(got == "3envmaybe");
+        ::unsetenv("CLIPSTEST_DEPTH");
+        REQUIRE(app.env("") == clips::ok);
+        REQUIRE(app.config("") == clips::ok);
+        ::unsetenv("CLIPSTEST_MODE");
+        ::unsetenv("CLIPSTEST_DRY_RUN");
+        std::remove(path);
+    }
+#endif
+
+    SECTION("lazy")
+    {
+        clips::app_t app;
+        app.name("app");
+        app.lazy(true);
+        int bound = 0;
+        std::string got;
+        auto run = clips::make_cmd("run");
+        run->flag<int>("depth", "d", 1, "depth");
+        run->flag<int>("level", "l", 2, std::vector<int>{ 2, 4 }, "level");
+        run->flag<std::vector<int>>("ids", "i", std::vector<int>(), "ids");
+        run->pflag<int>(&bound, "bound", "b", 0, "bound");
+        run->bind([&](const clips::pcmd_t& pcmd, const clips::args_t& args) -> clips::error_t
+        {
+            got = "b" + std::to_string(bound);
+            if (args.empty())
+            {
+                got += "d" + std::to_string(pcmd->cast<int>("--depth"));
+                got += "n" + std::to_string(pcmd->cast<std::vector<int>>("--ids").size());
+            }
+            return clips::ok;
+        });
+        REQUIRE(app.bind(run) == clips::ok);
+        int failed = 0;
+        auto twice = clips::make_cmd("twice");
+        twice->flag<int>("num", "n", 7, "num");
+        twice->bind([&](const clips::pcmd_t& pcmd, const clips::args_t& args) -> clips::error_t
+        {
+            for (int i = 0; i < 2; i++)
+            {
+                try
+                {
+                    pcmd->cast<int>("--num");
+                }
+                catch (clips::flag_cast_exception&)
+                {
+                    failed++;
+                }
+            }
+            return clips::ok;
+        });
+        REQUIRE(app.bind(twice) == clips::ok);
+
+        // 没有读取的标记不转换，也不校验
+        REQUIRE(app.exec("run -d 3 -l x -b 5 -i 1,2 -i 3") == clips::ok);
+        REQUIRE(got == "b5d3n3");
+        REQUIRE(app.exec("run -l 3 -b 0 a") == clips::ok);
+        REQUIRE(got == "b0");
+
+        // 第一次读取时转换失败
+        REQUIRE(app.exec("run -d x").msg().find("parse failed.") == 0);
+        REQUIRE(app.exec("run -b x") != clips::ok);
+
+
+        // 转换失败后每次读取都失败，不会退回默认值
+        REQUIRE(app.exec("twice -n x") == clips::ok);
+        REQUIRE(failed == 2);
+
+        // 需要提前报告错误的命令
+        run->eager(true);
+        REQUIRE(app.exec("run -l 3 a").msg() == "not one of flag options.");
+        clips::parse_result_t result;
+        run->eager(false);
+        REQUIRE(app.parse("run -l 3", result) != clips::ok);
+        REQUIRE(app.parse("run -l 4", result) == clips::ok);
+        REQUIRE(*result.value<int>(run->flags().at("--level")) == 4);
+
+        // 默认值的字符串只在需要时格式化
+        REQUIRE(run->flags().at("--level")->default_value() == "2");
+        REQUIRE(run->flags().at("--ids")->default_value() == "");
+    }
+
+    SECTION("flag ref")
+    {
+        clips::app_t app;
+        app.name("app");
+        std::atomic<int> mismatch{ 0 };
+        auto sub = clips::make_cmd("sub");
+        auto num = sub->flag<int>("num", "n", 7, "num");
+        auto mode = sub->flag<std::string>("mode", "m", "fast", { "safe", "fast" }, "mode", false);
+        REQUIRE(num == clips::ok);
+        REQUIRE(mode == clips::ok);
+        REQUIRE(num.flag() == sub->flags().at("-n"));
+        REQUIRE(sub->flag<int>("num", "", 0, "num") != clips::ok);
+        REQUIRE(sub->flag<int>("other", "m", 0, "other") != clips::ok);
+        REQUIRE(sub->flags().count("--other") == 0);
+        int other = 0;
+        REQUIRE(sub->pflag<int>(&other, "other", "m", 0, "other") != clips::ok);
+        REQUIRE(sub->flags().count("--other") == 0);
+        sub->bind([&](const clips::pcmd_t& pcmd, const clips::args_t& args) -> clips::error_t
+        {
+            if (args.size() != 1 || std::to_string(*num) != args[0] || num.exist() != (args[0] != "7"))
+            {
+                mismatch++;
+            }
+            return clips::ok;
+        });
+        REQUIRE(app.bind(sub) == clips::ok);
+
+        // 执行期间之外读取到默认值
+        REQUIRE(*num == 7);
+        REQUIRE(mode->size() == 4);
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++)
+        {
+            threads.emplace_back([&app, t]()
+            {
+                for (int i = 0; i < 100; i++)
+                {
+                    auto n = std::to_string(t * 1000 + i + 8);
+                    app.exec("sub -n " + n + " " + n);
+                }
+            });
+        }
+        for (auto& item : threads)
+        {
+            item.join();
+        }
+        REQUIRE(app.exec("sub 7") == clips::ok);
+        REQUIRE(mismatch == 0);
+
+        // 标记ID按命令表连续分配，不随其他命令树增长
+        auto limit = app.table()->flag_limit();
+        for (int i = 0; i < 100; i++)
+        {
+            clips::app_t other_app;
+            other_app.name("other");
+            auto other_cmd = clips::make_cmd("other");
+            other_cmd->flag<int>("count", "c", 0, "count");
+            other_app.bind(other_cmd);
+            other_app.freeze();
+        }
+        REQUIRE(app.freeze() == clips::ok);
+        REQUIRE(app.table()->flag_limit() == limit);
+
+        // 同一个命令绑定到两个应用，两张表中的ID各自有效
+        clips::app_t shared;
+        shared.name("shared");
+        REQUIRE(shared.bind(sub) == clips::ok);
+        REQUIRE(shared.exec("sub -n 9 9") == clips::ok);
+        REQUIRE(app.exec("sub -n 10 10") == clips::ok);
+        REQUIRE(shared.exec("sub -n 11 11") == clips::ok);
+        REQUIRE(mismatch == 0);
+
+        // 注册失败的句柄读取时抛出异常
+        clips::flag_ref<int> bad = sub->flag<int>("num", "", 0, "num");
+        REQUIRE_THROWS_AS(bad.get(), clips::flag_cast_exception);
+    }
 }
\ No newline at end of file
@@ -19,4 +19,30 @@
 
 TEST_CASE("error")
 {
+    SECTION("breadcrumb")
+    {
+        clips::app_t app;
+        app.name("app");
+        auto sub = clips::make_cmd("sub");
+        sub->flag<int>("num", "n", 0, "num");
+        sub->bind([](const clips::pcmd_t& pcmd, const clips::args_t& args) -> clips::error_t
+        {
+            return clips::make_error("failed.", pcmd->stack());
+        });
+        REQUIRE(app.bind(sub) == clips::ok);
+
+        auto err = app.exec("sub a --bad 1");
+        REQUIRE(err.msg() == "undefined flag.");
+        REQUIRE(err.stack() == "app sub a --bad");
+
+        err = app.exec("sub --num abc x");
+        REQUIRE(err.stack() == "app sub --num abc");
+
+        err = app.exec("sub --num");
+        REQUIRE(err.stack() == "app sub --num");
+
+        err = app.exec("sub a --num=1");
+        REQUIRE(err.msg() == "failed.");
+        REQUIRE(err.stack() == "app sub");
+    }
 }
\ No newline at end of file
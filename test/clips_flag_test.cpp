@@ -17,6 +17,180 @@
 
 #include "catch.hpp"
 
+// wide_t 放不进flag内部缓冲区的自定义类型
+struct wide_t
+{
+    std::string head;
+    std::string tail;
+};
+
+std::ostream& operator<<(std::ostream& os, const wide_t& obj)
+{
+    os << obj.head << ":" << obj.tail;
+    return os;
+}
+
+std::istream& operator>>(std::istream& is, wide_t& obj)
+{
+    std::getline(is, obj.head, ':');
+    std::getline(is, obj.tail);
+    return is;
+}
+
 TEST_CASE("flag")
 {
+    SECTION("convert integer")
+    {
+        int32_t i32 = 0;
+        REQUIRE(clips::convert<int32_t>::parse("-2147483648", i32));
+        REQUIRE(i32 == INT32_MIN);
+        REQUIRE(clips::convert<int32_t>::parse("+2147483647", i32));
+        REQUIRE(i32 == INT32_MAX);
+        REQUIRE(!clips::convert<int32_t>::parse("2147483648", i32));
+        REQUIRE(!clips::convert<int32_t>::parse("12abc", i32));
+        REQUIRE(!clips::convert<int32_t>::parse("", i32));
+        REQUIRE(!clips::convert<int32_t>::parse("-", i32));
+        REQUIRE(!clips::convert<int32_t>::parse(" 1", i32));
+
+        uint8_t u8 = 0;
+        REQUIRE(clips::convert<uint8_t>::parse("255", u8));
+        REQUIRE(u8 == 255);
+        REQUIRE(!clips::convert<uint8_t>::parse("256", u8));
+        REQUIRE(!clips::convert<uint8_t>::parse("-1", u8));
+
+        int8_t i8 = 0;
+        REQUIRE(clips::convert<int8_t>::parse("-128", i8));
+        REQUIRE(i8 == -128);
+        REQUIRE(!clips::convert<int8_t>::parse("128", i8));
+
+        int64_t i64 = 0;
+        REQUIRE(clips::convert<int64_t>::parse("-9223372036854775808", i64));
+        REQUIRE(i64 == INT64_MIN);
+        REQUIRE(!clips::convert<int64_t>::parse("9223372036854775808", i64));
+
+        uint64_t u64 = 0;
+        REQUIRE(clips::convert<uint64_t>::parse("18446744073709551615", u64));
+        REQUIRE(u64 == UINT64_MAX);
+        REQUIRE(!clips::convert<uint64_t>::parse("18446744073709551616", u64));
+        REQUIRE(!clips::convert<uint64_t>::parse("-0", u64));
+    }
+
+    SECTION("convert float")
+    {
+        double d = 0;
+        REQUIRE(clips::convert<double>::parse("1.5", d));
+        REQUIRE(d == 1.5);
+        REQUIRE(clips::convert<double>::parse("-.25e2", d));
+        REQUIRE(d == -25.0);
+        REQUIRE(clips::convert<double>::parse("3.", d));
+        REQUIRE(d == 3.0);
+        REQUIRE(clips::convert<double>::parse("0.1", d));
+        REQUIRE(d == 0.1);
+        REQUIRE(clips::convert<double>::parse("1e300", d));
+        REQUIRE(d == 1e300);
+        REQUIRE(clips::convert<double>::parse("123456789012345678901234567890", d));
+        REQUIRE(d == 123456789012345678901234567890.0);
+        REQUIRE(!clips::convert<double>::parse("1e400", d));
+        REQUIRE(!clips::convert<double>::parse("1.5x", d));
+        REQUIRE(!clips::convert<double>::parse(".", d));
+        REQUIRE(!clips::convert<double>::parse("1e", d));
+
+        float f = 0;
+        REQUIRE(clips::convert<float>::parse("0.5", f));
+        REQUIRE(f == 0.5f);
+        REQUIRE(!clips::convert<float>::parse("1e39", f));
+    }
+
+    SECTION("convert others")
+    {
+        bool b = false;
+        REQUIRE(clips::convert<bool>::parse("true", b));
+        REQUIRE(b);
+        REQUIRE(clips::convert<bool>::parse("0", b));
+        REQUIRE(!b);
+        REQUIRE(!clips::convert<bool>::parse("yes", b));
+
+        char c = 0;
+        REQUIRE(clips::convert<char>::parse("x", c));
+        REQUIRE(c == 'x');
+        REQUIRE(!clips::convert<char>::parse("xy", c));
+
+        std::string str;
+        REQUIRE(clips::convert<std::string>::parse("a b", str));
+        REQUIRE(str == "a b");
+    }
+
+    SECTION("oneof")
+    {
+        std::vector<std::string> zones;
+        for (int i = 0; i < 3000; i++)
+        {
+            zones.push_back("zone-" + std::to_string(i));
+        }
+        clips::flag_t zone;
+        REQUIRE(zone.set<std::string>("zone", "z", "zone-0", zones, "zone") == clips::ok);
+        REQUIRE(zone.is_oneof("zone-2999"));
+        REQUIRE_FALSE(zone.is_oneof("zone-3000"));
+        REQUIRE(zone.ordinal("zone-1234") == 1234);
+        REQUIRE(zone.ordinal("zone") == clips::invalid_id);
+        REQUIRE(zone.parse("zone-42") == clips::ok);
+        REQUIRE(zone.cast<std::string>() == "zone-42");
+        REQUIRE(zone.parse("zone-x") != clips::ok);
+
+        clips::flag_t level;
+        REQUIRE(level.set<int>("level", "l", 1, std::vector<int>{ 1, 3, 5 }, "level") == clips::ok);
+        REQUIRE(level.parse("5") == clips::ok);
+        REQUIRE(level.cast<int>() == 5);
+        REQUIRE(level.parse("2") != clips::ok);
+
+        // 通过oneof()修改后仍然可以查找
+        level.oneof().push_back("7");
+        REQUIRE(level.is_oneof("7"));
+        REQUIRE(level.parse("7") == clips::ok);
+        REQUIRE(level.cast<int>() == 7);
+
+        // char的可选项和默认值按字符表示
+        clips::flag_t mode;
+        REQUIRE(mode.set<char>("mode", "m", 'a', std::vector<char>{ 'a', 'b' }, "mode") == clips::ok);
+        REQUIRE(mode.default_value() == "a");
+        REQUIRE(mode.is_oneof("b"));
+        REQUIRE(mode.parse("b") == clips::ok);
+        REQUIRE(mode.cast<char>() == 'b');
+        REQUIRE(mode.parse("98") != clips::ok);
+    }
+
+    SECTION("copy")
+    {
+        clips::flag_t name;
+        REQUIRE(name.set<std::string>("name", "n", std::string("a"), "name", false) == clips::ok);
+        REQUIRE(name.parse("b") == clips::ok);
+        clips::flag_t ids;
+        REQUIRE(ids.set<std::vector<int>>("ids", "i", std::vector<int>{ 1 }, "ids") == clips::ok);
+        clips::flag_t wide;
+        REQUIRE(wide.set<wide_t>("wide", "w", wide_t{ "x", "y" }, "wide") == clips::ok);
+        REQUIRE(wide.parse("head:tail") == clips::ok);
+
+        // 复制后互不影响
+        clips::flag_t names(name);
+        clips::flag_t wides(wide);
+        REQUIRE(name.parse("c") == clips::ok);
+        REQUIRE(wide.parse("h:t") == clips::ok);
+        REQUIRE(names.cast<std::string>() == "b");
+        REQUIRE(wides.cast<wide_t>().tail == "tail");
+        REQUIRE(wide.cast<wide_t>().head == "h");
+
+        // 移动后值仍然可用
+        clips::flag_t moved(std::move(ids));
+        REQUIRE(moved.cast<std::vector<int>>() == std::vector<int>{ 1 });
+        std::vector<clips::flag_t> flags;
+        for (int i = 0; i < 16; i++)
+        {
+            flags.push_back(i % 2 == 0 ? names : wides);
+        }
+        REQUIRE(flags[14].cast<std::string>() == "b");
+        REQUIRE(flags[15].cast<wide_t>().head == "head");
+        const clips::flag_t& src = wides;
+        names = src;
+        REQUIRE(names.cast<wide_t>().head == "head");
+    }
 }
\ No newline at end of file
@@ -67,6 +67,48 @@ TEST_CASE("utils", "utils")
         REQUIRE(list[2] == "c");
     }
 
+    SECTION("split view")
+    {
+        std::string line("a  'b c'");
+        clips::views_t list;
+        clips::utils::split(list, line, ' ');
+        REQUIRE(list.size() == 4);
+        REQUIRE(list[0] == "a");
+        REQUIRE(list[1] == "");
+        REQUIRE(list[2] == "'b");
+        REQUIRE(list[3].data() == line.data() + 6);
+
+        clips::utils::split(list, "", ' ');
+        REQUIRE(list.size() == 1);
+        REQUIRE(list[0].empty());
+
+        clips::args_view_t args(list.data(), list.size());
+        REQUIRE(args.size() == 1);
+        REQUIRE(clips::view_t("'abc''").trim('\'') == "abc");
+    }
+
+    SECTION("split quoted")
+    {
+        std::string text("a 'b c' \"d \\\"e\\\"\" f\\ g x'y'z # note\n'' h");
+        clips::views_t list;
+        std::list<std::string> held;
+        REQUIRE(clips::utils::split_quoted(list, text, held));
+        REQUIRE(list.size() == 7);
+        REQUIRE(list[0] == "a");
+        REQUIRE(list[1] == "b c");
+        REQUIRE(list[1].data() == text.data() + 3); // 整个被引号包含的词不复制
+        REQUIRE(list[2] == "d \"e\"");
+        REQUIRE(list[3] == "f g");
+        REQUIRE(list[4] == "xyz");
+        REQUIRE(list[5].empty());
+        REQUIRE(list[6] == "h");
+        REQUIRE(held.size() == 3);
+
+        list.clear();
+        REQUIRE_FALSE(clips::utils::split_quoted(list, "a 'b", held));
+        REQUIRE_FALSE(clips::utils::split_quoted(list, "a \"b", held));
+    }
+
     SECTION("filename")
     {
         REQUIRE(clips::utils::filename("/abc") == "abc");